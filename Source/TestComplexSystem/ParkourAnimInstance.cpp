@@ -0,0 +1,187 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ParkourAnimInstance.h"
+#include "TestComplexSystemCharacter.h"
+#include "ParkourMovementComponent.h"
+#include "ParkourStats.h"
+#include "TestComplexSystem.h"
+#include "Animation/AnimMontage.h"
+#include "Engine/AssetManager.h"
+#include "Engine/StreamableManager.h"
+#include "GameFramework/CharacterMovementComponent.h"
+
+DECLARE_CYCLE_STAT(TEXT("Anim Update"), STAT_ParkourAnimUpdate, STATGROUP_Parkour);
+
+/// <summary>
+/// Copies the parkour state from the character and its movement component. Runs on the game
+/// thread, so it only copies
+/// </summary>
+void FParkourAnimInstanceProxy::PreUpdate(UAnimInstance* InAnimInstance, float DeltaSeconds)
+{
+	Super::PreUpdate(InAnimInstance, DeltaSeconds);
+
+	BlendSpeed = CastChecked<UParkourAnimInstance>(InAnimInstance)->BlendSpeed;
+
+	const ATestComplexSystemCharacter* character = Cast<ATestComplexSystemCharacter>(InAnimInstance->TryGetPawnOwner());
+	if (!character)
+		return;
+
+	//The parkour moves come from the movement mode, which is replicated, so the other players'
+	//characters animate too. Only the copy that checked the wall knows a climb from a vault
+	const UParkourMovementComponent* movement = character->GetParkourMovement();
+	bIsSprinting = character->isSprinting;
+	bIsSliding = movement->IsSliding();
+	bIsClimbing = movement->IsVaulting() && character->isClimbing;
+	bIsCrouching = character->isCrouching;
+	bIsVaulting = movement->IsVaulting() && !bIsClimbing;
+	bIsWallRunning = movement->IsWallRunning();
+	bLeftSide = bIsWallRunning && !movement->IsWallRunRightSide();
+	bRightSide = bIsWallRunning && movement->IsWallRunRightSide();
+	bIsFalling = movement->IsFalling();
+	Velocity = character->GetVelocity();
+}
+
+/// <summary>
+/// Works out the blend weights and picks the montage to play. Runs on a worker thread
+/// </summary>
+void FParkourAnimInstanceProxy::Update(float DeltaSeconds)
+{
+	Super::Update(DeltaSeconds);
+
+	PARKOUR_SCOPE(AnimUpdate);
+
+	GroundSpeed = Velocity.Size2D();
+
+	WallRunAlpha = FMath::FInterpTo(WallRunAlpha, bIsWallRunning ? 1.0f : 0.0f, DeltaSeconds, BlendSpeed);
+	WallRunSide = FMath::FInterpTo(WallRunSide, bRightSide ? 1.0f : (bLeftSide ? -1.0f : 0.0f), DeltaSeconds, BlendSpeed);
+	CrouchAlpha = FMath::FInterpTo(CrouchAlpha, bIsCrouching ? 1.0f : 0.0f, DeltaSeconds, BlendSpeed);
+	SlideAlpha = FMath::FInterpTo(SlideAlpha, bIsSliding ? 1.0f : 0.0f, DeltaSeconds, BlendSpeed);
+
+	//Climbing and vaulting take over from everything else, then sliding, then wall running
+	EParkourAnimAction action = EParkourAnimAction::None;
+	if (bIsClimbing)
+		action = EParkourAnimAction::Climb;
+	else if (bIsVaulting)
+		action = EParkourAnimAction::Vault;
+	else if (bIsSliding)
+		action = EParkourAnimAction::Slide;
+	else if (bIsWallRunning)
+		action = bRightSide ? EParkourAnimAction::WallRunRight : EParkourAnimAction::WallRunLeft;
+
+	bActionChanged = action != Action;
+	Action = action;
+}
+
+/// <summary>
+/// Montages can only be started on the game thread, so the montage picked in the update
+/// is started here once the update is done
+/// </summary>
+void FParkourAnimInstanceProxy::PostUpdate(UAnimInstance* InAnimInstance) const
+{
+	Super::PostUpdate(InAnimInstance);
+
+	if (bActionChanged)
+		CastChecked<UParkourAnimInstance>(InAnimInstance)->PlayParkourAction(Action);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// UParkourAnimInstance
+
+void UParkourAnimInstance::NativeInitializeAnimation()
+{
+	Super::NativeInitializeAnimation();
+
+	//The editor previews the anim blueprint without a character, there is nothing to play there
+	if (TryGetPawnOwner())
+		LoadGroundMontages();
+}
+
+/// <summary>
+/// The montages are shared by every character, so only the first character to spawn waits
+/// for them, the rest find them loaded already
+/// </summary>
+void UParkourAnimInstance::LoadGroundMontages()
+{
+	TArray<FSoftObjectPath> montages;
+	for (const TSoftObjectPtr<UAnimMontage>& montage : { VaultMontage, ClimbMontage, SlideMontage })
+	{
+		if (!montage.IsNull())
+			montages.Add(montage.ToSoftObjectPath());
+	}
+
+	if (montages.Num() == 0)
+	{
+		LoadAirMontages();
+		return;
+	}
+
+	GroundMontagesHandle = UAssetManager::GetStreamableManager().RequestAsyncLoad(MoveTemp(montages),
+		FStreamableDelegate::CreateUObject(this, &UParkourAnimInstance::LoadAirMontages), FStreamableManager::AsyncLoadHighPriority);
+}
+
+void UParkourAnimInstance::LoadAirMontages()
+{
+	TArray<FSoftObjectPath> montages;
+	for (const TSoftObjectPtr<UAnimMontage>& montage : { WallRunLeftMontage, WallRunRightMontage })
+	{
+		if (!montage.IsNull())
+			montages.Add(montage.ToSoftObjectPath());
+	}
+
+	if (montages.Num() > 0)
+		AirMontagesHandle = UAssetManager::GetStreamableManager().RequestAsyncLoad(MoveTemp(montages), FStreamableDelegate(), FStreamableManager::DefaultAsyncLoadPriority);
+}
+
+UAnimMontage* UParkourAnimInstance::GetMontage(EParkourAnimAction Action) const
+{
+	switch (Action)
+	{
+	case EParkourAnimAction::Vault:
+		return VaultMontage.Get();
+	case EParkourAnimAction::Climb:
+		return ClimbMontage.Get();
+	case EParkourAnimAction::Slide:
+		return SlideMontage.Get();
+	case EParkourAnimAction::WallRunLeft:
+		return WallRunLeftMontage.Get();
+	case EParkourAnimAction::WallRunRight:
+		return WallRunRightMontage.Get();
+	default:
+		return nullptr;
+	}
+}
+
+FAnimInstanceProxy* UParkourAnimInstance::CreateAnimInstanceProxy()
+{
+	return &Proxy;
+}
+
+void UParkourAnimInstance::DestroyAnimInstanceProxy(FAnimInstanceProxy* InProxy)
+{
+	//The proxy is a member, so there is nothing to free
+}
+
+/// <summary>
+/// Vaults and climbs play once and end by themselves. Slides and wall runs play until
+/// the action changes. An action whose montage is still loading plays without it
+/// </summary>
+void UParkourAnimInstance::PlayParkourAction(EParkourAnimAction Action)
+{
+	UAnimMontage* montage = GetMontage(Action);
+	if (!montage && Action != EParkourAnimAction::None)
+		UE_LOG(LogParkour, Verbose, TEXT("%s has no montage loaded for parkour action %d yet"), *GetNameSafe(TryGetPawnOwner()), (int32)Action);
+
+	if (LoopingMontage && LoopingMontage != montage)
+	{
+		Montage_Stop(LoopingMontageBlendOut, LoopingMontage);
+		LoopingMontage = nullptr;
+	}
+
+	if (!montage || Montage_IsPlaying(montage))
+		return;
+
+	Montage_Play(montage);
+	if (Action == EParkourAnimAction::Slide || Action == EParkourAnimAction::WallRunLeft || Action == EParkourAnimAction::WallRunRight)
+		LoopingMontage = montage;
+}
@@ -0,0 +1,169 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Animation/AnimInstance.h"
+#include "Animation/AnimInstanceProxy.h"
+#include "ParkourAnimInstance.generated.h"
+
+class UAnimMontage;
+struct FStreamableHandle;
+
+//The parkour montage a character should be playing
+UENUM(BlueprintType)
+enum class EParkourAnimAction : uint8
+{
+	None,
+	Vault,
+	Climb,
+	Slide,
+	WallRunLeft,
+	WallRunRight
+};
+
+/**
+ * Animation state of a parkour character. The parkour state is copied from the character once
+ * a frame on the game thread, then the blend weights and the montage to play are worked out in
+ * the animation update, which runs on a worker thread alongside the other characters. The anim
+ * graph reads the results straight from here.
+ */
+USTRUCT(BlueprintType)
+struct FParkourAnimInstanceProxy : public FAnimInstanceProxy
+{
+	GENERATED_BODY()
+
+	FParkourAnimInstanceProxy()
+	{
+	}
+
+	FParkourAnimInstanceProxy(UAnimInstance* Instance)
+		: FAnimInstanceProxy(Instance)
+	{
+	}
+
+	//The parkour state of the character, copied on the game thread
+	UPROPERTY(Transient, BlueprintReadOnly, Category = Parkour)
+	bool bIsSprinting = false;
+	UPROPERTY(Transient, BlueprintReadOnly, Category = Parkour)
+	bool bIsSliding = false;
+	UPROPERTY(Transient, BlueprintReadOnly, Category = Parkour)
+	bool bIsClimbing = false;
+	UPROPERTY(Transient, BlueprintReadOnly, Category = Parkour)
+	bool bIsCrouching = false;
+	UPROPERTY(Transient, BlueprintReadOnly, Category = Parkour)
+	bool bIsVaulting = false;
+	UPROPERTY(Transient, BlueprintReadOnly, Category = Parkour)
+	bool bIsWallRunning = false;
+	UPROPERTY(Transient, BlueprintReadOnly, Category = Parkour)
+	bool bLeftSide = false;
+	UPROPERTY(Transient, BlueprintReadOnly, Category = Parkour)
+	bool bRightSide = false;
+	UPROPERTY(Transient, BlueprintReadOnly, Category = Parkour)
+	bool bIsFalling = false;
+
+	//Speed along the ground
+	UPROPERTY(Transient, BlueprintReadOnly, Category = Parkour)
+	float GroundSpeed = 0.0f;
+
+	//Blend weights that ease in and out as the parkour state changes
+	UPROPERTY(Transient, BlueprintReadOnly, Category = Parkour)
+	float WallRunAlpha = 0.0f;
+	//-1 on a wall to the left, 1 on a wall to the right, for leaning into the wall
+	UPROPERTY(Transient, BlueprintReadOnly, Category = Parkour)
+	float WallRunSide = 0.0f;
+	UPROPERTY(Transient, BlueprintReadOnly, Category = Parkour)
+	float CrouchAlpha = 0.0f;
+	UPROPERTY(Transient, BlueprintReadOnly, Category = Parkour)
+	float SlideAlpha = 0.0f;
+
+	//The montage that should be playing
+	UPROPERTY(Transient, BlueprintReadOnly, Category = Parkour)
+	EParkourAnimAction Action = EParkourAnimAction::None;
+
+protected:
+	// FAnimInstanceProxy interface
+	virtual void PreUpdate(UAnimInstance* InAnimInstance, float DeltaSeconds) override;
+	virtual void Update(float DeltaSeconds) override;
+	virtual void PostUpdate(UAnimInstance* InAnimInstance) const override;
+	// End of FAnimInstanceProxy interface
+
+private:
+	FVector Velocity = FVector::ZeroVector;
+	float BlendSpeed = 0.0f;
+
+	//Whether the action changed in the last update, so the game thread starts its montage
+	bool bActionChanged = false;
+};
+
+/**
+ * Native base class for the character anim blueprint. The parkour state is read once a frame
+ * without going through the blueprint VM, and the only game thread work left is starting the
+ * montage the worker thread update picked.
+ * The montages are soft references loaded in the background once the character is spawned.
+ * The vault, climb and slide montages come first, the wall run montages aren't needed until
+ * the character has jumped, so they load after them at a lower priority. Actions whose montage
+ * isn't in yet play without it.
+ */
+UCLASS(Transient, Blueprintable)
+class UParkourAnimInstance : public UAnimInstance
+{
+	GENERATED_BODY()
+
+public:
+	/** Starts the montage for a parkour action, stopping the slide or wall run montage that was playing */
+	void PlayParkourAction(EParkourAnimAction Action);
+
+	UPROPERTY(EditDefaultsOnly, Category = "Parkour|Montages")
+	TSoftObjectPtr<UAnimMontage> VaultMontage;
+
+	UPROPERTY(EditDefaultsOnly, Category = "Parkour|Montages")
+	TSoftObjectPtr<UAnimMontage> ClimbMontage;
+
+	UPROPERTY(EditDefaultsOnly, Category = "Parkour|Montages")
+	TSoftObjectPtr<UAnimMontage> SlideMontage;
+
+	UPROPERTY(EditDefaultsOnly, Category = "Parkour|Montages")
+	TSoftObjectPtr<UAnimMontage> WallRunLeftMontage;
+
+	UPROPERTY(EditDefaultsOnly, Category = "Parkour|Montages")
+	TSoftObjectPtr<UAnimMontage> WallRunRightMontage;
+
+	/** How quickly the blend weights follow the parkour state */
+	UPROPERTY(EditDefaultsOnly, Category = Parkour)
+	float BlendSpeed = 10.0f;
+
+	/** How long the slide and wall run montages take to blend out when they stop */
+	UPROPERTY(EditDefaultsOnly, Category = Parkour)
+	float LoopingMontageBlendOut = 0.2f;
+
+protected:
+	// UAnimInstance interface
+	virtual void NativeInitializeAnimation() override;
+	virtual FAnimInstanceProxy* CreateAnimInstanceProxy() override;
+	virtual void DestroyAnimInstanceProxy(FAnimInstanceProxy* InProxy) override;
+	// End of UAnimInstance interface
+
+private:
+	/** Starts loading the montages for the actions that can happen on the ground */
+	void LoadGroundMontages();
+
+	/** Starts loading the wall run montages once the ground montages are in */
+	void LoadAirMontages();
+
+	/** Returns the montage for an action, or null if it isn't loaded */
+	UAnimMontage* GetMontage(EParkourAnimAction Action) const;
+
+	UPROPERTY(Transient, BlueprintReadOnly, Category = Parkour, meta = (AllowPrivateAccess = "true"))
+	FParkourAnimInstanceProxy Proxy;
+
+	//Keep the montages loaded for as long as the anim instance is around
+	TSharedPtr<FStreamableHandle> GroundMontagesHandle;
+	TSharedPtr<FStreamableHandle> AirMontagesHandle;
+
+	/** The slide or wall run montage playing, stopped when the action changes */
+	UPROPERTY(Transient)
+	UAnimMontage* LoopingMontage;
+
+	friend struct FParkourAnimInstanceProxy;
+};
@@ -0,0 +1,184 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ParkourBatchSubsystem.h"
+#include "TestComplexSystemCharacter.h"
+#include "ParkourMovementComponent.h"
+#include "ParkourProbeScheduler.h"
+#include "ParkourStats.h"
+#include "Async/ParallelFor.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Batched Probes"), STAT_ParkourBatchedProbes, STATGROUP_Parkour);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Batched Probe Characters"), STAT_ParkourBatchedProbeCharacters, STATGROUP_Parkour);
+
+static TAutoConsoleVariable<int32> CVarParkourBatchedProbes(
+	TEXT("parkour.BatchedProbes"),
+	0,
+	TEXT("When on, the wall run probes of every character run as one batch at the end of the frame, with the traces\n")
+	TEXT("spread over the worker threads. 0: each character probes in its own tick (default), 1: batched"),
+	ECVF_Default);
+
+bool UParkourBatchSubsystem::IsEnabled()
+{
+	return CVarParkourBatchedProbes.GetValueOnGameThread() != 0;
+}
+
+void UParkourBatchSubsystem::RequestProbe(ATestComplexSystemCharacter* Character)
+{
+	Requests.Add(Character);
+}
+
+/// <summary>
+/// Gathers, traces and applies the probes of the frame. Tickable objects tick after the
+/// actors, so every request of the frame is in by now
+/// </summary>
+/// <param name="DeltaTime">time since the last tick</param>
+void UParkourBatchSubsystem::Tick(float DeltaTime)
+{
+	if (Requests.Num() == 0)
+		return;
+
+	PARKOUR_SCOPE(BatchedProbes);
+
+	GatherProbes();
+	RunProbes();
+	ApplyProbes();
+
+	Requests.Reset();
+}
+
+/// <summary>
+/// Copies what the probes need out of the characters so the traces don't touch them. A side
+/// the character is already running on isn't probed on the other side, the same as
+/// CheckForWallRunning. Characters with no wall in range of the wall sensor stay in the
+/// batch with nothing to trace, so their wall run still ends
+/// </summary>
+void UParkourBatchSubsystem::GatherProbes()
+{
+	Characters.Reset();
+	Starts.Reset();
+	Rights.Reset();
+	Flags.Reset();
+
+	UParkourProbeScheduler* probeScheduler = GetWorld()->GetSubsystem<UParkourProbeScheduler>();
+	const bool budgeted = probeScheduler && UParkourProbeScheduler::IsBudgeted();
+
+	for (const TWeakObjectPtr<ATestComplexSystemCharacter>& request : Requests)
+	{
+		ATestComplexSystemCharacter* character = request.Get();
+		if (!character)
+			continue;
+
+		//The character may have landed between asking for the probe and the batch running
+		if (!character->GetCharacterMovement()->IsFalling() && !character->ParkourMovement->IsWallRunning())
+		{
+			character->_ticksSinceProbe = 0;
+			continue;
+		}
+
+		uint8 flags = 0;
+		if (character->HasWallContact())
+		{
+			if (!character->_leftSide)
+				flags |= TraceRight;
+			if (!character->_rightSide)
+				flags |= TraceLeft;
+		}
+
+		//Probes that don't fit in the budget are dropped, the character asks again next tick
+		const int32 traces = ((flags & TraceRight) ? 1 : 0) + ((flags & TraceLeft) ? 1 : 0);
+		if (budgeted && traces > 0 && !probeScheduler->TryConsume(character, traces))
+			continue;
+
+		Characters.Add(character);
+		Starts.Add(character->GetActorLocation());
+		Rights.Add(character->GetActorRightVector() * ATestComplexSystemCharacter::WallRunProbeDistance);
+		Flags.Add(flags);
+	}
+
+	RightHits.SetNum(Characters.Num(), false);
+	LeftHits.SetNum(Characters.Num(), false);
+	INC_DWORD_STAT_BY(STAT_ParkourBatchedProbeCharacters, Characters.Num());
+}
+
+/// <summary>
+/// Scene queries can run on any thread, and each entry only writes its own results
+/// </summary>
+void UParkourBatchSubsystem::RunProbes()
+{
+	const UWorld* world = GetWorld();
+
+	ParallelFor(Characters.Num(), [&](int32 index)
+	{
+		const uint8 flags = Flags[index];
+		if (flags == 0)
+			return;
+
+		FCollisionQueryParams params(SCENE_QUERY_STAT(ParkourWallRunTrace));
+		params.AddIgnoredActor(Characters[index]);
+		params.bReturnPhysicalMaterial = true;
+
+		const FVector& start = Starts[index];
+		uint8 hits = 0;
+		if (flags & TraceRight)
+		{
+			PARKOUR_COUNT_TRACES(1);
+			if (world->LineTraceSingleByChannel(RightHits[index], start, start + Rights[index], ECC_Parkour, params))
+				hits |= HitRight;
+		}
+		if (flags & TraceLeft)
+		{
+			PARKOUR_COUNT_TRACES(1);
+			if (world->LineTraceSingleByChannel(LeftHits[index], start, start - Rights[index], ECC_Parkour, params))
+				hits |= HitLeft;
+		}
+
+		Flags[index] = flags | hits;
+	});
+}
+
+/// <summary>
+/// Applies the right side first and the left side only if the right side didn't take,
+/// which is the order CheckForWallRunning goes in
+/// </summary>
+void UParkourBatchSubsystem::ApplyProbes()
+{
+	for (int32 index = 0; index < Characters.Num(); ++index)
+	{
+		ATestComplexSystemCharacter* character = Characters[index];
+		const uint8 flags = Flags[index];
+		character->_ticksSinceProbe = 0;
+
+		if (!character->_leftSide)
+		{
+			//A wall that can't be run on stops the check, the same as a blocking probe
+			if (!character->UpdateWallRunSide(true, (flags & HitRight) != 0, RightHits[index]))
+				continue;
+		}
+
+		if (!character->_rightSide)
+			character->UpdateWallRunSide(false, (flags & HitLeft) != 0, LeftHits[index]);
+	}
+}
+
+ETickableTickType UParkourBatchSubsystem::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+bool UParkourBatchSubsystem::IsTickable() const
+{
+	return GetWorld() != nullptr && !IsPendingKill();
+}
+
+TStatId UParkourBatchSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UParkourBatchSubsystem, STATGROUP_Tickables);
+}
+
+UWorld* UParkourBatchSubsystem::GetTickableGameObjectWorld() const
+{
+	return GetWorld();
+}
@@ -0,0 +1,70 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "ParkourBatchSubsystem.generated.h"
+
+class ATestComplexSystemCharacter;
+
+/**
+ * Runs the wall run probes of every character as one batch at the end of the frame instead
+ * of one character at a time in their ticks. The probe state of the characters that asked
+ * for a probe is copied into flat arrays, the traces for the whole batch run in a ParallelFor,
+ * and the results are applied to the characters on the game thread in one pass, in the same
+ * order CheckForWallRunning applies them. With a probe budget the batched probes take their
+ * traces from it like climb checks do, characters whose probe doesn't fit ask again next tick.
+ * Turned on with parkour.BatchedProbes.
+ */
+UCLASS()
+class UParkourBatchSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	/** Returns true if wall run probes should go through the batch */
+	static bool IsEnabled();
+
+	/** Adds a character's wall run probe to this frame's batch */
+	void RequestProbe(ATestComplexSystemCharacter* Character);
+
+	// FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override;
+	// End of FTickableGameObject interface
+
+private:
+	/** What to trace for a character and what the traces hit */
+	enum EProbeFlags : uint8
+	{
+		TraceRight = 1 << 0,
+		TraceLeft = 1 << 1,
+		HitRight = 1 << 2,
+		HitLeft = 1 << 3
+	};
+
+	/** Copies the probe state of the requesting characters into the batch */
+	void GatherProbes();
+
+	/** Runs the traces of the whole batch across the worker threads */
+	void RunProbes();
+
+	/** Applies the results to the characters */
+	void ApplyProbes();
+
+	/** Characters that asked for a probe this frame */
+	TArray<TWeakObjectPtr<ATestComplexSystemCharacter>> Requests;
+
+	//The batch, one entry in each array per character, reused every frame
+	TArray<ATestComplexSystemCharacter*> Characters;
+	TArray<FVector> Starts;
+	TArray<FVector> Rights;
+	TArray<uint8> Flags;
+	TArray<FHitResult> RightHits;
+	TArray<FHitResult> LeftHits;
+};
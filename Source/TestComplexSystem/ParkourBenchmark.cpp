@@ -0,0 +1,289 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CoreMinimal.h"
+#include "TestComplexSystem.h"
+#include "TestComplexSystemCharacter.h"
+#include "ParkourMovementComponent.h"
+#include "ParkourPhysicalMaterial.h"
+#include "ParkourStats.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/StaticMeshActor.h"
+#include "Engine/World.h"
+#include "Components/CapsuleComponent.h"
+#include "Components/StaticMeshComponent.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+//The benchmark reads the parkour trace counter, so it goes with the rest of the profiling
+#if PARKOUR_PROFILING
+
+//Where the benchmark geometry is built, far above any level so nothing else gets in the way
+static const FVector BenchOrigin(0.0f, 0.0f, 50000.0f);
+//Distance between the lanes each case runs in
+static const float BenchLaneSpacing = 1000.0f;
+//Half height of the character capsule
+static const float BenchHalfHeight = 96.0f;
+
+//One timed parkour check. Prepare puts the character back where the case starts and isn't
+//timed, Run is the call being measured
+struct FParkourBenchCase
+{
+	FString Name;
+	TFunction<void()> Prepare;
+	TFunction<void()> Run;
+};
+
+//Timings of one case in microseconds, and the traces it made per iteration
+struct FParkourBenchResult
+{
+	FString Name;
+	double Mean = 0.0;
+	double P50 = 0.0;
+	double P90 = 0.0;
+	double P99 = 0.0;
+	double Max = 0.0;
+	double TracesPerIteration = 0.0;
+};
+
+/// <summary>
+/// Spawns a movable box with the engine cube so the ledge index treats it as dynamic and
+/// the probes always run
+/// </summary>
+/// <param name="World">the world to spawn the box in</param>
+/// <param name="Cube">the engine cube mesh, 100 units on each side</param>
+/// <param name="Center">the centre of the box</param>
+/// <param name="Size">the size of the box</param>
+/// <param name="bNoWallrun">whether to give the box the material that can't be wall run on</param>
+/// <returns>the spawned box</returns>
+static AStaticMeshActor* SpawnBenchBox(UWorld* World, UStaticMesh* Cube, const FVector& Center, const FVector& Size, bool bNoWallrun)
+{
+	AStaticMeshActor* box = World->SpawnActor<AStaticMeshActor>(Center, FRotator::ZeroRotator);
+	if (!box)
+		return nullptr;
+
+	UStaticMeshComponent* mesh = box->GetStaticMeshComponent();
+	mesh->SetMobility(EComponentMobility::Movable);
+	mesh->SetStaticMesh(Cube);
+	//So the character's wall sensor finds the box with parkour.WallContactEvents on
+	mesh->SetGenerateOverlapEvents(true);
+	box->SetActorScale3D(Size / 100.0f);
+
+	//Set on the component, the surface subsystem only turns tags into materials as actors spawn
+	if (bNoWallrun)
+		mesh->SetPhysMaterialOverride(UParkourPhysicalMaterial::GetNoWallrunMaterial());
+
+	return box;
+}
+
+/// <summary>
+/// Returns the value at a percentile of sorted samples
+/// </summary>
+static double GetPercentile(const TArray<double>& SortedSamples, double Percentile)
+{
+	if (SortedSamples.Num() == 0)
+		return 0.0;
+
+	const int32 index = FMath::Clamp(FMath::RoundToInt(Percentile * (SortedSamples.Num() - 1)), 0, SortedSamples.Num() - 1);
+	return SortedSamples[index];
+}
+
+/// <summary>
+/// Runs a case for a number of iterations, timing each call on its own
+/// </summary>
+static FParkourBenchResult RunBenchCase(const FParkourBenchCase& BenchCase, int32 Iterations)
+{
+	TArray<double> samples;
+	samples.Reserve(Iterations);
+
+	const double secondsPerCycle = FPlatformTime::GetSecondsPerCycle64();
+	uint64 traces = 0;
+
+	for (int32 i = 0; i < Iterations; ++i)
+	{
+		BenchCase.Prepare();
+
+		const uint32 tracesBefore = GParkourTraceCount;
+		const uint64 startCycles = FPlatformTime::Cycles64();
+		BenchCase.Run();
+		const uint64 endCycles = FPlatformTime::Cycles64();
+		traces += GParkourTraceCount - tracesBefore;
+
+		samples.Add((endCycles - startCycles) * secondsPerCycle * 1000000.0);
+	}
+
+	samples.Sort();
+
+	FParkourBenchResult result;
+	result.Name = BenchCase.Name;
+	for (double sample : samples)
+		result.Mean += sample;
+	result.Mean /= FMath::Max(1, samples.Num());
+	result.P50 = GetPercentile(samples, 0.5);
+	result.P90 = GetPercentile(samples, 0.9);
+	result.P99 = GetPercentile(samples, 0.99);
+	result.Max = samples.Num() > 0 ? samples.Last() : 0.0;
+	result.TracesPerIteration = (double)traces / FMath::Max(1, Iterations);
+	return result;
+}
+
+/// <summary>
+/// Writes the results as JSON to Saved/Profiling/Parkour so runs can be compared
+/// </summary>
+/// <returns>the file the results were written to</returns>
+static FString WriteBenchResults(const TArray<FParkourBenchResult>& Results, int32 Iterations)
+{
+	static const IConsoleVariable* asyncWallRunTraces = IConsoleManager::Get().FindConsoleVariable(TEXT("parkour.AsyncWallRunTraces"));
+	static const IConsoleVariable* wallContactEvents = IConsoleManager::Get().FindConsoleVariable(TEXT("parkour.WallContactEvents"));
+
+	FString json = TEXT("{\n");
+	json += FString::Printf(TEXT("\t\"iterations\": %d,\n"), Iterations);
+	json += FString::Printf(TEXT("\t\"asyncWallRunTraces\": %d,\n"), asyncWallRunTraces ? asyncWallRunTraces->GetInt() : 0);
+	json += FString::Printf(TEXT("\t\"wallContactEvents\": %d,\n"), wallContactEvents ? wallContactEvents->GetInt() : 0);
+	json += TEXT("\t\"cases\": [\n");
+	for (int32 i = 0; i < Results.Num(); ++i)
+	{
+		const FParkourBenchResult& result = Results[i];
+		json += FString::Printf(TEXT("\t\t{ \"name\": \"%s\", \"meanUs\": %.3f, \"p50Us\": %.3f, \"p90Us\": %.3f, \"p99Us\": %.3f, \"maxUs\": %.3f, \"tracesPerIteration\": %.3f }%s\n"),
+			*result.Name, result.Mean, result.P50, result.P90, result.P99, result.Max, result.TracesPerIteration, i + 1 < Results.Num() ? TEXT(",") : TEXT(""));
+	}
+	json += TEXT("\t]\n}\n");
+
+	const FString fileName = FPaths::ProfilingDir() / TEXT("Parkour") / FString::Printf(TEXT("ParkourBench-%s.json"), *FDateTime::Now().ToString());
+	FFileHelper::SaveStringToFile(json, *fileName);
+	return IFileManager::Get().ConvertToAbsolutePathForExternalAppForWrite(*fileName);
+}
+
+/// <summary>
+/// Times the parkour hot paths against walls built for the benchmark: climbing and vaulting
+/// walls of different heights and thicknesses, running walls with and without the NoWallrun
+/// material, sliding, a full tick and the collision work of starting a vault. Works headless, for example
+/// UE4Editor-Cmd TestComplexSystem -game -nullrhi -ExecCmds="parkour.Bench 5000, quit"
+/// </summary>
+/// <param name="Args">the number of iterations of each case</param>
+/// <param name="World">the world to build the benchmark in</param>
+static void RunParkourBench(const TArray<FString>& Args, UWorld* World)
+{
+	if (!World)
+		return;
+
+	const int32 iterations = FMath::Max(1, Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 5000);
+
+	UStaticMesh* cube = LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Cube.Cube"));
+	if (!cube)
+	{
+		UE_LOG(LogParkour, Error, TEXT("parkour.Bench: couldn't load the engine cube"));
+		return;
+	}
+
+	TArray<AActor*> spawnedActors;
+	auto spawnBox = [&](const FVector& center, const FVector& size, bool bNoWallrun)
+	{
+		AStaticMeshActor* box = SpawnBenchBox(World, cube, BenchOrigin + center, size, bNoWallrun);
+		if (box)
+			spawnedActors.Add(box);
+		return box;
+	};
+
+	//A floor under every lane. Its top is at the bench origin
+	spawnBox(FVector(0.0f, 3.0f * BenchLaneSpacing, -10.0f), FVector(4000.0f, 8.0f * BenchLaneSpacing, 20.0f), false);
+
+	//Lane 0, a low thin wall to vault. Its face is 50 in front of the character
+	AStaticMeshActor* vaultWall = spawnBox(FVector(60.0f, 0.0f, 45.0f), FVector(20.0f, 400.0f, 90.0f), false);
+	//Lane 1, a high thick wall to climb
+	spawnBox(FVector(200.0f, BenchLaneSpacing, 75.0f), FVector(300.0f, 400.0f, 150.0f), false);
+	//Lane 2 is empty for misses
+	//Lane 3, a wall to run along on the right of the character
+	spawnBox(FVector(0.0f, 3.0f * BenchLaneSpacing + 45.0f, 300.0f), FVector(2000.0f, 10.0f, 600.0f), false);
+	//Lane 4, the same wall tagged not to wall run on
+	spawnBox(FVector(0.0f, 4.0f * BenchLaneSpacing + 45.0f, 300.0f), FVector(2000.0f, 10.0f, 600.0f), true);
+
+	FActorSpawnParameters spawnParams;
+	spawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	ATestComplexSystemCharacter* character = World->SpawnActor<ATestComplexSystemCharacter>(ATestComplexSystemCharacter::StaticClass(), BenchOrigin, FRotator::ZeroRotator, spawnParams);
+	if (!character)
+	{
+		for (AActor* actor : spawnedActors)
+			actor->Destroy();
+		return;
+	}
+	spawnedActors.Add(character);
+
+	//Every case calls into the character directly, so it shouldn't tick by itself
+	character->SetActorTickEnabled(false);
+	UParkourMovementComponent* movement = character->GetParkourMovement();
+	movement->SetComponentTickEnabled(false);
+
+	//Puts the character standing or falling in a lane, facing down it, with no parkour going on
+	auto placeCharacter = [character, movement](int32 lane, float height, EMovementMode movementMode)
+	{
+		character->SetActorLocationAndRotation(BenchOrigin + FVector(0.0f, lane * BenchLaneSpacing, BenchHalfHeight + height), FRotator::ZeroRotator, false, nullptr, ETeleportType::TeleportPhysics);
+		if (movement->MovementMode != movementMode)
+			movement->SetMovementMode(movementMode);
+		character->_isWallRunning = false;
+		character->_leftSide = false;
+		character->_rightSide = false;
+		character->inAction = false;
+	};
+
+	TArray<FParkourBenchCase> cases;
+	cases.Add({ TEXT("CheckForClimbing.Vault"), [&]() { placeCharacter(0, 0.0f, MOVE_Walking); }, [character]() { character->CheckForClimbing(); } });
+	cases.Add({ TEXT("CheckForClimbing.Climb"), [&]() { placeCharacter(1, 0.0f, MOVE_Walking); }, [character]() { character->CheckForClimbing(); } });
+	cases.Add({ TEXT("CheckForClimbing.Miss"), [&]() { placeCharacter(2, 0.0f, MOVE_Walking); }, [character]() { character->CheckForClimbing(); } });
+	cases.Add({ TEXT("CheckForWallRunning.Hit"), [&]() { placeCharacter(3, 300.0f, MOVE_Falling); }, [character]() { character->CheckForWallRunning(); } });
+	cases.Add({ TEXT("CheckForWallRunning.NoWallrun"), [&]() { placeCharacter(4, 300.0f, MOVE_Falling); }, [character]() { character->CheckForWallRunning(); } });
+	cases.Add({ TEXT("CheckForWallRunning.Miss"), [&]() { placeCharacter(2, 300.0f, MOVE_Falling); }, [character]() { character->CheckForWallRunning(); } });
+	cases.Add({ TEXT("StartSlide+StopSlide"), [&]() { placeCharacter(2, 0.0f, MOVE_Walking); }, [character]() { character->StartSlide(); character->StopSlide(); } });
+	cases.Add({ TEXT("Tick.Falling"), [&]() { placeCharacter(3, 300.0f, MOVE_Falling); }, [character]() { character->Tick(1.0f / 60.0f); } });
+
+	//What starting a vault does to the capsule. Vaults used to turn collision off, which destroys
+	//the capsule's physics state, teleport to the start of the animation and turn collision back
+	//on, which creates the physics state again. Now the capsule ignores the wall and makes its
+	//first swept move along the vault path
+	UCapsuleComponent* capsule = character->GetCapsuleComponent();
+	UPrimitiveComponent* vaultWallComponent = vaultWall ? vaultWall->GetStaticMeshComponent() : nullptr;
+	cases.Add({ TEXT("VaultStart.CollisionToggle"), [&]() { placeCharacter(0, 0.0f, MOVE_Walking); }, [capsule]()
+	{
+		capsule->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		capsule->SetWorldLocation(capsule->GetComponentLocation() + FVector(0.0f, 0.0f, 10.0f), false, nullptr, ETeleportType::TeleportPhysics);
+		capsule->SetCollisionEnabled(ECollisionEnabled::QueryAndPhysics);
+	} });
+	cases.Add({ TEXT("VaultStart.IgnoreObstacle"), [&]() { placeCharacter(0, 0.0f, MOVE_Walking); }, [capsule, vaultWallComponent]()
+	{
+		capsule->IgnoreComponentWhenMoving(vaultWallComponent, true);
+		capsule->MoveComponent(FVector(0.0f, 0.0f, 10.0f), capsule->GetComponentQuat(), true);
+		capsule->IgnoreComponentWhenMoving(vaultWallComponent, false);
+	} });
+
+	//Every call is timed on its own, so the probe budget would only turn most of them into skips
+	IConsoleVariable* probeBudget = IConsoleManager::Get().FindConsoleVariable(TEXT("parkour.MaxProbeTracesPerFrame"));
+	const int32 savedProbeBudget = probeBudget ? probeBudget->GetInt() : 0;
+	if (probeBudget)
+		probeBudget->Set(0, ECVF_SetByCode);
+
+	TArray<FParkourBenchResult> results;
+	for (const FParkourBenchCase& benchCase : cases)
+	{
+		FParkourBenchResult result = RunBenchCase(benchCase, iterations);
+		UE_LOG(LogParkour, Display, TEXT("parkour.Bench %-32s mean %8.3fus  p50 %8.3fus  p90 %8.3fus  p99 %8.3fus  max %8.3fus  traces %.2f"),
+			*result.Name, result.Mean, result.P50, result.P90, result.P99, result.Max, result.TracesPerIteration);
+		results.Add(result);
+	}
+
+	if (probeBudget)
+		probeBudget->Set(savedProbeBudget, ECVF_SetByCode);
+
+	for (AActor* actor : spawnedActors)
+		actor->Destroy();
+
+	const FString fileName = WriteBenchResults(results, iterations);
+	UE_LOG(LogParkour, Display, TEXT("parkour.Bench results written to %s"), *fileName);
+}
+
+static FAutoConsoleCommandWithWorldAndArgs ParkourBenchCommand(
+	TEXT("parkour.Bench"),
+	TEXT("Times the parkour checks against generated walls and writes the results to Saved/Profiling/Parkour. Usage: parkour.Bench <Iterations=5000>"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&RunParkourBench));
+
+#endif
@@ -0,0 +1,480 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ParkourBotHarness.h"
+#include "ParkourMovementComponent.h"
+#include "TestComplexSystem.h"
+#include "Engine/NetConnection.h"
+#include "Engine/NetDriver.h"
+#include "Engine/World.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/PlayerInput.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/App.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+
+//The input names bound by ATestComplexSystemCharacter::SetupPlayerInputComponent, and the
+//vault action bound by the character blueprint
+static const FName MoveForwardAxis(TEXT("MoveForward"));
+static const FName MoveRightAxis(TEXT("MoveRight"));
+static const FName JumpAction(TEXT("Jump"));
+static const FName CrouchAction(TEXT("Crouch"));
+static const FName VaultAction(TEXT("Vault/Climb"));
+
+//////////////////////////////////////////////////////////////////////////
+// UParkourBotSubsystem
+
+void UParkourBotSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	if (GetWorld()->IsGameWorld())
+		FParse::Value(FCommandLine::Get(), TEXT("ParkourBot="), PendingRoute);
+}
+
+/// <summary>
+/// Opens a recording to run as the bot's route. The bot starts from the sample nearest
+/// its pawn on the next tick
+/// </summary>
+/// <param name="Name">the name of the recording</param>
+/// <returns>false if the recording couldn't be opened</returns>
+bool UParkourBotSubsystem::StartRoute(const FString& Name)
+{
+	Stop();
+
+	TSharedPtr<FParkourRecordingReader> route = MakeShared<FParkourRecordingReader>();
+	if (!route->Open(FParkourRecordingReader::GetRecordingFile(Name)) || route->GetNumSamples() < 2)
+	{
+		UE_LOG(LogParkour, Error, TEXT("Parkour bot couldn't open the route %s"), *Name);
+		return false;
+	}
+
+	Route = route;
+	RouteTime = 0.0f;
+	NextAction = 0;
+	bSnapped = false;
+	StuckTimer = 0.0f;
+	UE_LOG(LogParkour, Display, TEXT("Parkour bot running %s, %.1f seconds long"), *Name, Route->GetDuration());
+	return true;
+}
+
+/// <summary>
+/// Lets go of the inputs the bot is holding and drops the route
+/// </summary>
+void UParkourBotSubsystem::Stop()
+{
+	if (APlayerController* controller = GetBotController())
+	{
+		if (JumpHeld > 0.0f)
+			SetAction(controller, JumpAction, false);
+		if (bCrouchHeld)
+			SetAction(controller, CrouchAction, false);
+	}
+
+	JumpHeld = 0.0f;
+	bCrouchHeld = false;
+	Route.Reset();
+}
+
+/// <summary>
+/// Steers the pawn along the route and does the recorded actions as the route passes them.
+/// The route only moves on while the pawn keeps up, so a bot that falls off a wall run or
+/// misses a vault runs back to where it went wrong and tries again
+/// </summary>
+/// <param name="DeltaTime">the frame time</param>
+void UParkourBotSubsystem::Tick(float DeltaTime)
+{
+	APlayerController* controller = GetBotController();
+	if (!controller)
+		return;
+
+	//A route from the command line waits for the server's map, not the one loaded while connecting
+	if (!PendingRoute.IsEmpty())
+	{
+		if (GetWorld()->GetNetMode() != NM_Client)
+			return;
+
+		const FString routeName = PendingRoute;
+		PendingRoute.Reset();
+		StartRoute(routeName);
+		return;
+	}
+
+	if (!Route)
+		return;
+
+	const APawn* pawn = controller->GetPawn();
+	const FVector location = pawn->GetActorLocation();
+	if (!bSnapped)
+		SnapToRoute(location);
+
+	if (JumpHeld > 0.0f)
+	{
+		JumpHeld -= DeltaTime;
+		if (JumpHeld <= 0.0f)
+			SetAction(controller, JumpAction, false);
+	}
+
+	//Move the route on while the pawn is keeping up, doing the actions it passes
+	FVector routeLocation;
+	float routeYaw;
+	EParkourRunnerState routeState;
+	Route->Evaluate(RouteTime, routeLocation, routeYaw, routeState);
+	if (FVector::Dist2D(location, routeLocation) < CatchUpDistance)
+	{
+		RouteTime += DeltaTime;
+		while (NextAction < Route->GetNumActions() && Route->GetAction(NextAction).Sample * Route->GetSampleInterval() <= RouteTime)
+			DoAction(controller, Route->GetAction(NextAction++).Action);
+
+		//Run back to the start and go round again
+		if (RouteTime > Route->GetDuration())
+		{
+			RouteTime = 0.0f;
+			NextAction = 0;
+		}
+	}
+
+	//Face the point a little ahead on the route and run at it, like a player steering with the camera
+	FVector target;
+	Route->Evaluate(FMath::Min(RouteTime + LookAheadTime, Route->GetDuration()), target, routeYaw, routeState);
+	const FVector toTarget = target - location;
+	const bool bMoving = toTarget.Size2D() > 50.0f;
+	if (bMoving)
+		controller->SetControlRotation(FRotator(0.0f, toTarget.Rotation().Yaw, 0.0f));
+
+	SetAxis(controller, MoveForwardAxis, bMoving ? 1.0f : 0.0f, DeltaTime);
+	SetAxis(controller, MoveRightAxis, 0.0f, DeltaTime);
+
+	//Jump when held up against something the route goes over
+	StuckTimer = (bMoving && pawn->GetVelocity().Size2D() < StuckSpeed) ? StuckTimer + DeltaTime : 0.0f;
+	if (StuckTimer > StuckTime)
+	{
+		DoAction(controller, EParkourRecordedAction::Jump);
+		StuckTimer = 0.0f;
+	}
+}
+
+/// <summary>
+/// Gets the local player controller, once it has a pawn and its input is set up
+/// </summary>
+/// <returns>the controller, or null if there is nothing to drive yet</returns>
+APlayerController* UParkourBotSubsystem::GetBotController() const
+{
+	APlayerController* controller = GetWorld()->GetFirstPlayerController();
+	return controller && controller->IsLocalController() && controller->PlayerInput && controller->GetPawn() ? controller : nullptr;
+}
+
+/// <summary>
+/// Presses or lets go of the first key mapped to an action, going through the player input
+/// like a key on the keyboard or pad would
+/// </summary>
+/// <param name="Controller">the local player controller</param>
+/// <param name="ActionName">the action mapping</param>
+/// <param name="bPressed">whether to press or let go of the key</param>
+void UParkourBotSubsystem::SetAction(APlayerController* Controller, FName ActionName, bool bPressed)
+{
+	const TArray<FInputActionKeyMapping>& mappings = Controller->PlayerInput->GetKeysForAction(ActionName);
+	if (mappings.Num() == 0)
+		return;
+
+	const FKey& key = mappings[0].Key;
+	Controller->InputKey(key, bPressed ? IE_Pressed : IE_Released, bPressed ? 1.0f : 0.0f, key.IsGamepadKey());
+}
+
+/// <summary>
+/// Sends a value on the first pad stick mapped to an axis, scaled so the axis reads the
+/// value after the mapping's scale
+/// </summary>
+/// <param name="Controller">the local player controller</param>
+/// <param name="AxisName">the axis mapping</param>
+/// <param name="Value">the value the axis should read</param>
+/// <param name="DeltaTime">the frame time</param>
+void UParkourBotSubsystem::SetAxis(APlayerController* Controller, FName AxisName, float Value, float DeltaTime)
+{
+	for (const FInputAxisKeyMapping& mapping : Controller->PlayerInput->GetKeysForAxis(AxisName))
+	{
+		if (mapping.Key.IsAxis1D() && mapping.Key.IsGamepadKey() && mapping.Scale != 0.0f)
+		{
+			Controller->InputAxis(mapping.Key, Value / mapping.Scale, DeltaTime, 1, true);
+			return;
+		}
+	}
+}
+
+/// <summary>
+/// Presses the inputs a player would have pressed for a recorded action
+/// </summary>
+/// <param name="Controller">the local player controller</param>
+/// <param name="Action">the recorded action</param>
+void UParkourBotSubsystem::DoAction(APlayerController* Controller, EParkourRecordedAction Action)
+{
+	switch (Action)
+	{
+	case EParkourRecordedAction::Jump:
+	case EParkourRecordedAction::WallJump:
+		//Let go first so a jump straight after the last one is a new press
+		if (JumpHeld > 0.0f)
+			SetAction(Controller, JumpAction, false);
+		SetAction(Controller, JumpAction, true);
+		JumpHeld = JumpHoldTime;
+		break;
+	case EParkourRecordedAction::StartSlide:
+		SetAction(Controller, CrouchAction, true);
+		bCrouchHeld = true;
+		break;
+	case EParkourRecordedAction::StopSlide:
+		SetAction(Controller, CrouchAction, false);
+		bCrouchHeld = false;
+		break;
+	case EParkourRecordedAction::VaultOrGetUp:
+		SetAction(Controller, VaultAction, true);
+		SetAction(Controller, VaultAction, false);
+		break;
+	default:
+		break;
+	}
+}
+
+/// <summary>
+/// Starts the route from the sample nearest a location, so bots spawned at different
+/// player starts join the route in different places
+/// </summary>
+/// <param name="Location">where the pawn is</param>
+void UParkourBotSubsystem::SnapToRoute(const FVector& Location)
+{
+	int32 nearest = 0;
+	float nearestDistance = MAX_flt;
+	for (int32 i = 0; i < Route->GetNumSamples(); ++i)
+	{
+		const float distance = FVector::DistSquared(Location, Route->GetLocation(i));
+		if (distance < nearestDistance)
+		{
+			nearestDistance = distance;
+			nearest = i;
+		}
+	}
+
+	RouteTime = nearest * Route->GetSampleInterval();
+	NextAction = 0;
+	while (NextAction < Route->GetNumActions() && (int32)Route->GetAction(NextAction).Sample < nearest)
+		++NextAction;
+	bSnapped = true;
+}
+
+ETickableTickType UParkourBotSubsystem::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+bool UParkourBotSubsystem::IsTickable() const
+{
+	return GetWorld() != nullptr && !IsPendingKill() && (Route.IsValid() || !PendingRoute.IsEmpty());
+}
+
+TStatId UParkourBotSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UParkourBotSubsystem, STATGROUP_Tickables);
+}
+
+UWorld* UParkourBotSubsystem::GetTickableGameObjectWorld() const
+{
+	return GetWorld();
+}
+
+//////////////////////////////////////////////////////////////////////////
+// UParkourLoadReportSubsystem
+
+void UParkourLoadReportSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	bStartWhenServing = GetWorld()->IsGameWorld() && FParse::Param(FCommandLine::Get(), TEXT("ParkourLoadReport"));
+}
+
+/// <summary>
+/// Starts a new report file and writes the column names
+/// </summary>
+void UParkourLoadReportSubsystem::StartReport()
+{
+	StopReport();
+
+	ReportFile = FPaths::ProfilingDir() / TEXT("Parkour") / FString::Printf(TEXT("LoadReport-%s.csv"), *FDateTime::Now().ToString());
+	FFileHelper::SaveStringToFile(TEXT("Seconds,Players,Frames,FrameMs,MaxFrameMs,WorkMs,MaxWorkMs,CorrectionsPerSecond,OutKBPerClient,InKBTotal\n"), *ReportFile);
+
+	ReportStartTime = FPlatformTime::Seconds();
+	Frames = 0;
+	FrameTimeTotal = 0.0f;
+	FrameTimeMax = 0.0f;
+	WorkTimeTotal = 0.0f;
+	WorkTimeMax = 0.0f;
+	TimeSinceLine = 0.0f;
+	LastCorrectionCount = UParkourMovementComponent::GetServerCorrectionCount();
+	LastPlayerCount = 0;
+
+	UE_LOG(LogParkour, Display, TEXT("Parkour load report writing to %s"), *IFileManager::Get().ConvertToAbsolutePathForExternalAppForWrite(*ReportFile));
+}
+
+/// <summary>
+/// Writes out the frames since the last line and stops the report
+/// </summary>
+/// <returns>the report file, empty if no report was being written</returns>
+FString UParkourLoadReportSubsystem::StopReport()
+{
+	if (!IsReporting())
+		return FString();
+
+	if (Frames > 0)
+		WriteLine();
+
+	const FString fileName = IFileManager::Get().ConvertToAbsolutePathForExternalAppForWrite(*ReportFile);
+	ReportFile.Reset();
+	return fileName;
+}
+
+/// <summary>
+/// Adds the frame to the report. The work time is the frame less the time the server slept
+/// waiting for its next tick, which is what runs out as players join
+/// </summary>
+/// <param name="DeltaTime">the frame time</param>
+void UParkourLoadReportSubsystem::Tick(float DeltaTime)
+{
+	if (bStartWhenServing)
+	{
+		const ENetMode netMode = GetWorld()->GetNetMode();
+		if (netMode == NM_DedicatedServer || netMode == NM_ListenServer)
+		{
+			bStartWhenServing = false;
+			StartReport();
+		}
+		return;
+	}
+
+	const float frameTime = (float)FApp::GetDeltaTime() * 1000.0f;
+	const float workTime = (float)FMath::Max(0.0, FApp::GetDeltaTime() - FApp::GetIdleTime()) * 1000.0f;
+	++Frames;
+	FrameTimeTotal += frameTime;
+	FrameTimeMax = FMath::Max(FrameTimeMax, frameTime);
+	WorkTimeTotal += workTime;
+	WorkTimeMax = FMath::Max(WorkTimeMax, workTime);
+
+	TimeSinceLine += (float)FApp::GetDeltaTime();
+	if (TimeSinceLine >= ReportInterval)
+		WriteLine();
+}
+
+/// <summary>
+/// Writes a line of the report and starts counting the next one
+/// </summary>
+void UParkourLoadReportSubsystem::WriteLine()
+{
+	int32 clients = 0;
+	int64 outBytes = 0;
+	int64 inBytes = 0;
+	if (UNetDriver* netDriver = GetWorld()->GetNetDriver())
+	{
+		for (UNetConnection* connection : netDriver->ClientConnections)
+		{
+			if (!connection)
+				continue;
+
+			++clients;
+			outBytes += connection->OutBytesPerSecond;
+			inBytes += connection->InBytesPerSecond;
+		}
+	}
+
+	const int32 players = GetWorld()->GetNumPlayerControllers();
+	const uint32 corrections = UParkourMovementComponent::GetServerCorrectionCount();
+	const float frameTime = FrameTimeTotal / FMath::Max(1, Frames);
+	const float workTime = WorkTimeTotal / FMath::Max(1, Frames);
+	const float correctionsPerSecond = (corrections - LastCorrectionCount) / FMath::Max(TimeSinceLine, KINDA_SMALL_NUMBER);
+	const float outPerClient = outBytes / 1024.0f / FMath::Max(1, clients);
+
+	const FString line = FString::Printf(TEXT("%.1f,%d,%d,%.2f,%.2f,%.2f,%.2f,%.1f,%.2f,%.2f\n"),
+		FPlatformTime::Seconds() - ReportStartTime, players, Frames, frameTime, FrameTimeMax, workTime, WorkTimeMax,
+		correctionsPerSecond, outPerClient, inBytes / 1024.0f);
+	FFileHelper::SaveStringToFile(line, *ReportFile, FFileHelper::EEncodingOptions::AutoDetect, &IFileManager::Get(), FILEWRITE_Append);
+
+	if (players != LastPlayerCount)
+	{
+		UE_LOG(LogParkour, Display, TEXT("Parkour load report: %d players, %.2f ms work a frame (max %.2f), %.1f corrections a second, %.2f KB/s out per client"),
+			players, workTime, WorkTimeMax, correctionsPerSecond, outPerClient);
+		LastPlayerCount = players;
+	}
+
+	Frames = 0;
+	FrameTimeTotal = 0.0f;
+	FrameTimeMax = 0.0f;
+	WorkTimeTotal = 0.0f;
+	WorkTimeMax = 0.0f;
+	TimeSinceLine = 0.0f;
+	LastCorrectionCount = corrections;
+}
+
+ETickableTickType UParkourLoadReportSubsystem::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+bool UParkourLoadReportSubsystem::IsTickable() const
+{
+	return GetWorld() != nullptr && !IsPendingKill() && (IsReporting() || bStartWhenServing);
+}
+
+TStatId UParkourLoadReportSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UParkourLoadReportSubsystem, STATGROUP_Tickables);
+}
+
+UWorld* UParkourLoadReportSubsystem::GetTickableGameObjectWorld() const
+{
+	return GetWorld();
+}
+
+/// <summary>
+/// Starts the local player running a recording as a bot, or stops it with no recording
+/// </summary>
+/// <param name="Args">the name of the recording</param>
+/// <param name="World">the world the local player is in</param>
+static void RunParkourBot(const TArray<FString>& Args, UWorld* World)
+{
+	UParkourBotSubsystem* bot = World ? World->GetSubsystem<UParkourBotSubsystem>() : nullptr;
+	if (!bot)
+		return;
+
+	if (Args.Num() > 0)
+		bot->StartRoute(Args[0]);
+	else
+		bot->Stop();
+}
+
+static FAutoConsoleCommandWithWorldAndArgs ParkourBotCommand(
+	TEXT("parkour.Bot"),
+	TEXT("Runs a recording from Saved/Parkour/Recordings with the local player as a bot, driving the same inputs a player would. Usage: parkour.Bot <Recording>, or parkour.Bot to stop"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&RunParkourBot));
+
+/// <summary>
+/// Starts or stops the load report of a server
+/// </summary>
+/// <param name="World">the server world</param>
+static void ToggleLoadReport(UWorld* World)
+{
+	UParkourLoadReportSubsystem* report = World ? World->GetSubsystem<UParkourLoadReportSubsystem>() : nullptr;
+	if (!report)
+		return;
+
+	if (report->IsReporting())
+		UE_LOG(LogParkour, Display, TEXT("Parkour load report written to %s"), *report->StopReport());
+	else
+		report->StartReport();
+}
+
+static FAutoConsoleCommandWithWorld ParkourLoadReportCommand(
+	TEXT("parkour.LoadReport"),
+	TEXT("Starts or stops writing the server frame time, movement corrections and bandwidth per client to Saved/Profiling/Parkour once a second"),
+	FConsoleCommandWithWorldDelegate::CreateStatic(&ToggleLoadReport));
@@ -0,0 +1,153 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "ParkourRecording.h"
+#include "ParkourBotHarness.generated.h"
+
+class APlayerController;
+
+/**
+ * Plays the local player as a bot, for load testing a server with many clients. The bot
+ * runs a parkour recording as its route and drives the player controller through the
+ * same input mappings a player uses, so MoveForward, MoveRight, Jump and Crouch reach
+ * the character through SetupPlayerInputComponent and get predicted and sent to the
+ * server like real input. Started with -ParkourBot=<Recording> on a client, for example
+ * UE4Editor TestComplexSystem 127.0.0.1 -game -nullrhi -nosound -ParkourBot=Course
+ * for each bot against a server started with -ParkourLoadReport, or with parkour.Bot.
+ */
+UCLASS()
+class UParkourBotSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	// USubsystem interface
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	// End of USubsystem interface
+
+	/**
+	 * Starts running a route with the local player.
+	 * @param Name	the name of the recording in Saved/Parkour/Recordings
+	 * @return false if the recording couldn't be opened
+	 */
+	bool StartRoute(const FString& Name);
+
+	/** Lets go of every input and stops running the route */
+	void Stop();
+
+	bool IsRunning() const { return Route.IsValid(); }
+
+	// FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override;
+	// End of FTickableGameObject interface
+
+	/** How far ahead along the route the bot steers for, in seconds */
+	static constexpr float LookAheadTime = 0.3f;
+	/** The route waits for the bot while it is further than this behind */
+	static constexpr float CatchUpDistance = 300.0f;
+	/** Seconds held up against something before the bot jumps to get free */
+	static constexpr float StuckTime = 2.0f;
+	/** The bot counts as held up below this speed */
+	static constexpr float StuckSpeed = 50.0f;
+	/** How long jump is held for */
+	static constexpr float JumpHoldTime = 0.2f;
+
+private:
+	/** Returns the local player controller once it has a pawn to drive */
+	APlayerController* GetBotController() const;
+
+	/** Presses or lets go of the first key mapped to an action */
+	void SetAction(APlayerController* Controller, FName ActionName, bool bPressed);
+
+	/** Sends a value on the first analog key mapped to an axis */
+	void SetAxis(APlayerController* Controller, FName AxisName, float Value, float DeltaTime);
+
+	/** Presses the inputs a recorded action was made with */
+	void DoAction(APlayerController* Controller, EParkourRecordedAction Action);
+
+	/** Starts the route at the sample nearest the pawn */
+	void SnapToRoute(const FVector& Location);
+
+	TSharedPtr<FParkourRecordingReader> Route;
+
+	/** Route from the command line, started once the player has a pawn */
+	FString PendingRoute;
+
+	//Seconds into the route and the next recorded action to do
+	float RouteTime = 0.0f;
+	int32 NextAction = 0;
+	bool bSnapped = false;
+
+	//Seconds left holding jump, and whether crouch is held
+	float JumpHeld = 0.0f;
+	bool bCrouchHeld = false;
+
+	//How long the bot has been held up
+	float StuckTimer = 0.0f;
+};
+
+/**
+ * Writes a line a second of how the server is coping to a CSV file in Saved/Profiling/Parkour,
+ * so a load test with bots joining over time shows where the server runs out of room. Each
+ * line has the player count, the server frame time and the part of it spent working rather
+ * than waiting for the next tick, the movement corrections sent to clients and the bandwidth
+ * per client. Started with -ParkourLoadReport on the server, or with parkour.LoadReport.
+ */
+UCLASS()
+class UParkourLoadReportSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	// USubsystem interface
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	// End of USubsystem interface
+
+	/** Starts writing a new report */
+	void StartReport();
+
+	/** Stops writing the report, returns the file it was written to */
+	FString StopReport();
+
+	bool IsReporting() const { return !ReportFile.IsEmpty(); }
+
+	// FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override;
+	// End of FTickableGameObject interface
+
+	/** Seconds between lines of the report */
+	static constexpr float ReportInterval = 1.0f;
+
+private:
+	/** Writes a line with the frames since the last one */
+	void WriteLine();
+
+	FString ReportFile;
+	double ReportStartTime = 0.0;
+
+	/** Set by -ParkourLoadReport, starts the report once the world is serving */
+	bool bStartWhenServing = false;
+
+	//Frames since the last line, in milliseconds
+	int32 Frames = 0;
+	float FrameTimeTotal = 0.0f;
+	float FrameTimeMax = 0.0f;
+	float WorkTimeTotal = 0.0f;
+	float WorkTimeMax = 0.0f;
+	float TimeSinceLine = 0.0f;
+
+	uint32 LastCorrectionCount = 0;
+	int32 LastPlayerCount = 0;
+};
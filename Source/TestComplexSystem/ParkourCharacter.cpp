@@ -2,10 +2,14 @@
 
 
 #include "ParkourCharacter.h"
+#include "ParkourTypes.h"
+#if !UE_SERVER
 #include "HeadMountedDisplayFunctionLibrary.h"
+#endif
 #include "Camera/CameraComponent.h"
 #include "Components/CapsuleComponent.h"
 #include "Components/InputComponent.h"
+#include "Components/SkeletalMeshComponent.h"
 #include "GameFramework/CharacterMovementComponent.h"
 #include "GameFramework/Controller.h"
 #include "GameFramework/SpringArmComponent.h"
@@ -16,6 +20,10 @@ AParkourCharacter::AParkourCharacter()
 	// Set size for collision capsule
 	GetCapsuleComponent()->InitCapsuleSize(42.f, 96.0f);
 
+	// Parkour probes only look for walls, so characters are never hit by them
+	GetCapsuleComponent()->SetCollisionResponseToChannel(ECC_Parkour, ECR_Ignore);
+	GetMesh()->SetCollisionResponseToChannel(ECC_Parkour, ECR_Ignore);
+
 	// set our turn rates for input
 	BaseTurnRate = 45.f;
 	BaseLookUpRate = 45.f;
@@ -31,7 +39,8 @@ AParkourCharacter::AParkourCharacter()
 	GetCharacterMovement()->JumpZVelocity = 600.f;
 	GetCharacterMovement()->AirControl = 0.2f;
 
-	// Create a camera boom (pulls in towards the player if there is a collision)
+	// Create a camera boom (pulls in towards the player if there is a collision). Every build
+	// creates it so blueprints see the same components, dedicated servers turn it off in BeginPlay
 	CameraBoom = CreateDefaultSubobject<USpringArmComponent>(TEXT("CameraBoom"));
 	CameraBoom->SetupAttachment(RootComponent);
 	CameraBoom->TargetArmLength = 300.0f; // The camera follows at this distance behind the character	
@@ -47,6 +56,20 @@ AParkourCharacter::AParkourCharacter()
 
 }
 
+/// <summary>
+/// Turns the camera boom off on dedicated servers, which never look through it
+/// </summary>
+void AParkourCharacter::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (IsRunningDedicatedServer() && CameraBoom)
+	{
+		CameraBoom->bDoCollisionTest = false;
+		CameraBoom->SetComponentTickEnabled(false);
+	}
+}
+
 void AParkourCharacter::OnResetVR()
 {
 	// If TestComplexSystem is added to a project via 'Add Feature' in the Unreal Editor the dependency on HeadMountedDisplay in TestComplexSystem.Build.cs is not automatically propagated
@@ -55,7 +78,9 @@ void AParkourCharacter::OnResetVR()
 	//		Add "HeadMountedDisplay" to [YourProject].Build.cs PublicDependencyModuleNames in order to build successfully (appropriate if supporting VR).
 	// or:
 	//		Comment or delete the call to ResetOrientationAndPosition below (appropriate if not supporting VR)
+#if !UE_SERVER
 	UHeadMountedDisplayFunctionLibrary::ResetOrientationAndPosition();
+#endif
 }
 
 void AParkourCharacter::TouchStarted(ETouchIndex::Type FingerIndex, FVector Location)
@@ -30,6 +30,7 @@ public:
 		float BaseLookUpRate;
 
 protected:
+	virtual void BeginPlay() override;
 
 	/** Resets HMD orientation in VR. */
 	void OnResetVR();
@@ -0,0 +1,274 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ParkourCourse.h"
+#include "ParkourLedgeIndexSubsystem.h"
+#include "TestComplexSystem.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "Components/SceneComponent.h"
+#include "Engine/CollisionProfile.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "GameFramework/Pawn.h"
+#include "HAL/IConsoleManager.h"
+#include "Kismet/GameplayStatics.h"
+#include "UObject/ConstructorHelpers.h"
+
+/// <summary>
+/// Builds a course in front of the player, or clears the courses built before
+/// </summary>
+/// <param name="Args">the seed, the number of lanes and the number of segments, or Clear</param>
+/// <param name="World">the world to build the course in</param>
+static void BuildParkourCourse(const TArray<FString>& Args, UWorld* World)
+{
+	if (!World)
+		return;
+
+	if (Args.Num() > 0 && Args[0] == TEXT("Clear"))
+	{
+		for (TActorIterator<AParkourCourse> It(World); It; ++It)
+			It->Destroy();
+		return;
+	}
+
+	APawn* pawn = UGameplayStatics::GetPlayerPawn(World, 0);
+	if (!pawn)
+		return;
+
+	//Start the course just in front of the player, level with their feet
+	const FRotator facing(0.0f, pawn->GetActorRotation().Yaw, 0.0f);
+	const FVector feet = pawn->GetActorLocation() - FVector(0.0f, 0.0f, pawn->GetSimpleCollisionHalfHeight());
+	const FTransform transform(facing, feet + facing.Vector() * 200.0f);
+
+	AParkourCourse* course = World->SpawnActorDeferred<AParkourCourse>(AParkourCourse::StaticClass(), transform);
+	if (!course)
+		return;
+
+	course->Seed = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 0;
+	course->NumLanes = FMath::Max(1, Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 4);
+	course->NumSegments = FMath::Max(1, Args.Num() > 2 ? FCString::Atoi(*Args[2]) : 24);
+	course->FinishSpawning(transform);
+
+	UE_LOG(LogParkour, Display, TEXT("Parkour course %d: %d lanes of %d segments, %d blocks in 5 instanced components"),
+		course->Seed, course->NumLanes, course->NumSegments, course->GetNumBlocks());
+}
+
+static FAutoConsoleCommandWithWorldAndArgs ParkourCourseCommand(
+	TEXT("parkour.Course"),
+	TEXT("Builds a parkour course from a seed in front of the player. Usage: parkour.Course <Seed=0> <Lanes=4> <Segments=24> | parkour.Course Clear"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&BuildParkourCourse));
+
+//////////////////////////////////////////////////////////////////////////
+// AParkourCourse
+
+AParkourCourse::AParkourCourse()
+{
+	PrimaryActorTick.bCanEverTick = false;
+
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+	RootComponent->SetMobility(EComponentMobility::Static);
+
+	Floors = CreateBlocks(TEXT("Floors"));
+	VaultBoxes = CreateBlocks(TEXT("VaultBoxes"));
+	Ledges = CreateBlocks(TEXT("Ledges"));
+	Walls = CreateBlocks(TEXT("Walls"));
+	NoWallrunWalls = CreateBlocks(TEXT("NoWallrunWalls"));
+	NoWallrunWalls->ComponentTags.Add(TEXT("NoWallrun"));
+
+	//So the character's wall sensor finds the walls with parkour.WallContactEvents on
+	Walls->SetGenerateOverlapEvents(true);
+	NoWallrunWalls->SetGenerateOverlapEvents(true);
+
+	static ConstructorHelpers::FObjectFinder<UStaticMesh> cube(TEXT("/Engine/BasicShapes/Cube.Cube"));
+	BlockMesh = cube.Succeeded() ? cube.Object : nullptr;
+
+	Seed = 0;
+	NumLanes = 4;
+	NumSegments = 24;
+	SegmentLength = 1000.0f;
+	LaneWidth = 600.0f;
+
+	FlatWeight = 1.0f;
+	VaultWeight = 2.0f;
+	LedgeWeight = 1.5f;
+	WallRunWeight = 2.0f;
+	NoWallrunWeight = 0.5f;
+
+	//Sizes the character's ledge probe and wall run probes are made for
+	VaultHeight = FVector2D(80.0f, 100.0f);
+	VaultThickness = FVector2D(20.0f, 40.0f);
+	LedgeHeight = FVector2D(130.0f, 170.0f);
+	LedgeThickness = FVector2D(200.0f, 400.0f);
+	WallHeight = 600.0f;
+	WallThickness = 20.0f;
+	WallOffset = 200.0f;
+	PitDepth = 150.0f;
+	FloorThickness = 20.0f;
+}
+
+/// <summary>
+/// Creates a component for one kind of block, blocking everything like the level geometry
+/// </summary>
+/// <param name="Name">the name of the component</param>
+/// <returns>the component</returns>
+UHierarchicalInstancedStaticMeshComponent* AParkourCourse::CreateBlocks(FName Name)
+{
+	UHierarchicalInstancedStaticMeshComponent* blocks = CreateDefaultSubobject<UHierarchicalInstancedStaticMeshComponent>(Name);
+	blocks->SetupAttachment(RootComponent);
+	blocks->SetMobility(EComponentMobility::Static);
+	blocks->SetCollisionProfileName(UCollisionProfile::BlockAll_ProfileName);
+	blocks->SetGenerateOverlapEvents(false);
+	return blocks;
+}
+
+void AParkourCourse::OnConstruction(const FTransform& Transform)
+{
+	Super::OnConstruction(Transform);
+
+	Generate();
+}
+
+/// <summary>
+/// Clears the blocks and lays the course out again. Each lane is walked a segment at a
+/// time, with the floor left open under pits and added as one block for each stretch
+/// between them. The random stream is drawn from in the same order every time, so a seed
+/// always gives the same course
+/// </summary>
+void AParkourCourse::Generate()
+{
+	for (UHierarchicalInstancedStaticMeshComponent* blocks : GetBlockComponents())
+	{
+		blocks->ClearInstances();
+		blocks->SetStaticMesh(BlockMesh);
+	}
+
+	if (!BlockMesh)
+		return;
+
+	TArray<FTransform> floors;
+	TArray<FTransform> vaultBoxes;
+	TArray<FTransform> ledges;
+	TArray<FTransform> walls;
+	TArray<FTransform> noWallrunWalls;
+
+	//The block mesh is 100 units on each side, so a block is scaled to its size over 100
+	auto addBlock = [](TArray<FTransform>& blocks, const FVector& center, const FVector& size)
+	{
+		blocks.Add(FTransform(FQuat::Identity, center, size / 100.0f));
+	};
+
+	FRandomStream random(Seed);
+	const float courseLength = NumSegments * SegmentLength;
+	for (int32 lane = 0; lane < NumLanes; ++lane)
+	{
+		//The lanes are centred on the actor, with the top of the floor level with it
+		const float laneY = (lane - (NumLanes - 1) * 0.5f) * LaneWidth;
+
+		//Adds the floor from the end of the last pit up to a point along the lane
+		float floorStart = 0.0f;
+		auto addFloor = [&](float floorEnd)
+		{
+			if (floorEnd > floorStart)
+				addBlock(floors, FVector((floorStart + floorEnd) * 0.5f, laneY, -FloorThickness * 0.5f), FVector(floorEnd - floorStart, LaneWidth, FloorThickness));
+		};
+
+		for (int32 segment = 0; segment < NumSegments; ++segment)
+		{
+			const float segmentStart = segment * SegmentLength;
+			const float segmentMiddle = segmentStart + SegmentLength * 0.5f;
+			const EParkourCourseSegment type = segment == 0 ? EParkourCourseSegment::Flat : PickSegment(random);
+
+			switch (type)
+			{
+			case EParkourCourseSegment::Vault:
+			{
+				const float height = random.FRandRange(VaultHeight.X, VaultHeight.Y);
+				const float thickness = random.FRandRange(VaultThickness.X, VaultThickness.Y);
+				addBlock(vaultBoxes, FVector(segmentMiddle, laneY, height * 0.5f), FVector(thickness, LaneWidth, height));
+				break;
+			}
+			case EParkourCourseSegment::Ledge:
+			{
+				const float height = random.FRandRange(LedgeHeight.X, LedgeHeight.Y);
+				const float thickness = random.FRandRange(LedgeThickness.X, LedgeThickness.Y);
+				addBlock(ledges, FVector(segmentMiddle, laneY, height * 0.5f), FVector(thickness, LaneWidth, height));
+				break;
+			}
+			case EParkourCourseSegment::WallRun:
+			case EParkourCourseSegment::NoWallrun:
+			{
+				//Leave the floor open over the pit, its bottom is low enough to climb back out of
+				addFloor(segmentStart);
+				floorStart = segmentStart + SegmentLength;
+				addBlock(floors, FVector(segmentMiddle, laneY, -PitDepth - FloorThickness * 0.5f), FVector(SegmentLength, LaneWidth, FloorThickness));
+
+				//The wall runs from the bottom of the pit along one side of it
+				const float side = random.FRandRange(0.0f, 1.0f) < 0.5f ? -1.0f : 1.0f;
+				addBlock(type == EParkourCourseSegment::WallRun ? walls : noWallrunWalls,
+					FVector(segmentMiddle, laneY + side * WallOffset, (WallHeight - PitDepth) * 0.5f),
+					FVector(SegmentLength, WallThickness, WallHeight + PitDepth));
+				break;
+			}
+			default:
+				break;
+			}
+		}
+
+		addFloor(courseLength);
+	}
+
+	Floors->AddInstances(floors, false);
+	VaultBoxes->AddInstances(vaultBoxes, false);
+	Ledges->AddInstances(ledges, false);
+	Walls->AddInstances(walls, false);
+	NoWallrunWalls->AddInstances(noWallrunWalls, false);
+
+	//The climb cache keys walls by component, and the blocks of a rebuilt course move without the component moving
+	UWorld* world = GetWorld();
+	if (world && world->IsGameWorld())
+	{
+		if (UParkourLedgeIndexSubsystem* ledgeIndex = world->GetSubsystem<UParkourLedgeIndexSubsystem>())
+			ledgeIndex->GetClimbCache().Empty();
+	}
+}
+
+/// <summary>
+/// Counts the blocks in every component
+/// </summary>
+/// <returns>the number of blocks</returns>
+int32 AParkourCourse::GetNumBlocks() const
+{
+	int32 numBlocks = 0;
+	for (const UHierarchicalInstancedStaticMeshComponent* blocks : GetBlockComponents())
+		numBlocks += blocks->GetInstanceCount();
+	return numBlocks;
+}
+
+/// <summary>
+/// Picks a segment by the weights
+/// </summary>
+/// <param name="Random">the course's random stream</param>
+/// <returns>the segment</returns>
+EParkourCourseSegment AParkourCourse::PickSegment(FRandomStream& Random) const
+{
+	const float weights[] = { FlatWeight, VaultWeight, LedgeWeight, WallRunWeight, NoWallrunWeight };
+
+	float totalWeight = 0.0f;
+	for (float weight : weights)
+		totalWeight += FMath::Max(weight, 0.0f);
+
+	float pick = Random.FRandRange(0.0f, totalWeight);
+	for (int32 i = 0; i < UE_ARRAY_COUNT(weights); ++i)
+	{
+		pick -= FMath::Max(weights[i], 0.0f);
+		if (pick < 0.0f)
+			return (EParkourCourseSegment)i;
+	}
+	return EParkourCourseSegment::Flat;
+}
+
+TArray<UHierarchicalInstancedStaticMeshComponent*, TInlineAllocator<5>> AParkourCourse::GetBlockComponents() const
+{
+	return { Floors, VaultBoxes, Ledges, Walls, NoWallrunWalls };
+}
@@ -0,0 +1,136 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "ParkourCourse.generated.h"
+
+class UHierarchicalInstancedStaticMeshComponent;
+class UStaticMesh;
+
+//The pieces a course lane is made of, one per segment
+enum class EParkourCourseSegment : uint8
+{
+	//Just floor
+	Flat,
+	//A low box across the lane to vault
+	Vault,
+	//A tall block across the lane to climb onto and drop off
+	Ledge,
+	//A pit with a wall along one side to wall run over it
+	WallRun,
+	//A pit with a wall tagged not to wall run on, to jump or fall into
+	NoWallrun
+};
+
+/**
+ * Builds a parkour course from a seed, for stress testing with many characters on real
+ * parkour geometry. The course is lanes of segments running along the actor's forward
+ * axis, each segment picked at random from the weights below, so the same seed always
+ * builds the same course. Every block is an instance of one cube mesh in one of a few
+ * hierarchical instanced components, so a course of thousands of blocks is a handful of
+ * draw calls and no actors, and the floor of each lane is merged into as few blocks as
+ * the pits allow. Built in the editor whenever a setting changes, or at runtime with
+ * parkour.Course.
+ */
+UCLASS()
+class AParkourCourse : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	AParkourCourse();
+
+	virtual void OnConstruction(const FTransform& Transform) override;
+
+	/** Clears the course and builds it again from the seed */
+	UFUNCTION(CallInEditor, Category = "Parkour Course")
+	void Generate();
+
+	/** Returns how many blocks the course is made of */
+	int32 GetNumBlocks() const;
+
+	/** Seed the segments are picked with */
+	UPROPERTY(EditAnywhere, Category = "Parkour Course")
+	int32 Seed;
+
+	/** Lanes side by side, each with its own segments */
+	UPROPERTY(EditAnywhere, Category = "Parkour Course", meta = (ClampMin = "1"))
+	int32 NumLanes;
+
+	/** Segments along each lane. The first is always flat, for a run up */
+	UPROPERTY(EditAnywhere, Category = "Parkour Course", meta = (ClampMin = "1"))
+	int32 NumSegments;
+
+	UPROPERTY(EditAnywhere, Category = "Parkour Course", meta = (ClampMin = "100.0"))
+	float SegmentLength;
+
+	UPROPERTY(EditAnywhere, Category = "Parkour Course", meta = (ClampMin = "200.0"))
+	float LaneWidth;
+
+	/** How likely each segment is, against the others */
+	UPROPERTY(EditAnywhere, Category = "Parkour Course|Segments", meta = (ClampMin = "0.0"))
+	float FlatWeight;
+	UPROPERTY(EditAnywhere, Category = "Parkour Course|Segments", meta = (ClampMin = "0.0"))
+	float VaultWeight;
+	UPROPERTY(EditAnywhere, Category = "Parkour Course|Segments", meta = (ClampMin = "0.0"))
+	float LedgeWeight;
+	UPROPERTY(EditAnywhere, Category = "Parkour Course|Segments", meta = (ClampMin = "0.0"))
+	float WallRunWeight;
+	UPROPERTY(EditAnywhere, Category = "Parkour Course|Segments", meta = (ClampMin = "0.0"))
+	float NoWallrunWeight;
+
+	/** Size of the blocks. Heights and thicknesses are picked between the min and max of each */
+	UPROPERTY(EditAnywhere, Category = "Parkour Course|Blocks")
+	FVector2D VaultHeight;
+	UPROPERTY(EditAnywhere, Category = "Parkour Course|Blocks")
+	FVector2D VaultThickness;
+	UPROPERTY(EditAnywhere, Category = "Parkour Course|Blocks")
+	FVector2D LedgeHeight;
+	UPROPERTY(EditAnywhere, Category = "Parkour Course|Blocks")
+	FVector2D LedgeThickness;
+	UPROPERTY(EditAnywhere, Category = "Parkour Course|Blocks")
+	float WallHeight;
+	UPROPERTY(EditAnywhere, Category = "Parkour Course|Blocks")
+	float WallThickness;
+	/** How far from the middle of the lane the wall of a pit is */
+	UPROPERTY(EditAnywhere, Category = "Parkour Course|Blocks")
+	float WallOffset;
+	/** How far down the bottom of a pit is, low enough to climb back out of */
+	UPROPERTY(EditAnywhere, Category = "Parkour Course|Blocks")
+	float PitDepth;
+	UPROPERTY(EditAnywhere, Category = "Parkour Course|Blocks")
+	float FloorThickness;
+
+	/** The mesh of every block, 100 units on each side and centred on its pivot */
+	UPROPERTY(EditAnywhere, Category = "Parkour Course")
+	UStaticMesh* BlockMesh;
+
+protected:
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Parkour Course")
+	UHierarchicalInstancedStaticMeshComponent* Floors;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Parkour Course")
+	UHierarchicalInstancedStaticMeshComponent* VaultBoxes;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Parkour Course")
+	UHierarchicalInstancedStaticMeshComponent* Ledges;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Parkour Course")
+	UHierarchicalInstancedStaticMeshComponent* Walls;
+
+	/** Walls tagged not to wall run on */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Parkour Course")
+	UHierarchicalInstancedStaticMeshComponent* NoWallrunWalls;
+
+private:
+	/** Creates one of the block components */
+	UHierarchicalInstancedStaticMeshComponent* CreateBlocks(FName Name);
+
+	/** Picks the segment at a place in a lane */
+	EParkourCourseSegment PickSegment(FRandomStream& Random) const;
+
+	/** Returns every block component */
+	TArray<UHierarchicalInstancedStaticMeshComponent*, TInlineAllocator<5>> GetBlockComponents() const;
+};
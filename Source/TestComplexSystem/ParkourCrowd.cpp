@@ -0,0 +1,524 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ParkourCrowd.h"
+#include "TestComplexSystemCharacter.h"
+#include "ParkourMovementComponent.h"
+#include "ParkourLedgeProbe.h"
+#include "ParkourLedgeIndexSubsystem.h"
+#include "ParkourPhysicalMaterial.h"
+#include "ParkourStats.h"
+#include "Async/ParallelFor.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "Kismet/GameplayStatics.h"
+
+DECLARE_CYCLE_STAT(TEXT("Crowd Simulate"), STAT_ParkourCrowdSimulate, STATGROUP_Parkour);
+DECLARE_CYCLE_STAT(TEXT("Crowd Promotion"), STAT_ParkourCrowdPromotion, STATGROUP_Parkour);
+DECLARE_CYCLE_STAT(TEXT("Crowd Instances"), STAT_ParkourCrowdInstances, STATGROUP_Parkour);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Crowd Runners"), STAT_ParkourCrowdRunners, STATGROUP_Parkour);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Crowd Promoted"), STAT_ParkourCrowdPromoted, STATGROUP_Parkour);
+
+static TAutoConsoleVariable<int32> CVarParkourCrowdParallel(
+	TEXT("parkour.CrowdParallel"),
+	1,
+	TEXT("Whether crowd runners are stepped across worker threads.\n")
+	TEXT("0: step every runner on the game thread, 1: step runners with ParallelFor (default)"),
+	ECVF_Default);
+
+void FParkourCrowdRunners::SetNum(int32 Count)
+{
+	Positions.SetNumZeroed(Count);
+	Velocities.SetNumZeroed(Count);
+	Yaws.SetNumZeroed(Count);
+	States.SetNumZeroed(Count);
+	VaultPaths.SetNum(Count);
+	VaultObstacles.SetNum(Count);
+	ActionTimes.SetNumZeroed(Count);
+	Random.SetNum(Count);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// AParkourCrowd
+
+AParkourCrowd::AParkourCrowd()
+{
+	PrimaryActorTick.bCanEverTick = true;
+
+	//The runners are drawn with world space instances so the component stays at the origin
+	RunnerInstances = CreateDefaultSubobject<UInstancedStaticMeshComponent>(TEXT("RunnerInstances"));
+	RunnerInstances->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	RunnerInstances->SetGenerateOverlapEvents(false);
+	RootComponent = RunnerInstances;
+
+	NumRunners = 2000;
+	SpawnRadius = 5000.0f;
+	Seed = 0;
+	PromoteDistance = 1500.0f;
+	DemoteDistance = 2500.0f;
+	MaxPromoted = 8;
+	ProbeInterval = 4;
+
+	RunSpeed = 600.0f;
+	WallRunSpeed = 500.0f;
+	WallRunProbeDistance = 50.0f;
+	SlideSpeed = 600.0f;
+	SlideDuration = 1.0f;
+	SlideChance = 0.05f;
+	VaultDuration = 1.0f;
+	CapsuleRadius = 42.0f;
+	CapsuleHalfHeight = 96.0f;
+	MaxStepHeight = 45.0f;
+
+	LedgeIndex = nullptr;
+	FrameCounter = 0;
+}
+
+/// <summary>
+/// Spawns the runners falling at random spots around the crowd actor so they find the ground
+/// on their first step
+/// </summary>
+void AParkourCrowd::BeginPlay()
+{
+	Super::BeginPlay();
+
+	LedgeIndex = GetWorld()->GetSubsystem<UParkourLedgeIndexSubsystem>();
+
+	FRandomStream spawnRandom(Seed);
+	Runners.SetNum(FMath::Max(0, NumRunners));
+	for (int32 i = 0; i < Runners.Num(); ++i)
+	{
+		const float angle = spawnRandom.FRandRange(0.0f, 2.0f * PI);
+		const float radius = FMath::Sqrt(spawnRandom.FRand()) * SpawnRadius;
+
+		Runners.Positions[i] = GetActorLocation() + FVector(FMath::Cos(angle) * radius, FMath::Sin(angle) * radius, 0.0f);
+		Runners.Yaws[i] = spawnRandom.FRandRange(0.0f, 360.0f);
+		Runners.States[i] = EParkourRunnerState::Falling;
+		Runners.Random[i].Initialize(spawnRandom.RandHelper(MAX_int32));
+	}
+
+	RunnerInstances->ClearInstances();
+	for (int32 i = 0; i < Runners.Num(); ++i)
+		RunnerInstances->AddInstanceWorldSpace(FTransform(FRotator(0.0f, Runners.Yaws[i], 0.0f), Runners.Positions[i]));
+}
+
+/// <summary>
+/// Removes the characters of promoted runners with the crowd
+/// </summary>
+void AParkourCrowd::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	for (ATestComplexSystemCharacter* character : PromotedCharacters)
+	{
+		if (IsValid(character))
+			character->Destroy();
+	}
+	PromotedCharacters.Reset();
+	PromotedRunners.Reset();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+/// <summary>
+/// Swaps runners to and from full characters, steps every other runner and moves the instances
+/// </summary>
+void AParkourCrowd::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	UpdatePromotion();
+
+	//Runners don't probe each other, and characters ignore the parkour channel, so only the world is probed
+	FCollisionQueryParams traceParams(SCENE_QUERY_STAT(ParkourCrowdTrace));
+	traceParams.AddIgnoredActor(this);
+	traceParams.bReturnPhysicalMaterial = true;
+
+	//Long hitches would move the runners through walls between probes
+	const float deltaSeconds = FMath::Min(DeltaSeconds, 0.1f);
+	const float gravityZ = GetWorld()->GetGravityZ();
+	const uint32 probeInterval = (uint32)FMath::Max(1, ProbeInterval);
+	const uint32 frame = FrameCounter++;
+
+	{
+		SCOPE_CYCLE_COUNTER(STAT_ParkourCrowdSimulate);
+
+		ParallelFor(Runners.Num(), [&](int32 index)
+		{
+			if (EnumHasAnyFlags(Runners.States[index], EParkourRunnerState::Promoted))
+				return;
+
+			//Stagger the probes so only a slice of the crowd traces each frame
+			const bool bProbe = (frame + (uint32)index) % probeInterval == 0;
+			StepRunner(index, deltaSeconds, gravityZ, bProbe, traceParams);
+		}, CVarParkourCrowdParallel.GetValueOnGameThread() == 0);
+	}
+
+	UpdateInstances();
+
+	SET_DWORD_STAT(STAT_ParkourCrowdRunners, Runners.Num());
+	SET_DWORD_STAT(STAT_ParkourCrowdPromoted, PromotedCharacters.Num());
+}
+
+/// <summary>
+/// Moves a runner on by a frame. Runs on worker threads, so it only reads the world and
+/// the crowd settings and only writes to the slots of its own runner
+/// </summary>
+/// <param name="Index">the runner to step</param>
+/// <param name="DeltaSeconds">how long the frame was</param>
+/// <param name="GravityZ">the gravity of the world</param>
+/// <param name="bProbe">whether the runner probes for walls this frame</param>
+/// <param name="Params">the query params, ignoring the crowd and the promoted characters</param>
+void AParkourCrowd::StepRunner(int32 Index, float DeltaSeconds, float GravityZ, bool bProbe, const FCollisionQueryParams& Params)
+{
+	const UWorld* world = GetWorld();
+	EParkourRunnerState& state = Runners.States[Index];
+	FVector& position = Runners.Positions[Index];
+	FVector& velocity = Runners.Velocities[Index];
+
+	//Vaults and climbs sweep the runner's capsule along the same path as the character's vault
+	//mode, ignoring only the wall. Anything else stops the runner short, and it carries on along
+	//the path from there
+	if (EnumHasAnyFlags(state, EParkourRunnerState::Vaulting))
+	{
+		float& actionTime = Runners.ActionTimes[Index];
+		actionTime += DeltaSeconds;
+
+		const float alpha = FMath::Clamp(actionTime / VaultDuration, 0.0f, 1.0f);
+		const FVector target = Runners.VaultPaths[Index].GetLocation(alpha);
+
+		FCollisionQueryParams vaultParams(Params);
+		if (const UPrimitiveComponent* obstacle = Runners.VaultObstacles[Index].Get())
+			vaultParams.AddIgnoredComponent(obstacle);
+
+		//Starting on the floor counts as touching it, which mustn't stop the runner rising off it
+		FHitResult hit;
+		if (world->SweepSingleByChannel(hit, position, target, FQuat::Identity, ECC_Parkour, FCollisionShape::MakeCapsule(CapsuleRadius, CapsuleHalfHeight), vaultParams) && !hit.bStartPenetrating)
+			position = hit.Location;
+		else
+			position = target;
+
+		//Drop onto whatever is below the end of the vault
+		if (alpha >= 1.0f)
+		{
+			state &= ~(EParkourRunnerState::Vaulting | EParkourRunnerState::Climbing);
+			state |= EParkourRunnerState::Falling;
+			velocity = FVector::ZeroVector;
+			Runners.VaultObstacles[Index].Reset();
+		}
+		return;
+	}
+
+	const FVector forward = FRotator(0.0f, Runners.Yaws[Index], 0.0f).Vector();
+
+	//Run straight along the wall without falling until the wall ends or something is in the way
+	if (EnumHasAnyFlags(state, EParkourRunnerState::WallRunning))
+	{
+		position += velocity * DeltaSeconds;
+
+		if (bProbe)
+		{
+			const FVector right = FRotator(0.0f, Runners.Yaws[Index], 0.0f).RotateVector(FVector::RightVector);
+			const bool bRightSide = EnumHasAnyFlags(state, EParkourRunnerState::RightSide);
+			const FVector sideEnd = position + right * (bRightSide ? WallRunProbeDistance : -WallRunProbeDistance);
+			const FVector forwardEnd = position + forward * FParkourLedgeProbe::ForwardDistance;
+
+			if (!world->LineTraceTestByChannel(position, sideEnd, ECC_Parkour, Params) || world->LineTraceTestByChannel(position, forwardEnd, ECC_Parkour, Params))
+			{
+				state &= ~(EParkourRunnerState::WallRunning | EParkourRunnerState::RightSide);
+				state |= EParkourRunnerState::Falling;
+			}
+		}
+		return;
+	}
+
+	if (EnumHasAnyFlags(state, EParkourRunnerState::Falling))
+	{
+		const FVector oldPosition = position;
+		velocity.Z += GravityZ * DeltaSeconds;
+		position += velocity * DeltaSeconds;
+
+		//Trace where the feet go this frame, landing on walkable floors and stopping against walls
+		FHitResult out;
+		const FVector feetEnd = position - FVector(0.0f, 0.0f, velocity.Z <= 0.0f ? CapsuleHalfHeight : 0.0f);
+		if (world->LineTraceSingleByChannel(out, oldPosition, feetEnd, ECC_Parkour, Params))
+		{
+			if (velocity.Z <= 0.0f && out.ImpactNormal.Z >= 0.7f)
+			{
+				position = out.Location + FVector(0.0f, 0.0f, CapsuleHalfHeight);
+				velocity.Z = 0.0f;
+				state &= ~EParkourRunnerState::Falling;
+				return;
+			}
+
+			position = FVector(oldPosition.X, oldPosition.Y, position.Z);
+			velocity.X = 0.0f;
+			velocity.Y = 0.0f;
+		}
+
+		//Only look for a wall to run on while falling downwards, like the character
+		if (bProbe && velocity.Z <= 0.0f)
+			ProbeWallRun(Index, Params);
+		return;
+	}
+
+	//Slides last a set time and start at random
+	FRandomStream& random = Runners.Random[Index];
+	float& actionTime = Runners.ActionTimes[Index];
+	if (EnumHasAnyFlags(state, EParkourRunnerState::Sliding))
+	{
+		actionTime += DeltaSeconds;
+		if (actionTime >= SlideDuration)
+			state &= ~EParkourRunnerState::Sliding;
+	}
+	else if (random.FRand() < SlideChance * DeltaSeconds)
+	{
+		state |= EParkourRunnerState::Sliding;
+		actionTime = 0.0f;
+	}
+
+	velocity = forward * (EnumHasAnyFlags(state, EParkourRunnerState::Sliding) ? SlideSpeed : RunSpeed);
+	position += velocity * DeltaSeconds;
+
+	//Follow the ground, stepping up and down like walking and falling off edges
+	FHitResult floor;
+	const FVector floorStart = position - FVector(0.0f, 0.0f, CapsuleHalfHeight - MaxStepHeight);
+	const FVector floorEnd = position - FVector(0.0f, 0.0f, CapsuleHalfHeight + MaxStepHeight);
+	if (world->LineTraceSingleByChannel(floor, floorStart, floorEnd, ECC_Parkour, Params))
+	{
+		position.Z = floor.Location.Z + CapsuleHalfHeight;
+	}
+	else
+	{
+		state |= EParkourRunnerState::Falling;
+		state &= ~EParkourRunnerState::Sliding;
+		return;
+	}
+
+	if (bProbe)
+		ProbeLedge(Index, Params);
+}
+
+/// <summary>
+/// Line traces to the right and then the left of a falling runner, starting a wall run on
+/// the first wall found unless it is tagged not to wall run on
+/// </summary>
+void AParkourCrowd::ProbeWallRun(int32 Index, const FCollisionQueryParams& Params)
+{
+	const FVector position = Runners.Positions[Index];
+	const FVector right = FRotator(0.0f, Runners.Yaws[Index], 0.0f).RotateVector(FVector::RightVector);
+
+	for (bool rightSide : { true, false })
+	{
+		FHitResult out;
+		const FVector endLocation = position + right * (rightSide ? WallRunProbeDistance : -WallRunProbeDistance);
+		if (!GetWorld()->LineTraceSingleByChannel(out, position, endLocation, ECC_Parkour, Params))
+			continue;
+
+		//If the wall can't be run on, stop looking
+		if (!EnumHasAnyFlags(UParkourPhysicalMaterial::GetSurface(out), EParkourSurface::WallRun))
+			return;
+
+		//Face along the wall, 90 degrees away from its normal, and run straight ahead
+		const float wallYaw = out.Normal.Rotation().Yaw + (rightSide ? 90.0f : -90.0f);
+		Runners.Yaws[Index] = wallYaw;
+		Runners.Velocities[Index] = FRotator(0.0f, wallYaw, 0.0f).Vector() * WallRunSpeed;
+
+		EParkourRunnerState& state = Runners.States[Index];
+		state &= ~EParkourRunnerState::Falling;
+		state |= EParkourRunnerState::WallRunning;
+		if (rightSide)
+			state |= EParkourRunnerState::RightSide;
+		return;
+	}
+}
+
+/// <summary>
+/// Checks the wall in front of a running runner. Walls with a top in reach are vaulted or
+/// climbed with the same probes as the character, other walls turn the runner away
+/// </summary>
+void AParkourCrowd::ProbeLedge(int32 Index, const FCollisionQueryParams& Params)
+{
+	const UWorld* world = GetWorld();
+	EParkourRunnerState& state = Runners.States[Index];
+	const FVector position = Runners.Positions[Index];
+	const FVector forward = FRotator(0.0f, Runners.Yaws[Index], 0.0f).Vector();
+
+	FVector probeStart = position;
+	probeStart.Z -= FParkourLedgeProbe::ProbeHeightOffset;
+
+	//Most runners have nothing in front of them, so only look for the ledge once something is
+	//hit. The hit is the wall face, so only the top probe is left to run
+	FHitResult blocked;
+	if (!world->LineTraceSingleByChannel(blocked, probeStart, probeStart + forward * FParkourLedgeProbe::ForwardDistance, ECC_Parkour, Params))
+		return;
+
+	//Sliding runners can't vault, like the character
+	FParkourLedge ledge;
+	bool hasLedge = false;
+	if (!EnumHasAnyFlags(state, EParkourRunnerState::Sliding))
+		hasLedge = LedgeIndex ? LedgeIndex->FindOrTraceLedge(probeStart, forward, blocked, Params, ledge) : FParkourLedgeProbe::TraceTop(world, blocked, Params, ledge);
+
+	if (hasLedge)
+	{
+		//Climbs end standing on top of the wall, vaults end past it and drop to the ground
+		const bool bClimb = ledge.Action == EParkourLedgeAction::Climb;
+		Runners.VaultPaths[Index] = FParkourLedgeProbe::GetVaultPath(position, CapsuleRadius, CapsuleHalfHeight, ledge.WallLocation, ledge.WallNormal, ledge.WallHeight.Z, ledge.Thickness, bClimb);
+		Runners.VaultObstacles[Index] = ledge.WallComponent;
+		Runners.ActionTimes[Index] = 0.0f;
+		Runners.Velocities[Index] = FVector::ZeroVector;
+
+		if (bClimb)
+			state |= EParkourRunnerState::Climbing;
+		state |= EParkourRunnerState::Vaulting;
+		return;
+	}
+
+	//Turn away from walls that can't be vaulted or climbed
+	const FVector away = FMath::GetReflectionVector(forward, blocked.ImpactNormal).GetSafeNormal2D();
+	Runners.Yaws[Index] = away.Rotation().Yaw + Runners.Random[Index].FRandRange(-30.0f, 30.0f);
+}
+
+/// <summary>
+/// Demotes promoted characters that are far from the player, drives the rest, and promotes
+/// runners that have come close to the player
+/// </summary>
+void AParkourCrowd::UpdatePromotion()
+{
+	SCOPE_CYCLE_COUNTER(STAT_ParkourCrowdPromotion);
+
+	APawn* playerPawn = UGameplayStatics::GetPlayerPawn(this, 0);
+	const float demoteDistanceSquared = FMath::Square(DemoteDistance);
+	const float promoteDistanceSquared = FMath::Square(PromoteDistance);
+	const bool bProbe = FrameCounter % (uint32)FMath::Max(1, ProbeInterval) == 0;
+
+	for (int32 i = PromotedCharacters.Num() - 1; i >= 0; --i)
+	{
+		ATestComplexSystemCharacter* character = PromotedCharacters[i];
+
+		//The character was destroyed by something else, leave the runner where it was last seen
+		if (!IsValid(character))
+		{
+			Runners.States[PromotedRunners[i]] = EParkourRunnerState::Falling;
+			PromotedCharacters.RemoveAtSwap(i);
+			PromotedRunners.RemoveAtSwap(i);
+			continue;
+		}
+
+		//Vaults finish as a character so the runner doesn't jump
+		const bool bFar = !playerPawn || FVector::DistSquared(character->GetActorLocation(), playerPawn->GetActorLocation()) > demoteDistanceSquared;
+		if (bFar && !character->GetParkourMovement()->IsVaulting())
+		{
+			Demote(i);
+			continue;
+		}
+
+		//Keep running forwards and turn around when stuck against something
+		UParkourMovementComponent* movement = character->GetParkourMovement();
+		if (movement->IsMovingOnGround() && !movement->IsVaulting() && movement->Velocity.SizeSquared2D() < FMath::Square(10.0f))
+			character->SetActorRotation(FRotator(0.0f, character->GetActorRotation().Yaw + 180.0f, 0.0f));
+		character->AddMovementInput(character->GetActorForwardVector());
+
+		//Vault or climb with the character's own check, it wall runs by itself in its tick
+		if (bProbe && movement->IsMovingOnGround() && !character->inAction && character->CheckForClimbing())
+			character->StartVaultOrGetUp();
+
+		Runners.Positions[PromotedRunners[i]] = character->GetActorLocation();
+	}
+
+	if (!playerPawn)
+		return;
+
+	const FVector playerLocation = playerPawn->GetActorLocation();
+	for (int32 i = 0; i < Runners.Num() && PromotedCharacters.Num() < MaxPromoted; ++i)
+	{
+		if (EnumHasAnyFlags(Runners.States[i], EParkourRunnerState::Promoted | EParkourRunnerState::Vaulting))
+			continue;
+
+		if (FVector::DistSquared(Runners.Positions[i], playerLocation) < promoteDistanceSquared)
+			Promote(i);
+	}
+}
+
+/// <summary>
+/// Spawns a full character where a runner is, carrying its velocity over
+/// </summary>
+/// <param name="Index">the runner to promote</param>
+void AParkourCrowd::Promote(int32 Index)
+{
+	UClass* characterClass = *PromotedClass;
+	if (!characterClass)
+	{
+		//Spawn the same class as the player if it is a parkour character so the blueprint setup is used
+		APawn* playerPawn = UGameplayStatics::GetPlayerPawn(this, 0);
+		characterClass = (playerPawn && playerPawn->IsA<ATestComplexSystemCharacter>()) ? playerPawn->GetClass() : ATestComplexSystemCharacter::StaticClass();
+	}
+
+	FActorSpawnParameters spawnParams;
+	spawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+
+	const FRotator rotation(0.0f, Runners.Yaws[Index], 0.0f);
+	ATestComplexSystemCharacter* character = GetWorld()->SpawnActor<ATestComplexSystemCharacter>(characterClass, Runners.Positions[Index], rotation, spawnParams);
+	if (!character)
+		return;
+
+	//The movement component only simulates characters that have a controller
+	character->SpawnDefaultController();
+
+	//Wall running characters find the wall again themselves while falling
+	UParkourMovementComponent* movement = character->GetParkourMovement();
+	movement->Velocity = Runners.Velocities[Index];
+	if (EnumHasAnyFlags(Runners.States[Index], EParkourRunnerState::Falling | EParkourRunnerState::WallRunning))
+		movement->SetMovementMode(MOVE_Falling);
+
+	Runners.States[Index] = EParkourRunnerState::Promoted;
+	PromotedCharacters.Add(character);
+	PromotedRunners.Add(Index);
+}
+
+/// <summary>
+/// Copies a promoted character back into its runner and destroys it
+/// </summary>
+/// <param name="PromotedIndex">the index of the character in the promoted characters</param>
+void AParkourCrowd::Demote(int32 PromotedIndex)
+{
+	ATestComplexSystemCharacter* character = PromotedCharacters[PromotedIndex];
+	const int32 index = PromotedRunners[PromotedIndex];
+
+	Runners.Positions[index] = character->GetActorLocation();
+	Runners.Velocities[index] = character->GetVelocity();
+	Runners.Yaws[index] = character->GetActorRotation().Yaw;
+
+	//Wall runs and slides are picked back up by the runner's own probes
+	Runners.States[index] = character->GetParkourMovement()->IsMovingOnGround() ? EParkourRunnerState::None : EParkourRunnerState::Falling;
+
+	character->Destroy();
+	PromotedCharacters.RemoveAtSwap(PromotedIndex);
+	PromotedRunners.RemoveAtSwap(PromotedIndex);
+}
+
+/// <summary>
+/// Moves every instance to its runner in one batch. The mesh sits on the ground below the
+/// capsule centre, is squashed while sliding and is hidden while promoted
+/// </summary>
+void AParkourCrowd::UpdateInstances()
+{
+	SCOPE_CYCLE_COUNTER(STAT_ParkourCrowdInstances);
+
+	InstanceTransforms.SetNum(Runners.Num(), false);
+	for (int32 i = 0; i < Runners.Num(); ++i)
+	{
+		const EParkourRunnerState state = Runners.States[i];
+		const FVector feet = Runners.Positions[i] - FVector(0.0f, 0.0f, CapsuleHalfHeight);
+
+		FVector scale = FVector::OneVector;
+		if (EnumHasAnyFlags(state, EParkourRunnerState::Promoted))
+			scale = FVector::ZeroVector;
+		else if (EnumHasAnyFlags(state, EParkourRunnerState::Sliding))
+			scale.Z = 0.5f;
+
+		InstanceTransforms[i] = FTransform(FRotator(0.0f, Runners.Yaws[i], 0.0f), feet, scale);
+	}
+
+	if (InstanceTransforms.Num() > 0)
+		RunnerInstances->BatchUpdateInstancesTransforms(0, InstanceTransforms, true, true, false);
+}
@@ -0,0 +1,161 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "ParkourTypes.h"
+#include "ParkourCrowd.generated.h"
+
+class ATestComplexSystemCharacter;
+class UInstancedStaticMeshComponent;
+class UPrimitiveComponent;
+class UParkourLedgeIndexSubsystem;
+
+//The state of every runner in a crowd, one array per field indexed by runner. The
+//update only touches the arrays it needs and each runner only writes its own slots,
+//so runners can be stepped in parallel
+struct FParkourCrowdRunners
+{
+	//Capsule centre and velocity, like the actor location and velocity of a character
+	TArray<FVector> Positions;
+	TArray<FVector> Velocities;
+	TArray<float> Yaws;
+	TArray<EParkourRunnerState> States;
+
+	//The path of a vault or climb and the wall it goes over, and how long it has been
+	//going, also used to time slides
+	TArray<FParkourVaultPath> VaultPaths;
+	TArray<TWeakObjectPtr<UPrimitiveComponent>> VaultObstacles;
+	TArray<float> ActionTimes;
+
+	//Each runner has its own random stream so the update is the same however it is split up
+	TArray<FRandomStream> Random;
+
+	int32 Num() const { return Positions.Num(); }
+
+	void SetNum(int32 Count);
+};
+
+/**
+ * Simulates thousands of background runners without an actor each. The runners follow
+ * the same wall run, climb and vault rules as ATestComplexSystemCharacter with the same
+ * probes, are stepped with ParallelFor and drawn as instances of one mesh. Runners that
+ * get close to the player are promoted to full characters and demoted back once they are
+ * far enough away again.
+ */
+UCLASS()
+class AParkourCrowd : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	AParkourCrowd();
+
+	virtual void Tick(float DeltaSeconds) override;
+
+	/** How many runners to spawn */
+	UPROPERTY(EditAnywhere, Category = "Parkour Crowd", meta = (ClampMin = "0"))
+	int32 NumRunners;
+
+	/** Runners are spawned within this distance of the crowd actor */
+	UPROPERTY(EditAnywhere, Category = "Parkour Crowd")
+	float SpawnRadius;
+
+	/** Seed for spawning the runners and their choices */
+	UPROPERTY(EditAnywhere, Category = "Parkour Crowd")
+	int32 Seed;
+
+	/** Character spawned for runners near the player, the player's class is used if not set */
+	UPROPERTY(EditAnywhere, Category = "Parkour Crowd")
+	TSubclassOf<ATestComplexSystemCharacter> PromotedClass;
+
+	/** Runners closer than this to the player become full characters */
+	UPROPERTY(EditAnywhere, Category = "Parkour Crowd")
+	float PromoteDistance;
+
+	/** Promoted runners further than this from the player go back into the crowd */
+	UPROPERTY(EditAnywhere, Category = "Parkour Crowd")
+	float DemoteDistance;
+
+	/** The most runners that are full characters at once */
+	UPROPERTY(EditAnywhere, Category = "Parkour Crowd")
+	int32 MaxPromoted;
+
+	/** Frames between the wall and ledge probes of a runner, spread out over the runners */
+	UPROPERTY(EditAnywhere, Category = "Parkour Crowd", meta = (ClampMin = "1"))
+	int32 ProbeInterval;
+
+	/** Movement of the runners, matching the defaults of the character and its movement component */
+	UPROPERTY(EditAnywhere, Category = "Parkour Crowd|Movement")
+	float RunSpeed;
+	UPROPERTY(EditAnywhere, Category = "Parkour Crowd|Movement")
+	float WallRunSpeed;
+	UPROPERTY(EditAnywhere, Category = "Parkour Crowd|Movement")
+	float WallRunProbeDistance;
+	UPROPERTY(EditAnywhere, Category = "Parkour Crowd|Movement")
+	float SlideSpeed;
+	UPROPERTY(EditAnywhere, Category = "Parkour Crowd|Movement")
+	float SlideDuration;
+	/** Chance per second of a running runner starting a slide */
+	UPROPERTY(EditAnywhere, Category = "Parkour Crowd|Movement")
+	float SlideChance;
+	UPROPERTY(EditAnywhere, Category = "Parkour Crowd|Movement")
+	float VaultDuration;
+	UPROPERTY(EditAnywhere, Category = "Parkour Crowd|Movement")
+	float CapsuleRadius;
+	UPROPERTY(EditAnywhere, Category = "Parkour Crowd|Movement")
+	float CapsuleHalfHeight;
+	UPROPERTY(EditAnywhere, Category = "Parkour Crowd|Movement")
+	float MaxStepHeight;
+
+	/** Returns the state of the runners */
+	const FParkourCrowdRunners& GetRunners() const { return Runners; }
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/** The mesh drawn for each runner */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Parkour Crowd")
+	UInstancedStaticMeshComponent* RunnerInstances;
+
+private:
+	/** Moves one runner on by a frame, only writes to the slots of that runner */
+	void StepRunner(int32 Index, float DeltaSeconds, float GravityZ, bool bProbe, const FCollisionQueryParams& Params);
+
+	/** Looks for a wall to run on either side of a falling runner */
+	void ProbeWallRun(int32 Index, const FCollisionQueryParams& Params);
+
+	/** Looks for a wall in front of a running runner to vault, climb or turn away from */
+	void ProbeLedge(int32 Index, const FCollisionQueryParams& Params);
+
+	/** Swaps runners near the player to full characters and characters far away back to runners */
+	void UpdatePromotion();
+
+	/** Spawns a full character for a runner */
+	void Promote(int32 Index);
+
+	/** Copies the character of a runner back into the crowd and destroys it */
+	void Demote(int32 PromotedIndex);
+
+	/** Moves the instances to the runners, hiding promoted runners */
+	void UpdateInstances();
+
+	FParkourCrowdRunners Runners;
+
+	/** The characters of promoted runners, and which runner each one is */
+	UPROPERTY(Transient)
+	TArray<ATestComplexSystemCharacter*> PromotedCharacters;
+	TArray<int32> PromotedRunners;
+
+	/** Baked ledges of the world, looked up by the runners before tracing */
+	UPROPERTY(Transient)
+	UParkourLedgeIndexSubsystem* LedgeIndex;
+
+	/** Instance transforms, reused every frame */
+	TArray<FTransform> InstanceTransforms;
+
+	//Counts frames to spread the probes of the runners out
+	uint32 FrameCounter;
+};
@@ -0,0 +1,404 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ParkourGhosts.h"
+#include "TestComplexSystem.h"
+#include "TestComplexSystemCharacter.h"
+#include "ParkourMovementComponent.h"
+#include "ParkourRecording.h"
+#include "ParkourStats.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+#include "Kismet/GameplayStatics.h"
+#include "UObject/ConstructorHelpers.h"
+
+DECLARE_CYCLE_STAT(TEXT("Ghosts"), STAT_ParkourGhosts, STATGROUP_Parkour);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Ghosts Playing"), STAT_ParkourGhostsPlaying, STATGROUP_Parkour);
+
+//A replaying character further than this from the recording is put back on it
+static const float ReplayResyncDistance = 300.0f;
+//How soon a replaying character behind the recording tries to catch up, in seconds
+static const float ReplayCatchUpTime = 0.5f;
+
+/// <summary>
+/// Starts or stops recording the first player's parkour run. Stopping writes the recording
+/// to Saved/Parkour/Recordings under the given name
+/// </summary>
+static void RecordParkour(const TArray<FString>& Args, UWorld* World)
+{
+	ATestComplexSystemCharacter* character = Cast<ATestComplexSystemCharacter>(UGameplayStatics::GetPlayerPawn(World, 0));
+	if (!character || Args.Num() == 0)
+		return;
+
+	if (Args[0] == TEXT("Start"))
+	{
+		character->StartRecording();
+		UE_LOG(LogParkour, Display, TEXT("Recording parkour run"));
+	}
+	else if (Args[0] == TEXT("Stop"))
+	{
+		const FString name = Args.Num() > 1 ? Args[1] : TEXT("Run");
+		const FString fileName = FParkourRecordingReader::GetRecordingFile(name);
+		if (character->StopRecording(fileName))
+			UE_LOG(LogParkour, Display, TEXT("Parkour run written to %s"), *fileName);
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs ParkourRecordCommand(
+	TEXT("parkour.Record"),
+	TEXT("Records the player's parkour run. Usage: parkour.Record Start | parkour.Record Stop <Name=Run>"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&RecordParkour));
+
+/// <summary>
+/// Finds the ghost player of the world, spawning one if there isn't one yet
+/// </summary>
+static AParkourGhosts* GetOrSpawnGhosts(UWorld* World)
+{
+	for (TActorIterator<AParkourGhosts> iterator(World); iterator; ++iterator)
+		return *iterator;
+
+	return World->SpawnActor<AParkourGhosts>();
+}
+
+static void PlayParkourGhosts(const TArray<FString>& Args, UWorld* World)
+{
+	if (!World || Args.Num() == 0)
+		return;
+
+	if (Args[0] == TEXT("Clear"))
+	{
+		for (TActorIterator<AParkourGhosts> iterator(World); iterator; ++iterator)
+			iterator->Destroy();
+		return;
+	}
+
+	const int32 count = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 24;
+	const float spacing = Args.Num() > 2 ? FCString::Atof(*Args[2]) : 0.5f;
+	if (AParkourGhosts* ghosts = GetOrSpawnGhosts(World))
+		ghosts->PlayGhosts(Args[0], count, spacing);
+}
+
+static FAutoConsoleCommandWithWorldAndArgs ParkourGhostsCommand(
+	TEXT("parkour.Ghosts"),
+	TEXT("Plays a recorded parkour run as looping ghosts. Usage: parkour.Ghosts <Name> <Count=24> <Spacing=0.5> | parkour.Ghosts Clear"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&PlayParkourGhosts));
+
+static void ReplayParkour(const TArray<FString>& Args, UWorld* World)
+{
+	if (!World || Args.Num() == 0)
+		return;
+
+	const int32 count = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 1;
+	if (AParkourGhosts* ghosts = GetOrSpawnGhosts(World))
+		ghosts->Replay(Args[0], count);
+}
+
+static FAutoConsoleCommandWithWorldAndArgs ParkourReplayCommand(
+	TEXT("parkour.Replay"),
+	TEXT("Replays a recorded parkour run with full characters steered along it and logs the frame times and the parkour modes they went through. Usage: parkour.Replay <Name> <Count=1>"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&ReplayParkour));
+
+//////////////////////////////////////////////////////////////////////////
+// AParkourGhosts
+
+AParkourGhosts::AParkourGhosts()
+{
+	PrimaryActorTick.bCanEverTick = true;
+
+	//The ghosts are drawn with world space instances so the component stays at the origin
+	GhostInstances = CreateDefaultSubobject<UInstancedStaticMeshComponent>(TEXT("GhostInstances"));
+	GhostInstances->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	GhostInstances->SetGenerateOverlapEvents(false);
+	GhostInstances->SetCastShadow(false);
+	RootComponent = GhostInstances;
+
+	static ConstructorHelpers::FObjectFinder<UStaticMesh> cylinder(TEXT("/Engine/BasicShapes/Cylinder.Cylinder"));
+	if (cylinder.Succeeded())
+		GhostInstances->SetStaticMesh(cylinder.Object);
+
+	//The engine cylinder is 100 across and 100 tall, scaled to a 42 by 96 capsule
+	CapsuleHalfHeight = 96.0f;
+	GhostScale = FVector(0.84f, 0.84f, 1.92f);
+
+	LastReplayFrameTime = 0.0;
+	ReplayStartTraceCount = 0;
+	ReplayResyncs = 0;
+}
+
+void AParkourGhosts::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	for (const FReplayer& replayer : Replayers)
+	{
+		if (replayer.Character.IsValid())
+			replayer.Character->Destroy();
+	}
+	Replayers.Reset();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+TSharedPtr<FParkourRecordingReader> AParkourGhosts::OpenRecording(const FString& Name)
+{
+	if (TSharedPtr<FParkourRecordingReader>* recording = Recordings.Find(Name))
+		return *recording;
+
+	TSharedPtr<FParkourRecordingReader> recording = MakeShared<FParkourRecordingReader>();
+	if (!recording->Open(FParkourRecordingReader::GetRecordingFile(Name)))
+	{
+		UE_LOG(LogParkour, Warning, TEXT("Couldn't open parkour recording %s"), *Name);
+		return nullptr;
+	}
+
+	Recordings.Add(Name, recording);
+	return recording;
+}
+
+bool AParkourGhosts::PlayGhosts(const FString& Name, int32 Count, float Spacing)
+{
+	TSharedPtr<FParkourRecordingReader> recording = OpenRecording(Name);
+	if (!recording)
+		return false;
+
+	for (int32 i = 0; i < Count; ++i)
+	{
+		Ghosts.Add({ recording, -i * Spacing });
+		GhostInstances->AddInstanceWorldSpace(FTransform(FQuat::Identity, FVector::ZeroVector, FVector::ZeroVector));
+	}
+	return true;
+}
+
+/// <summary>
+/// Spawns characters at the start of the recording. They have no controller, so their
+/// movement component is told to run without one, and moves them from the input the replay
+/// gives them each frame. Their own tick runs the parkour probes between the two, outside
+/// the probe budget so the replay doesn't change with the load
+/// </summary>
+bool AParkourGhosts::Replay(const FString& Name, int32 Count)
+{
+	if (Replayers.Num() > 0)
+	{
+		UE_LOG(LogParkour, Warning, TEXT("A parkour replay is already running"));
+		return false;
+	}
+
+	TSharedPtr<FParkourRecordingReader> recording = OpenRecording(Name);
+	if (!recording)
+		return false;
+
+	FActorSpawnParameters spawnParams;
+	spawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	for (int32 i = 0; i < Count; ++i)
+	{
+		ATestComplexSystemCharacter* character = GetWorld()->SpawnActor<ATestComplexSystemCharacter>(ATestComplexSystemCharacter::StaticClass(), recording->GetLocation(0), FRotator(0.0f, recording->GetYaw(0), 0.0f), spawnParams);
+		if (!character)
+			continue;
+
+		character->GetParkourMovement()->bRunPhysicsWithNoController = true;
+		character->SetProbeBudgetExempt(true);
+		character->AddTickPrerequisiteActor(this);
+		Replayers.Add({ character, recording, 0.0f, 0, character->GetParkourMovement()->MaxWalkSpeed });
+	}
+
+	//Counts the frames the recording spent in each parkour mode, to check the replay goes through them too
+	RecordedModeFrames = FReplayModeFrames();
+	for (int32 sample = 0; sample < recording->GetNumSamples(); ++sample)
+	{
+		const EParkourRunnerState state = recording->GetState(sample);
+		RecordedModeFrames.WallRun += EnumHasAnyFlags(state, EParkourRunnerState::WallRunning) ? 1 : 0;
+		RecordedModeFrames.Slide += EnumHasAnyFlags(state, EParkourRunnerState::Sliding) ? 1 : 0;
+		RecordedModeFrames.Vault += EnumHasAnyFlags(state, EParkourRunnerState::Vaulting | EParkourRunnerState::Climbing) ? 1 : 0;
+	}
+
+	ReplayName = Name;
+	ReplayModeFrames = FReplayModeFrames();
+	ReplayResyncs = 0;
+	ReplayFrameTimes.Reset();
+	LastReplayFrameTime = FPlatformTime::Seconds();
+#if PARKOUR_PROFILING
+	ReplayStartTraceCount = GParkourTraceCount;
+#endif
+	return Replayers.Num() > 0;
+}
+
+void AParkourGhosts::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	SCOPE_CYCLE_COUNTER(STAT_ParkourGhosts);
+
+	if (Replayers.Num() > 0)
+		UpdateReplays(DeltaSeconds);
+
+	if (Ghosts.Num() > 0)
+		UpdateGhosts(DeltaSeconds);
+}
+
+/// <summary>
+/// Steers every replaying character towards where the recording is a moment ahead and does
+/// the actions recorded up to now. The movement component does the moving, so slides,
+/// vaults, wall runs and wall jumps run their own physics. A character that falls too far
+/// behind, for example after missing a wall run, is put back on the recording
+/// </summary>
+/// <param name="DeltaSeconds">the frame time</param>
+void AParkourGhosts::UpdateReplays(float DeltaSeconds)
+{
+	const double now = FPlatformTime::Seconds();
+	ReplayFrameTimes.Add((float)((now - LastReplayFrameTime) * 1000.0));
+	LastReplayFrameTime = now;
+
+	bool bAnyPlaying = false;
+	for (FReplayer& replayer : Replayers)
+	{
+		ATestComplexSystemCharacter* character = replayer.Character.Get();
+		const FParkourRecordingReader& recording = *replayer.Recording;
+		if (!character || replayer.Time > recording.GetDuration())
+			continue;
+
+		bAnyPlaying = true;
+		replayer.Time += DeltaSeconds;
+		const float sampleInterval = recording.GetSampleInterval();
+		const int32 sample = FMath::Min(FMath::FloorToInt(replayer.Time / sampleInterval), recording.GetNumSamples() - 1);
+		const int32 nextSample = FMath::Min(sample + 1, recording.GetNumSamples() - 1);
+
+		UParkourMovementComponent* movement = character->GetParkourMovement();
+		ReplayModeFrames.WallRun += movement->IsWallRunning() ? 1 : 0;
+		ReplayModeFrames.Slide += movement->IsSliding() ? 1 : 0;
+		ReplayModeFrames.Vault += movement->IsVaulting() ? 1 : 0;
+
+		FVector recordedLocation;
+		float recordedYaw;
+		EParkourRunnerState recordedState;
+		recording.Evaluate(replayer.Time, recordedLocation, recordedYaw, recordedState);
+
+		if (FVector::Dist(character->GetActorLocation(), recordedLocation) > ReplayResyncDistance)
+		{
+			character->SetActorLocationAndRotation(recordedLocation, FRotator(0.0f, recordedYaw, 0.0f), false, nullptr, ETeleportType::TeleportPhysics);
+			++ReplayResyncs;
+		}
+
+		//Walk as fast as the recording goes, and faster when behind it
+		FVector target;
+		recording.Evaluate(replayer.Time + sampleInterval, target, recordedYaw, recordedState);
+		const FVector toTarget = target - character->GetActorLocation();
+		const float recordedSpeed = FVector::Dist2D(recording.GetLocation(sample), recording.GetLocation(nextSample)) / sampleInterval;
+		character->SetMoveSpeed(FMath::Max(replayer.WalkSpeed, recordedSpeed));
+		const float inputScale = FMath::Max(recordedSpeed, toTarget.Size2D() / ReplayCatchUpTime) / movement->MaxWalkSpeed;
+		character->AddMovementInput(toTarget.GetSafeNormal2D(), FMath::Clamp(inputScale, 0.0f, 1.0f));
+
+		for (; replayer.NextAction < recording.GetNumActions() && (int32)recording.GetAction(replayer.NextAction).Sample <= sample; ++replayer.NextAction)
+		{
+			switch (recording.GetAction(replayer.NextAction).Action)
+			{
+			case EParkourRecordedAction::StartSlide:
+				character->StartSlide();
+				break;
+			case EParkourRecordedAction::StopSlide:
+				character->StopSlide();
+				break;
+			case EParkourRecordedAction::VaultOrGetUp:
+				//The climb check probes straight ahead, so face the way the recording did
+				character->SetActorRotation(FRotator(0.0f, recording.GetYaw(sample), 0.0f));
+				if (character->CheckForClimbing())
+					character->StartVaultOrGetUp();
+				break;
+			case EParkourRecordedAction::Jump:
+			case EParkourRecordedAction::WallJump:
+				character->CheckJump();
+				break;
+			}
+		}
+	}
+
+	if (!bAnyPlaying)
+		ReportReplay();
+}
+
+/// <summary>
+/// Logs the frame times and trace count of the replay and removes its characters
+/// </summary>
+void AParkourGhosts::ReportReplay()
+{
+	for (const FReplayer& replayer : Replayers)
+	{
+		if (replayer.Character.IsValid())
+			replayer.Character->Destroy();
+	}
+	Replayers.Reset();
+
+	//The first frame time is from starting the replay to the first step
+	if (ReplayFrameTimes.Num() > 1)
+		ReplayFrameTimes.RemoveAt(0);
+	ReplayFrameTimes.Sort();
+
+	float total = 0.0f;
+	for (float frameTime : ReplayFrameTimes)
+		total += frameTime;
+
+	const int32 numFrames = FMath::Max(1, ReplayFrameTimes.Num());
+	const float p95 = ReplayFrameTimes.Num() > 0 ? ReplayFrameTimes[FMath::Min(ReplayFrameTimes.Num() - 1, FMath::FloorToInt(0.95f * ReplayFrameTimes.Num()))] : 0.0f;
+	const float max = ReplayFrameTimes.Num() > 0 ? ReplayFrameTimes.Last() : 0.0f;
+
+	uint32 traces = 0;
+#if PARKOUR_PROFILING
+	traces = GParkourTraceCount - ReplayStartTraceCount;
+#endif
+
+	UE_LOG(LogParkour, Display, TEXT("parkour.Replay %s: %d frames, mean %.3fms, p95 %.3fms, max %.3fms, %u parkour traces, %d resyncs"),
+		*ReplayName, ReplayFrameTimes.Num(), total / numFrames, p95, max, traces, ReplayResyncs);
+	UE_LOG(LogParkour, Display, TEXT("parkour.Replay %s: character frames wall running %d, sliding %d, vaulting %d, recorded samples %d, %d, %d"),
+		*ReplayName, ReplayModeFrames.WallRun, ReplayModeFrames.Slide, ReplayModeFrames.Vault, RecordedModeFrames.WallRun, RecordedModeFrames.Slide, RecordedModeFrames.Vault);
+
+	//A replay that never gets into a mode the recording went through isn't measuring the same work
+	if ((RecordedModeFrames.WallRun > 0 && ReplayModeFrames.WallRun == 0)
+		|| (RecordedModeFrames.Slide > 0 && ReplayModeFrames.Slide == 0)
+		|| (RecordedModeFrames.Vault > 0 && ReplayModeFrames.Vault == 0))
+	{
+		UE_LOG(LogParkour, Warning, TEXT("parkour.Replay %s: the characters never entered a parkour mode the recording went through"), *ReplayName);
+	}
+}
+
+/// <summary>
+/// Moves every ghost along its recording and updates all of the instances in one batch.
+/// Ghosts that haven't started yet are hidden, finished ghosts start again
+/// </summary>
+void AParkourGhosts::UpdateGhosts(float DeltaSeconds)
+{
+	InstanceTransforms.SetNum(Ghosts.Num(), false);
+	for (int32 i = 0; i < Ghosts.Num(); ++i)
+	{
+		FGhost& ghost = Ghosts[i];
+		const FParkourRecordingReader& recording = *ghost.Recording;
+
+		ghost.Time += DeltaSeconds;
+		if (ghost.Time > recording.GetDuration())
+			ghost.Time = recording.GetDuration() > 0.0f ? FMath::Fmod(ghost.Time, recording.GetDuration()) : 0.0f;
+
+		if (ghost.Time < 0.0f)
+		{
+			InstanceTransforms[i] = FTransform(FQuat::Identity, FVector::ZeroVector, FVector::ZeroVector);
+			continue;
+		}
+
+		FVector location;
+		float yaw;
+		EParkourRunnerState state;
+		recording.Evaluate(ghost.Time, location, yaw, state);
+
+		//Sliding ghosts are squashed down onto the ground
+		FVector scale = GhostScale;
+		if (EnumHasAnyFlags(state, EParkourRunnerState::Sliding))
+		{
+			scale.Z *= 0.5f;
+			location.Z -= CapsuleHalfHeight * 0.5f;
+		}
+
+		InstanceTransforms[i] = FTransform(FRotator(0.0f, yaw, 0.0f), location, scale);
+	}
+
+	GhostInstances->BatchUpdateInstancesTransforms(0, InstanceTransforms, true, true, false);
+	SET_DWORD_STAT(STAT_ParkourGhostsPlaying, Ghosts.Num());
+}
@@ -0,0 +1,118 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "ParkourGhosts.generated.h"
+
+class ATestComplexSystemCharacter;
+class FParkourRecordingReader;
+class UInstancedStaticMeshComponent;
+
+/**
+ * Plays back parkour recordings. Ghosts are drawn as instances of one mesh straight from
+ * the mapped recordings, with no characters, ticking or traces, so dozens can run at once.
+ * Replays instead steer full characters along a recording with movement input and do the
+ * recorded actions on their samples, so their movement component runs the same slides,
+ * vaults, wall runs and wall jumps on every run and the frame times can be compared
+ * between builds.
+ */
+UCLASS()
+class AParkourGhosts : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	AParkourGhosts();
+
+	virtual void Tick(float DeltaSeconds) override;
+
+	/**
+	 * Adds ghosts playing a recording over and over.
+	 * @param Name		the name of the recording in Saved/Parkour/Recordings
+	 * @param Count		how many ghosts to add
+	 * @param Spacing	seconds between the starts of the ghosts
+	 * @return false if the recording couldn't be opened
+	 */
+	bool PlayGhosts(const FString& Name, int32 Count, float Spacing);
+
+	/**
+	 * Replays a recording with full characters doing the recorded actions.
+	 * @param Name		the name of the recording in Saved/Parkour/Recordings
+	 * @param Count		how many characters replay it at once
+	 * @return false if the recording couldn't be opened
+	 */
+	bool Replay(const FString& Name, int32 Count);
+
+	/** Half height of the recorded capsule, the ghost mesh is centred on the capsule */
+	UPROPERTY(EditAnywhere, Category = "Parkour Ghosts")
+	float CapsuleHalfHeight;
+
+	/** Scale of the ghost mesh, the default fits the engine cylinder to the character capsule */
+	UPROPERTY(EditAnywhere, Category = "Parkour Ghosts")
+	FVector GhostScale;
+
+protected:
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/** The mesh drawn for each ghost */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Parkour Ghosts")
+	UInstancedStaticMeshComponent* GhostInstances;
+
+private:
+	/** Opens a recording, or returns the one already open with that name */
+	TSharedPtr<FParkourRecordingReader> OpenRecording(const FString& Name);
+
+	/** Steers the replaying characters along their recording and does their actions */
+	void UpdateReplays(float DeltaSeconds);
+
+	/** Moves the ghost instances along their recordings */
+	void UpdateGhosts(float DeltaSeconds);
+
+	/** Logs the frame times of a finished replay and the parkour modes it went through */
+	void ReportReplay();
+
+	struct FGhost
+	{
+		TSharedPtr<FParkourRecordingReader> Recording;
+		//Seconds into the recording, below zero until the ghost starts
+		float Time;
+	};
+
+	struct FReplayer
+	{
+		TWeakObjectPtr<ATestComplexSystemCharacter> Character;
+		TSharedPtr<FParkourRecordingReader> Recording;
+		//Seconds into the recording
+		float Time;
+		int32 NextAction;
+		//The character's walk speed before the replay sped it up to keep up with the recording
+		float WalkSpeed;
+	};
+
+	//Frames spent in each parkour mode by the replaying characters, and in the recording
+	struct FReplayModeFrames
+	{
+		int32 WallRun = 0;
+		int32 Slide = 0;
+		int32 Vault = 0;
+	};
+
+	TMap<FString, TSharedPtr<FParkourRecordingReader>> Recordings;
+	TArray<FGhost> Ghosts;
+	TArray<FReplayer> Replayers;
+
+	/** Instance transforms, reused every frame */
+	TArray<FTransform> InstanceTransforms;
+
+	//Frame times of the replay running, in milliseconds
+	TArray<float> ReplayFrameTimes;
+	double LastReplayFrameTime;
+	uint32 ReplayStartTraceCount;
+	FString ReplayName;
+	FReplayModeFrames ReplayModeFrames;
+	FReplayModeFrames RecordedModeFrames;
+	//Times a character fell too far behind the recording and was put back on it
+	int32 ReplayResyncs;
+};
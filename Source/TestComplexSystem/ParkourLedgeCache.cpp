@@ -0,0 +1,167 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ParkourLedgeCache.h"
+#include "ParkourLedgeProbe.h"
+#include "ParkourStats.h"
+#include "Components/PrimitiveComponent.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Climb Cache Hits"), STAT_ParkourClimbCacheHits, STATGROUP_Parkour);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Climb Cache Misses"), STAT_ParkourClimbCacheMisses, STATGROUP_Parkour);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Climb Cache Evictions"), STAT_ParkourClimbCacheEvictions, STATGROUP_Parkour);
+
+//How far a wall can move before its entries are dropped
+static const float ComponentMoveTolerance = 0.1f;
+
+FParkourLedgeCache::FKey FParkourLedgeCache::MakeKey(const FHitResult& WallHit)
+{
+	FKey key;
+	key.Component = WallHit.GetComponent();
+	key.Cell = FIntVector(FMath::FloorToInt(WallHit.Location.X / CellSize), FMath::FloorToInt(WallHit.Location.Y / CellSize), FMath::FloorToInt(WallHit.Location.Z / CellSize));
+	key.NormalYaw = FRotator::CompressAxisToByte(WallHit.Normal.Rotation().Yaw);
+	return key;
+}
+
+/// <summary>
+/// Finds the entry for the hit and checks the wall hasn't moved since it was added. The
+/// top of the wall and its thickness are kept, the rest of the ledge is built around the
+/// new hit the same way the top probe builds it. An entry found in the old generation is
+/// moved into the current one so it outlives the next eviction
+/// </summary>
+bool FParkourLedgeCache::Find(const FHitResult& WallHit, FParkourLedge& OutLedge, bool& bOutHasLedge)
+{
+	UPrimitiveComponent* component = WallHit.GetComponent();
+	if (!component)
+	{
+		++Misses;
+		PARKOUR_COUNT(ClimbCacheMisses, 1);
+		return false;
+	}
+
+	const FKey key = MakeKey(WallHit);
+	FEntry entry;
+	bool bFound = false;
+	bool bOld = false;
+	{
+		FReadScopeLock readLock(Lock);
+		if (const FEntry* currentEntry = Entries.Find(key))
+		{
+			entry = *currentEntry;
+			bFound = true;
+		}
+		else if (const FEntry* oldEntry = OldEntries.Find(key))
+		{
+			entry = *oldEntry;
+			bFound = bOld = true;
+		}
+	}
+
+	const bool bMoved = bFound && !entry.ComponentTransform.Equals(component->GetComponentTransform(), ComponentMoveTolerance);
+	if (bMoved || bOld)
+	{
+		//Drop the entry of a wall that has moved, what was found on it is out of date. An old
+		//entry that is still right goes back into the current generation
+		FWriteScopeLock writeLock(Lock);
+		if (bOld)
+			OldEntries.Remove(key);
+		else
+			Entries.Remove(key);
+
+		if (bOld && !bMoved)
+			AddEntry(key, entry);
+	}
+
+	if (!bFound || bMoved)
+	{
+		++Misses;
+		PARKOUR_COUNT(ClimbCacheMisses, 1);
+		return false;
+	}
+
+	OutLedge.WallLocation = WallHit.Location;
+	OutLedge.WallNormal = WallHit.Normal;
+	OutLedge.WallComponent = component;
+	OutLedge.Thickness = entry.Thickness;
+	OutLedge.WallHeight = WallHit.Location - WallHit.Normal * FParkourLedgeProbe::HeightProbeDepth;
+	OutLedge.WallHeight.Z = entry.WallTopZ;
+	OutLedge.OtherWallHeight = WallHit.Location - WallHit.Normal * entry.Thickness;
+	OutLedge.OtherWallHeight.Z = entry.WallTopZ;
+	FParkourLedgeProbe::Classify(OutLedge);
+	bOutHasLedge = entry.bHasLedge;
+	if (!bOutHasLedge)
+		OutLedge.Action = EParkourLedgeAction::None;
+
+	++Hits;
+	PARKOUR_COUNT(ClimbCacheHits, 1);
+	return true;
+}
+
+void FParkourLedgeCache::Add(const FHitResult& WallHit, const FParkourLedge* Ledge)
+{
+	UPrimitiveComponent* component = WallHit.GetComponent();
+	if (!component)
+		return;
+
+	FEntry entry;
+	entry.Component = component;
+	entry.ComponentTransform = component->GetComponentTransform();
+	entry.WallTopZ = Ledge ? Ledge->WallHeight.Z : 0.0f;
+	entry.Thickness = Ledge ? Ledge->Thickness : 0.0f;
+	entry.bHasLedge = Ledge != nullptr;
+
+	const FKey key = MakeKey(WallHit);
+
+	FWriteScopeLock writeLock(Lock);
+	OldEntries.Remove(key);
+	AddEntry(key, entry);
+}
+
+/// <summary>
+/// Once the current generation is full it replaces the old one, dropping only the entries
+/// that weren't found again since the last time, instead of the whole cache at once
+/// </summary>
+void FParkourLedgeCache::AddEntry(const FKey& Key, const FEntry& Entry)
+{
+	if (Entries.Num() >= MaxEntries / 2 && !Entries.Contains(Key))
+	{
+		Evictions += OldEntries.Num();
+		PARKOUR_COUNT(ClimbCacheEvictions, OldEntries.Num());
+		OldEntries = MoveTemp(Entries);
+		Entries.Reset();
+	}
+
+	Entries.Add(Key, Entry);
+}
+
+/// <summary>
+/// Streamed out walls can't be hit again, so their entries would only take up room
+/// </summary>
+void FParkourLedgeCache::RemoveLevel(const ULevel* Level)
+{
+	FWriteScopeLock writeLock(Lock);
+	for (TMap<FKey, FEntry>* generation : { &Entries, &OldEntries })
+	{
+		for (auto it = generation->CreateIterator(); it; ++it)
+		{
+			const UPrimitiveComponent* component = it->Value.Component.Get();
+			if (!component || component->GetComponentLevel() == Level)
+				it.RemoveCurrent();
+		}
+	}
+}
+
+void FParkourLedgeCache::Empty()
+{
+	FWriteScopeLock writeLock(Lock);
+	Entries.Empty();
+	OldEntries.Empty();
+	Hits = 0;
+	Misses = 0;
+	Evictions = 0;
+}
+
+int32 FParkourLedgeCache::Num() const
+{
+	FReadScopeLock readLock(Lock);
+	return Entries.Num() + OldEntries.Num();
+}
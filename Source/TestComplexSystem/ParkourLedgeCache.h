@@ -0,0 +1,98 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/ScopeRWLock.h"
+#include "Templates/Atomic.h"
+#include "UObject/ObjectKey.h"
+#include "ParkourTypes.h"
+
+class UPrimitiveComponent;
+class ULevel;
+
+/**
+ * Remembers what the top probe found on walls the forward probe has already hit, so characters
+ * running at the same wall again only pay for the forward trace. Entries are keyed by the wall
+ * component, the contact point snapped to a grid and the facing of the wall. An entry is dropped
+ * when its wall has moved since it was added, and the entries of a level are dropped when the
+ * level is unloaded. Entries are kept in two generations. New entries go in the current one,
+ * and when it is full it becomes the old one and the old one is dropped, so only the walls
+ * nobody has run at since are evicted. Entries found in the old generation move back into the
+ * current one. Safe to use from any thread.
+ */
+class FParkourLedgeCache
+{
+public:
+	//Contact points closer than this share an entry
+	static constexpr float CellSize = 20.0f;
+	//The most entries kept across both generations, each generation holds half
+	static constexpr int32 MaxEntries = 8192;
+
+	/**
+	 * Looks up the top of a wall the forward probe hit.
+	 * @param WallHit		the hit of the forward probe on the wall face
+	 * @param OutLedge		the cached wall, built around the new hit
+	 * @param bOutHasLedge	set to whether the wall has a top to climb or vault onto
+	 * @return true if the wall was in the cache
+	 */
+	bool Find(const FHitResult& WallHit, FParkourLedge& OutLedge, bool& bOutHasLedge);
+
+	/**
+	 * Adds what the top probe found on a wall.
+	 * @param WallHit	the hit of the forward probe on the wall face
+	 * @param Ledge		the wall the top probe found, or null if it found no top
+	 */
+	void Add(const FHitResult& WallHit, const FParkourLedge* Ledge);
+
+	/** Drops the entries of walls in a level, and of walls that no longer exist */
+	void RemoveLevel(const ULevel* Level);
+
+	void Empty();
+
+	int32 Num() const;
+	uint64 GetHits() const { return Hits; }
+	uint64 GetMisses() const { return Misses; }
+	uint64 GetEvictions() const { return Evictions; }
+
+private:
+	struct FKey
+	{
+		TObjectKey<UPrimitiveComponent> Component;
+		FIntVector Cell;
+		uint8 NormalYaw;
+
+		bool operator==(const FKey& Other) const
+		{
+			return Component == Other.Component && Cell == Other.Cell && NormalYaw == Other.NormalYaw;
+		}
+
+		friend uint32 GetTypeHash(const FKey& Key)
+		{
+			return HashCombine(HashCombine(GetTypeHash(Key.Component), GetTypeHash(Key.Cell)), Key.NormalYaw);
+		}
+	};
+
+	struct FEntry
+	{
+		TWeakObjectPtr<UPrimitiveComponent> Component;
+		//Where the wall was when the entry was added
+		FTransform ComponentTransform;
+		float WallTopZ;
+		float Thickness;
+		bool bHasLedge;
+	};
+
+	static FKey MakeKey(const FHitResult& WallHit);
+
+	/** Adds an entry to the current generation, starting a new generation if it is full. Needs the write lock */
+	void AddEntry(const FKey& Key, const FEntry& Entry);
+
+	TMap<FKey, FEntry> Entries;
+	TMap<FKey, FEntry> OldEntries;
+	mutable FRWLock Lock;
+
+	TAtomic<uint64> Hits{ 0 };
+	TAtomic<uint64> Misses{ 0 };
+	TAtomic<uint64> Evictions{ 0 };
+};
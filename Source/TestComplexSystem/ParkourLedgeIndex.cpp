@@ -0,0 +1,203 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ParkourLedgeIndex.h"
+#include "ParkourLedgeProbe.h"
+#include "Engine/World.h"
+#include "Components/PrimitiveComponent.h"
+#include "Algo/BinarySearch.h"
+
+//Character capsule half height, used to stand the baked probes on the floor
+static const float BakeCapsuleHalfHeight = 96.0f;
+//How far a baked wall face can be from the forward probe and still count as hit
+static const float LedgeMatchTolerance = 30.0f;
+//Two baked faces closer than this facing the same way are merged
+static const float LedgeMergeDistance = 20.0f;
+
+UParkourLedgeIndex::UParkourLedgeIndex()
+{
+	Bounds.Init();
+	CellSize = 200.0f;
+}
+
+uint64 UParkourLedgeIndex::GetCellKey(int32 X, int32 Y, int32 Z) const
+{
+	//21 bits per axis is plenty for any level at this cell size
+	return ((uint64)(X & 0x1FFFFF) << 42) | ((uint64)(Y & 0x1FFFFF) << 21) | (uint64)(Z & 0x1FFFFF);
+}
+
+uint64 UParkourLedgeIndex::GetCellKey(const FVector& Location) const
+{
+	return GetCellKey(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize), FMath::FloorToInt(Location.Z / CellSize));
+}
+
+/// <summary>
+/// Bakes every climbable or vaultable static wall face in the bounds into the grid
+/// </summary>
+void UParkourLedgeIndex::Build(UWorld* World, const FBox& InBounds, float SampleSpacing, const AActor* IgnoreActor)
+{
+	Bounds = InBounds;
+	CellKeys.Reset();
+	CellStarts.Reset();
+	Entries.Reset();
+
+	if (!World || !Bounds.IsValid || SampleSpacing <= 0.0f)
+		return;
+
+	FCollisionQueryParams TraceParams(SCENE_QUERY_STAT(ParkourLedgeBake));
+	TraceParams.AddIgnoredActor(IgnoreActor);
+	TraceParams.bReturnPhysicalMaterial = true;
+
+	//The eight directions a character can face the wall from
+	FVector directions[8];
+	for (int32 i = 0; i < 8; ++i)
+		directions[i] = FRotator(0.0f, i * 45.0f, 0.0f).Vector();
+
+	TMap<uint64, TArray<FParkourLedgeEntry>> cells;
+
+	for (float x = Bounds.Min.X; x <= Bounds.Max.X; x += SampleSpacing)
+	{
+		for (float y = Bounds.Min.Y; y <= Bounds.Max.Y; y += SampleSpacing)
+		{
+			//Walk down the column finding every floor a character could stand on
+			FVector traceStart(x, y, Bounds.Max.Z);
+			const FVector traceEnd(x, y, Bounds.Min.Z);
+			for (int32 floor = 0; floor < 16; ++floor)
+			{
+				FHitResult floorHit;
+				if (!World->LineTraceSingleByChannel(floorHit, traceStart, traceEnd, ECC_Parkour, TraceParams))
+					break;
+				traceStart.Z = floorHit.Location.Z - 1.0f;
+
+				if (floorHit.Normal.Z < 0.7f)
+					continue;
+
+				FVector probeStart = floorHit.Location;
+				probeStart.Z += BakeCapsuleHalfHeight - FParkourLedgeProbe::ProbeHeightOffset;
+
+				for (const FVector& direction : directions)
+				{
+					FParkourLedge ledge;
+					if (!FParkourLedgeProbe::Trace(World, probeStart, direction, TraceParams, ledge))
+						continue;
+
+					//Anything that can move has to be probed at runtime
+					if (!ledge.WallComponent || ledge.WallComponent->Mobility != EComponentMobility::Static)
+						continue;
+
+					FParkourLedgeEntry entry;
+					entry.WallLocation = ledge.WallLocation;
+					entry.WallTopZ = ledge.WallHeight.Z;
+					entry.Thickness = ledge.Thickness;
+					entry.NormalYaw = FRotator::CompressAxisToShort(ledge.WallNormal.Rotation().Yaw);
+					entry.Reserved = 0;
+
+					//Skip faces that are already baked from a neighbouring sample
+					TArray<FParkourLedgeEntry>& cell = cells.FindOrAdd(GetCellKey(entry.WallLocation));
+					const bool bDuplicate = cell.ContainsByPredicate([&entry](const FParkourLedgeEntry& other)
+					{
+						return other.NormalYaw == entry.NormalYaw && FVector::DistSquared(other.WallLocation, entry.WallLocation) < FMath::Square(LedgeMergeDistance);
+					});
+					if (!bDuplicate)
+						cell.Add(entry);
+				}
+			}
+		}
+	}
+
+	//Flatten the cells into sorted keys and one contiguous entry array
+	cells.KeySort(TLess<uint64>());
+	CellKeys.Reserve(cells.Num());
+	CellStarts.Reserve(cells.Num() + 1);
+	for (const TPair<uint64, TArray<FParkourLedgeEntry>>& cell : cells)
+	{
+		CellKeys.Add(cell.Key);
+		CellStarts.Add(Entries.Num());
+		Entries.Append(cell.Value);
+	}
+	CellStarts.Add(Entries.Num());
+}
+
+/// <summary>
+/// Finds the closest baked wall face that the forward probe would hit, checking the
+/// cells around the probe. The wall location is where the probe meets the face and the
+/// climb and thickness decisions are worked out from there, the same as the traces do
+/// </summary>
+bool UParkourLedgeIndex::FindLedge(const FVector& ProbeStart, const FVector& Forward, FParkourLedge& OutLedge) const
+{
+	if (Entries.Num() == 0)
+		return false;
+
+	const FVector probeEnd = ProbeStart + Forward * FParkourLedgeProbe::ForwardDistance;
+	const FVector searchMin = ProbeStart.ComponentMin(probeEnd) - FVector(LedgeMatchTolerance);
+	const FVector searchMax = ProbeStart.ComponentMax(probeEnd) + FVector(LedgeMatchTolerance);
+
+	const FParkourLedgeEntry* bestEntry = nullptr;
+	float bestDistance = FParkourLedgeProbe::ForwardDistance;
+	FVector bestNormal;
+
+	for (int32 x = FMath::FloorToInt(searchMin.X / CellSize); x <= FMath::FloorToInt(searchMax.X / CellSize); ++x)
+	{
+		for (int32 y = FMath::FloorToInt(searchMin.Y / CellSize); y <= FMath::FloorToInt(searchMax.Y / CellSize); ++y)
+		{
+			for (int32 z = FMath::FloorToInt(searchMin.Z / CellSize); z <= FMath::FloorToInt(searchMax.Z / CellSize); ++z)
+			{
+				const int32 cellIndex = Algo::BinarySearch(CellKeys, GetCellKey(x, y, z));
+				if (cellIndex == INDEX_NONE)
+					continue;
+
+				for (int32 i = CellStarts[cellIndex]; i < CellStarts[cellIndex + 1]; ++i)
+				{
+					const FParkourLedgeEntry& entry = Entries[i];
+					const FVector normal = FRotator(0.0f, FRotator::DecompressAxisFromShort(entry.NormalYaw), 0.0f).Vector();
+
+					//The probe has to be heading into the face
+					const float approach = FVector::DotProduct(Forward, normal);
+					if (approach > -0.1f)
+						continue;
+
+					//Distance along the probe to the plane of the face
+					const float distance = FVector::DotProduct(entry.WallLocation - ProbeStart, normal) / approach;
+					if (distance < 0.0f || distance > bestDistance)
+						continue;
+
+					//The probe has to meet the face near where it was baked
+					if (FVector::DistSquared(ProbeStart + Forward * distance, entry.WallLocation) > FMath::Square(LedgeMatchTolerance))
+						continue;
+
+					bestEntry = &entry;
+					bestDistance = distance;
+					bestNormal = normal;
+				}
+			}
+		}
+	}
+
+	if (!bestEntry)
+		return false;
+
+	OutLedge.WallLocation = ProbeStart + Forward * bestDistance;
+	OutLedge.WallNormal = bestNormal;
+	OutLedge.WallHeight = OutLedge.WallLocation - bestNormal * FParkourLedgeProbe::HeightProbeDepth;
+	OutLedge.WallHeight.Z = bestEntry->WallTopZ;
+	OutLedge.Thickness = bestEntry->Thickness;
+	OutLedge.OtherWallHeight = OutLedge.WallLocation - bestNormal * bestEntry->Thickness;
+	OutLedge.OtherWallHeight.Z = bestEntry->WallTopZ;
+	OutLedge.WallComponent = nullptr;
+	FParkourLedgeProbe::Classify(OutLedge);
+	return true;
+}
+
+/// <summary>
+/// Saves and loads the index as three bulk blobs
+/// </summary>
+void UParkourLedgeIndex::Serialize(FArchive& Ar)
+{
+	Super::Serialize(Ar);
+
+	Ar << Bounds;
+	Ar << CellSize;
+	CellKeys.BulkSerialize(Ar);
+	CellStarts.BulkSerialize(Ar);
+	Entries.BulkSerialize(Ar);
+}
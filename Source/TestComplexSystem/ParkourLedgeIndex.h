@@ -0,0 +1,91 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "ParkourTypes.h"
+#include "ParkourLedgeIndex.generated.h"
+
+//A baked wall face the climb probe can hit. Kept free of padding so the whole index
+//can be bulk serialized
+struct FParkourLedgeEntry
+{
+	//Where the forward probe hit the wall face
+	FVector WallLocation;
+	//The top of the wall just past the face
+	float WallTopZ;
+	//How far the top of the wall goes in from the face before the far edge
+	float Thickness;
+	//The yaw of the wall normal, quantized to 16 bits
+	uint16 NormalYaw;
+	//Keeps the entry at 24 bytes with no compiler padding, always zero
+	uint16 Reserved;
+
+	friend FArchive& operator<<(FArchive& Ar, FParkourLedgeEntry& Entry)
+	{
+		Ar << Entry.WallLocation;
+		Ar << Entry.WallTopZ;
+		Ar << Entry.Thickness;
+		Ar << Entry.NormalYaw;
+		Ar << Entry.Reserved;
+		return Ar;
+	}
+};
+static_assert(sizeof(FParkourLedgeEntry) == 24, "FParkourLedgeEntry is bulk serialized and must not have padding");
+
+/**
+ * A uniform grid of the climbable and vaultable wall faces in part of a level, baked
+ * offline with the same probes the character uses. Cells are stored as a sorted key
+ * array with offsets into one entry array so the index loads as three bulk blobs.
+ */
+UCLASS()
+class UParkourLedgeIndex : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	UParkourLedgeIndex();
+
+	/**
+	 * Bakes the index by standing a character on every floor in the bounds and running
+	 * the climb probes in eight directions. Only faces of static components are kept.
+	 * @param World			the world to bake from
+	 * @param InBounds		the part of the world to bake
+	 * @param SampleSpacing	the distance between sample points
+	 * @param IgnoreActor	an actor the probes should ignore, usually the volume doing the bake
+	 */
+	void Build(UWorld* World, const FBox& InBounds, float SampleSpacing, const AActor* IgnoreActor);
+
+	/**
+	 * Looks up the baked wall a forward probe would hit.
+	 * @param ProbeStart	the start of the forward probe
+	 * @param Forward		the direction the character is facing
+	 * @param OutLedge		the wall that was found
+	 * @return true if a baked wall was found
+	 */
+	bool FindLedge(const FVector& ProbeStart, const FVector& Forward, FParkourLedge& OutLedge) const;
+
+	/** Returns true if the point is inside the baked bounds */
+	bool Covers(const FVector& Location) const { return Entries.Num() > 0 && Bounds.IsInsideOrOn(Location); }
+
+	/** Returns the number of baked wall faces */
+	int32 GetNumLedges() const { return Entries.Num(); }
+
+	// UObject interface
+	virtual void Serialize(FArchive& Ar) override;
+	// End of UObject interface
+
+private:
+	/** Packs the grid coordinates of a location into a cell key */
+	uint64 GetCellKey(const FVector& Location) const;
+	uint64 GetCellKey(int32 X, int32 Y, int32 Z) const;
+
+	FBox Bounds;
+	float CellSize;
+
+	//Sorted cell keys, and the offset of the first entry of each cell with one extra offset at the end
+	TArray<uint64> CellKeys;
+	TArray<int32> CellStarts;
+	TArray<FParkourLedgeEntry> Entries;
+};
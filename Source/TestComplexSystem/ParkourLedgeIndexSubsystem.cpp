@@ -0,0 +1,160 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ParkourLedgeIndexSubsystem.h"
+#include "ParkourLedgeIndex.h"
+#include "ParkourLedgeProbe.h"
+#include "ParkourStats.h"
+#include "TestComplexSystem.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<int32> CVarParkourClimbCache(
+	TEXT("parkour.ClimbCache"),
+	1,
+	TEXT("When on, what the top probe finds on a wall is remembered, so running at the same wall again only needs the forward trace.\n")
+	TEXT("0: always run both probes, 1: use the climb cache (default)"),
+	ECVF_Default);
+
+/// <summary>
+/// Logs how well the climb cache of the world is doing, or empties it
+/// </summary>
+/// <param name="Args">"Clear" to empty the cache</param>
+/// <param name="World">the world of the cache</param>
+static void ClimbCacheCommand(const TArray<FString>& Args, UWorld* World)
+{
+	UParkourLedgeIndexSubsystem* ledgeIndex = World ? World->GetSubsystem<UParkourLedgeIndexSubsystem>() : nullptr;
+	if (!ledgeIndex)
+		return;
+
+	FParkourLedgeCache& cache = ledgeIndex->GetClimbCache();
+	if (Args.Num() > 0 && Args[0] == TEXT("Clear"))
+	{
+		cache.Empty();
+		return;
+	}
+
+	const uint64 lookups = cache.GetHits() + cache.GetMisses();
+	UE_LOG(LogParkour, Display, TEXT("parkour.ClimbCache %d entries, %llu hits, %llu misses, %.1f%% hit rate, %llu evicted"),
+		cache.Num(), cache.GetHits(), cache.GetMisses(), lookups > 0 ? 100.0 * cache.GetHits() / lookups : 0.0, cache.GetEvictions());
+}
+
+static FAutoConsoleCommandWithWorldAndArgs ParkourClimbCacheCommand(
+	TEXT("parkour.ClimbCacheStats"),
+	TEXT("Logs the climb cache hit rate. Usage: parkour.ClimbCacheStats [Clear]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&ClimbCacheCommand));
+
+void UParkourLedgeIndexSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	LevelRemovedHandle = FWorldDelegates::LevelRemovedFromWorld.AddUObject(this, &UParkourLedgeIndexSubsystem::OnLevelRemovedFromWorld);
+}
+
+void UParkourLedgeIndexSubsystem::Deinitialize()
+{
+	FWorldDelegates::LevelRemovedFromWorld.Remove(LevelRemovedHandle);
+	ClimbCache.Empty();
+
+	Super::Deinitialize();
+}
+
+/// <summary>
+/// A null level means every level of the world is going, so the whole cache goes with them
+/// </summary>
+void UParkourLedgeIndexSubsystem::OnLevelRemovedFromWorld(ULevel* Level, UWorld* World)
+{
+	if (World != GetWorld())
+		return;
+
+	if (Level)
+		ClimbCache.RemoveLevel(Level);
+	else
+		ClimbCache.Empty();
+}
+
+void UParkourLedgeIndexSubsystem::RegisterIndex(UParkourLedgeIndex* Index)
+{
+	if (Index)
+		Indices.AddUnique(Index);
+}
+
+void UParkourLedgeIndexSubsystem::UnregisterIndex(UParkourLedgeIndex* Index)
+{
+	Indices.Remove(Index);
+}
+
+/// <summary>
+/// Looks for the wall in every index that covers the probe start
+/// </summary>
+bool UParkourLedgeIndexSubsystem::FindLedge(const FVector& ProbeStart, const FVector& Forward, FParkourLedge& OutLedge, bool& bOutCovered) const
+{
+	bOutCovered = false;
+	for (const UParkourLedgeIndex* index : Indices)
+	{
+		if (!index->Covers(ProbeStart))
+			continue;
+
+		bOutCovered = true;
+		if (index->FindLedge(ProbeStart, Forward, OutLedge))
+			return true;
+	}
+	return false;
+}
+
+/// <summary>
+/// Static walls in a baked area are all in the index, so the top probe only runs if the
+/// wall in front isn't static or the probe isn't in a baked area at all
+/// </summary>
+bool UParkourLedgeIndexSubsystem::FindOrTraceLedge(const FVector& ProbeStart, const FVector& Forward, const FCollisionQueryParams& Params, FParkourLedge& OutLedge, bool* bOutTraced) const
+{
+	if (bOutTraced)
+		*bOutTraced = false;
+
+	bool isBaked = false;
+	if (FindLedge(ProbeStart, Forward, OutLedge, isBaked))
+		return true;
+
+	if (bOutTraced)
+		*bOutTraced = true;
+
+	FHitResult wallHit;
+	if (!FParkourLedgeProbe::TraceWall(GetWorld(), ProbeStart, Forward, Params, wallHit))
+		return false;
+
+	return TraceLedgeTop(wallHit, isBaked, Params, OutLedge);
+}
+
+bool UParkourLedgeIndexSubsystem::FindOrTraceLedge(const FVector& ProbeStart, const FVector& Forward, const FHitResult& WallHit, const FCollisionQueryParams& Params, FParkourLedge& OutLedge) const
+{
+	bool isBaked = false;
+	if (FindLedge(ProbeStart, Forward, OutLedge, isBaked))
+		return true;
+
+	return TraceLedgeTop(WallHit, isBaked, Params, OutLedge);
+}
+
+/// <summary>
+/// The bake only keeps static walls, so in a baked area anything that isn't static, whatever
+/// its collision channel, still needs its top probed. The top probe only runs the first time
+/// a wall is hit near the same spot, walls without a top are remembered too
+/// </summary>
+bool UParkourLedgeIndexSubsystem::TraceLedgeTop(const FHitResult& WallHit, bool bBaked, const FCollisionQueryParams& Params, FParkourLedge& OutLedge) const
+{
+	const UPrimitiveComponent* wall = WallHit.GetComponent();
+	if (bBaked && (!wall || wall->Mobility == EComponentMobility::Static))
+		return false;
+
+	const UWorld* world = GetWorld();
+	if (CVarParkourClimbCache.GetValueOnAnyThread() == 0)
+		return FParkourLedgeProbe::TraceTop(world, WallHit, Params, OutLedge);
+
+	bool hasLedge = false;
+	if (ClimbCache.Find(WallHit, OutLedge, hasLedge))
+		return hasLedge;
+
+	hasLedge = FParkourLedgeProbe::TraceTop(world, WallHit, Params, OutLedge);
+	ClimbCache.Add(WallHit, hasLedge ? &OutLedge : nullptr);
+	return hasLedge;
+}
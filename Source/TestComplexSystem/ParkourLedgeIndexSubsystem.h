@@ -0,0 +1,82 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "CollisionQueryParams.h"
+#include "ParkourTypes.h"
+#include "ParkourLedgeCache.h"
+#include "ParkourLedgeIndexSubsystem.generated.h"
+
+class UParkourLedgeIndex;
+
+/**
+ * Keeps track of the baked ledge indices of the loaded levels so characters can look up
+ * walls instead of tracing for them. Walls that have to be traced for are remembered in a
+ * climb cache, so running at the same wall again only needs the forward trace.
+ */
+UCLASS()
+class UParkourLedgeIndexSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// USubsystem interface
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	// End of USubsystem interface
+
+	/** Adds the index of a loaded level */
+	void RegisterIndex(UParkourLedgeIndex* Index);
+
+	/** Removes the index of a level being unloaded */
+	void UnregisterIndex(UParkourLedgeIndex* Index);
+
+	/**
+	 * Looks up the baked wall a forward probe would hit.
+	 * @param ProbeStart	the start of the forward probe
+	 * @param Forward		the direction the character is facing
+	 * @param OutLedge		the wall that was found
+	 * @param bOutCovered	set to true if the probe start is inside a baked index
+	 * @return true if a baked wall was found
+	 */
+	bool FindLedge(const FVector& ProbeStart, const FVector& Forward, FParkourLedge& OutLedge, bool& bOutCovered) const;
+
+	/**
+	 * Looks up the wall in front of a probe start in the baked indices, and traces for it
+	 * where nothing is baked or the wall in the way isn't static. Safe to call off the game thread.
+	 * @param ProbeStart	the start of the forward probe
+	 * @param Forward		the direction the character is facing
+	 * @param Params		the query params, ignoring the character
+	 * @param OutLedge		the wall that was found
+	 * @param bOutTraced	if given, set to false when the baked index answered without tracing
+	 * @return true if there is a wall in front with a top to climb or vault onto
+	 */
+	bool FindOrTraceLedge(const FVector& ProbeStart, const FVector& Forward, const FCollisionQueryParams& Params, FParkourLedge& OutLedge, bool* bOutTraced = nullptr) const;
+
+	/**
+	 * Same as FindOrTraceLedge, for callers that have already run the forward probe and only
+	 * need the top probe run on the wall it hit.
+	 * @param WallHit	what the forward probe hit
+	 */
+	bool FindOrTraceLedge(const FVector& ProbeStart, const FVector& Forward, const FHitResult& WallHit, const FCollisionQueryParams& Params, FParkourLedge& OutLedge) const;
+
+	/** The walls that have been traced for */
+	FParkourLedgeCache& GetClimbCache() const { return ClimbCache; }
+
+private:
+	/** Runs the top probe on a wall the forward probe hit, unless it is baked or in the climb cache */
+	bool TraceLedgeTop(const FHitResult& WallHit, bool bBaked, const FCollisionQueryParams& Params, FParkourLedge& OutLedge) const;
+
+	/** Drops the climb cache entries of a level being unloaded */
+	void OnLevelRemovedFromWorld(ULevel* Level, UWorld* World);
+
+	UPROPERTY()
+	TArray<UParkourLedgeIndex*> Indices;
+
+	//Filled in by lookups, which are const and can come from any thread
+	mutable FParkourLedgeCache ClimbCache;
+
+	FDelegateHandle LevelRemovedHandle;
+};
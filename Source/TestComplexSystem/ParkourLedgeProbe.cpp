@@ -0,0 +1,109 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ParkourLedgeProbe.h"
+#include "ParkourStats.h"
+#include "ParkourPhysicalMaterial.h"
+#include "Engine/World.h"
+
+/// <summary>
+/// Line traces forward to find a wall, then sweeps down onto the top of it
+/// </summary>
+bool FParkourLedgeProbe::Trace(const UWorld* World, const FVector& ProbeStart, const FVector& Forward, const FCollisionQueryParams& Params, FParkourLedge& OutLedge)
+{
+	FHitResult wallHit;
+	if (!TraceWall(World, ProbeStart, Forward, Params, wallHit))
+		return false;
+
+	return TraceTop(World, wallHit, Params, OutLedge);
+}
+
+/// <summary>
+/// Line traces to the object to climb
+/// </summary>
+bool FParkourLedgeProbe::TraceWall(const UWorld* World, const FVector& ProbeStart, const FVector& Forward, const FCollisionQueryParams& Params, FHitResult& OutWallHit)
+{
+	PARKOUR_COUNT_TRACES(1);
+	const FVector endLocation = ProbeStart + Forward * ForwardDistance;
+	return World->LineTraceSingleByChannel(OutWallHit, ProbeStart, endLocation, ECC_Parkour, Params);
+}
+
+/// <summary>
+/// Sweeps a sphere centred ThicknessProbeDepth past the wall face down onto the wall. On
+/// a wall that carries on past the centre the sphere lands flat on the top, right under
+/// its centre. On a thinner wall it catches on the far edge first, so the contact is
+/// nearer the face and how much nearer is the thickness. A wall with no far edge in reach
+/// never looks thin, whatever is or isn't on the ground behind it
+/// </summary>
+bool FParkourLedgeProbe::TraceTop(const UWorld* World, const FHitResult& WallHit, const FCollisionQueryParams& Params, FParkourLedge& OutLedge)
+{
+	OutLedge.WallLocation = WallHit.Location;
+	OutLedge.WallNormal = WallHit.Normal;
+	OutLedge.WallComponent = WallHit.GetComponent();
+	OutLedge.Action = EParkourLedgeAction::None;
+
+	//Walls that can't be climbed or vaulted don't need the top probe
+	const EParkourSurface surface = UParkourPhysicalMaterial::GetSurface(WallHit);
+	if (!EnumHasAnyFlags(surface, EParkourSurface::Climb | EParkourSurface::Vault))
+		return false;
+
+	//Sweeps from high enough that the bottom of the sphere starts HeightProbeHeight above
+	//the wall location, down until it is level with the wall location
+	FVector startLocation = OutLedge.WallLocation - OutLedge.WallNormal * ThicknessProbeDepth;
+	startLocation.Z += HeightProbeHeight + TopProbeRadius;
+	FVector endLocation = startLocation;
+	endLocation.Z -= HeightProbeHeight;
+
+	FHitResult topHit;
+	PARKOUR_COUNT_TRACES(1);
+	if (!World->SweepSingleByChannel(topHit, startLocation, endLocation, FQuat::Identity, ECC_Parkour, FCollisionShape::MakeSphere(TopProbeRadius), Params))
+		return false;
+
+	//Something over the top of the wall leaves no room to get onto it
+	if (topHit.bStartPenetrating)
+		return false;
+
+	//How far in from the face the sphere touched, measured flat so sloped faces don't skew it
+	const FVector wallNormal2D = OutLedge.WallNormal.GetSafeNormal2D();
+	const float contactDepth = FVector::DotProduct(FVector(OutLedge.WallLocation - topHit.ImpactPoint) * FVector(1.0f, 1.0f, 0.0f), wallNormal2D);
+	OutLedge.Thickness = FMath::Clamp(contactDepth, 0.0f, ThicknessProbeDepth);
+	if (OutLedge.Thickness > ThicknessProbeDepth - FarEdgeTolerance)
+		OutLedge.Thickness = ThicknessProbeDepth;
+
+	OutLedge.WallHeight = OutLedge.WallLocation - OutLedge.WallNormal * HeightProbeDepth;
+	OutLedge.WallHeight.Z = topHit.ImpactPoint.Z;
+	OutLedge.OtherWallHeight = OutLedge.WallLocation - OutLedge.WallNormal * OutLedge.Thickness;
+	OutLedge.OtherWallHeight.Z = topHit.ImpactPoint.Z;
+
+	Classify(OutLedge);
+	return EnumHasAnyFlags(surface, OutLedge.Action == EParkourLedgeAction::Vault ? EParkourSurface::Vault : EParkourSurface::Climb);
+}
+
+/// <summary>
+/// Walls with their far edge in reach are vaulted over, walls without are climbed onto
+/// </summary>
+void FParkourLedgeProbe::Classify(FParkourLedge& Ledge)
+{
+	Ledge.Height = Ledge.WallHeight.Z - Ledge.WallLocation.Z;
+	Ledge.bHasFarEdge = Ledge.Thickness < ThicknessProbeDepth;
+	Ledge.Action = Ledge.bHasFarEdge ? EParkourLedgeAction::Vault : EParkourLedgeAction::Climb;
+}
+
+/// <summary>
+/// Rises until the bottom of the capsule is clear of the top of the wall, then moves in
+/// from the face. Climbs end standing on the top just past the face, vaults end with the
+/// capsule clear of the far side, ready to drop down
+/// </summary>
+FParkourVaultPath FParkourLedgeProbe::GetVaultPath(const FVector& ActorLocation, float CapsuleRadius, float CapsuleHalfHeight, const FVector& WallLocation, const FVector& WallNormal, float WallTopZ, float Thickness, bool bIsWallThick)
+{
+	const FVector intoWall = -WallNormal.GetSafeNormal2D();
+	const float faceDistance = FMath::Max(0.0f, FVector::DotProduct(WallLocation - ActorLocation, intoWall));
+	const float travel = faceDistance + CapsuleRadius + (bIsWallThick ? HeightProbeDepth : Thickness + VaultClearance);
+
+	FParkourVaultPath path;
+	path.Start = ActorLocation;
+	path.Apex = ActorLocation;
+	path.Apex.Z = FMath::Max(ActorLocation.Z, WallTopZ + CapsuleHalfHeight + VaultClearance);
+	path.End = path.Apex + intoWall * travel;
+	return path;
+}
@@ -0,0 +1,91 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CollisionQueryParams.h"
+#include "ParkourTypes.h"
+
+/**
+ * The probes used to check the wall in front of a character for climbing or vaulting.
+ * Shared by the character at runtime and by the ledge index bake so both agree on what
+ * counts as a climbable or vaultable wall.
+ *
+ * A line trace forward finds the wall face, then one sphere sweep down onto the top of the
+ * wall finds both its height and its far edge. The sphere sits on the top of a wall that
+ * carries on past it, and catches on the far edge of a wall that doesn't, so where it
+ * touches gives the thickness without a second trace.
+ */
+struct FParkourLedgeProbe
+{
+	//How far below the actor location the forward probe starts
+	static constexpr float ProbeHeightOffset = 44.0f;
+	//How far in front of the character the forward probe reaches
+	static constexpr float ForwardDistance = 70.0f;
+	//How far above the wall location the top probe starts and how far it goes down
+	static constexpr float HeightProbeHeight = 200.0f;
+	//How far past the wall face the top of the wall is measured
+	static constexpr float HeightProbeDepth = 10.0f;
+	//How far past the wall face the top probe is centred, walls that go in further than this are too thick to vault
+	static constexpr float ThicknessProbeDepth = 50.0f;
+	//The radius of the top probe, so it reaches from HeightProbeDepth to past ThicknessProbeDepth
+	static constexpr float TopProbeRadius = ThicknessProbeDepth - HeightProbeDepth;
+	//How much closer to the face than the centre of the top probe a contact has to be to count as the far edge
+	static constexpr float FarEdgeTolerance = 2.0f;
+	//How far the capsule stays clear of the top and the far side of the wall while vaulting
+	static constexpr float VaultClearance = 5.0f;
+	//Walls higher than this above the wall location are too high to vault
+	static constexpr float ClimbHeight = 60.0f;
+	//The most scene queries Trace makes
+	static constexpr int32 MaxTraces = 2;
+
+	/**
+	 * Runs the forward probe and the top probe from a probe start location.
+	 * @param World			the world to trace in
+	 * @param ProbeStart	the start of the forward probe, the actor location lowered by ProbeHeightOffset
+	 * @param Forward		the direction the character is facing
+	 * @param Params		the query params, ignoring the character
+	 * @param OutLedge		the wall that was found
+	 * @return true if there is a wall in front with a top to climb or vault onto
+	 */
+	static bool Trace(const UWorld* World, const FVector& ProbeStart, const FVector& Forward, const FCollisionQueryParams& Params, FParkourLedge& OutLedge);
+
+	/**
+	 * Runs the forward probe on its own.
+	 * @param World			the world to trace in
+	 * @param ProbeStart	the start of the forward probe, the actor location lowered by ProbeHeightOffset
+	 * @param Forward		the direction the character is facing
+	 * @param Params		the query params, ignoring the character
+	 * @param OutWallHit	the hit on the wall face
+	 * @return true if there is a wall in front
+	 */
+	static bool TraceWall(const UWorld* World, const FVector& ProbeStart, const FVector& Forward, const FCollisionQueryParams& Params, FHitResult& OutWallHit);
+
+	/**
+	 * Runs the top probe on a wall a forward probe has already hit.
+	 * @param World			the world to trace in
+	 * @param WallHit		the hit of the forward probe on the wall face
+	 * @param Params		the query params, ignoring the character
+	 * @param OutLedge		the wall that was found
+	 * @return true if the wall has a top to climb or vault onto
+	 */
+	static bool TraceTop(const UWorld* World, const FHitResult& WallHit, const FCollisionQueryParams& Params, FParkourLedge& OutLedge);
+
+	/** Works out the height, whether the far edge was found and the action from the wall location, wall height and thickness */
+	static void Classify(FParkourLedge& Ledge);
+
+	/**
+	 * Works out the path a character's capsule takes over or onto a wall from where it is, so
+	 * it can be moved with collision left on.
+	 * @param ActorLocation		where the character is
+	 * @param CapsuleRadius		the radius of the character's capsule
+	 * @param CapsuleHalfHeight	the half height of the character's capsule
+	 * @param WallLocation		where the forward probe hit the wall
+	 * @param WallNormal		the way the wall is facing
+	 * @param WallTopZ			the height of the top of the wall
+	 * @param Thickness			how far the top of the wall goes in before the far edge
+	 * @param bIsWallThick		whether the wall is climbed onto instead of vaulted over
+	 * @return the path to move the character along
+	 */
+	static FParkourVaultPath GetVaultPath(const FVector& ActorLocation, float CapsuleRadius, float CapsuleHalfHeight, const FVector& WallLocation, const FVector& WallNormal, float WallTopZ, float Thickness, bool bIsWallThick);
+};
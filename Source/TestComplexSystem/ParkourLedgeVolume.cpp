@@ -0,0 +1,58 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ParkourLedgeVolume.h"
+#include "ParkourLedgeIndex.h"
+#include "ParkourLedgeIndexSubsystem.h"
+#include "TestComplexSystem.h"
+#include "Components/BrushComponent.h"
+#include "Engine/CollisionProfile.h"
+
+AParkourLedgeVolume::AParkourLedgeVolume(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+	//The volume only marks an area, it shouldn't block the probes
+	GetBrushComponent()->SetCollisionProfileName(UCollisionProfile::NoCollision_ProfileName);
+
+	SampleSpacing = 50.0f;
+	LedgeIndex = nullptr;
+}
+
+#if WITH_EDITOR
+/// <summary>
+/// Bakes the climbable and vaultable walls inside the volume
+/// </summary>
+void AParkourLedgeVolume::BakeLedges()
+{
+	Modify();
+	if (!LedgeIndex)
+		LedgeIndex = NewObject<UParkourLedgeIndex>(this, TEXT("LedgeIndex"));
+
+	LedgeIndex->Modify();
+	LedgeIndex->Build(GetWorld(), GetComponentsBoundingBox(true), SampleSpacing, this);
+
+	UE_LOG(LogParkour, Log, TEXT("%s baked %d ledges"), *GetName(), LedgeIndex->GetNumLedges());
+}
+#endif
+
+/// <summary>
+/// Hands the baked index to the ledge index subsystem
+/// </summary>
+void AParkourLedgeVolume::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (UParkourLedgeIndexSubsystem* subsystem = GetWorld()->GetSubsystem<UParkourLedgeIndexSubsystem>())
+		subsystem->RegisterIndex(LedgeIndex);
+}
+
+/// <summary>
+/// Takes the baked index back out of the ledge index subsystem
+/// </summary>
+void AParkourLedgeVolume::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UParkourLedgeIndexSubsystem* subsystem = GetWorld()->GetSubsystem<UParkourLedgeIndexSubsystem>())
+		subsystem->UnregisterIndex(LedgeIndex);
+
+	Super::EndPlay(EndPlayReason);
+}
@@ -0,0 +1,41 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Volume.h"
+#include "ParkourLedgeVolume.generated.h"
+
+class UParkourLedgeIndex;
+
+/**
+ * Marks the part of a level to bake climbable and vaultable walls for. The baked index is
+ * saved with the level and handed to the ledge index subsystem when play begins.
+ */
+UCLASS()
+class AParkourLedgeVolume : public AVolume
+{
+	GENERATED_BODY()
+
+public:
+	AParkourLedgeVolume(const FObjectInitializer& ObjectInitializer);
+
+	/** The distance between the points the bake probes from */
+	UPROPERTY(EditAnywhere, Category = Parkour, meta = (ClampMin = "10.0"))
+	float SampleSpacing;
+
+#if WITH_EDITOR
+	/** Bakes the walls inside the volume into the ledge index */
+	UFUNCTION(CallInEditor, Category = Parkour)
+	void BakeLedges();
+#endif
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	/** The baked index, saved with the level */
+	UPROPERTY()
+	UParkourLedgeIndex* LedgeIndex;
+};
@@ -0,0 +1,751 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ParkourMovementComponent.h"
+#include "TestComplexSystemCharacter.h"
+#include "ParkourStats.h"
+#include "ParkourPhysicalMaterial.h"
+#include "Components/CapsuleComponent.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "GameFramework/Character.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Client Corrections"), STAT_ParkourClientCorrections, STATGROUP_Parkour);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Server Corrections"), STAT_ParkourServerCorrections, STATGROUP_Parkour);
+
+//Client moves corrected by the server, read by the load test report
+static uint32 ServerCorrectionCount = 0;
+
+//The parkour requests packed into the custom compressed flags of a saved move
+static const uint8 FLAG_WantsToWallRun = FSavedMove_Character::FLAG_Custom_0;
+static const uint8 FLAG_WantsToWallJump = FSavedMove_Character::FLAG_Custom_1;
+static const uint8 FLAG_WantsToSlide = FSavedMove_Character::FLAG_Custom_2;
+static const uint8 FLAG_WantsToVault = FSavedMove_Character::FLAG_Custom_3;
+
+UParkourMovementComponent::UParkourMovementComponent()
+{
+	WallRunSpeed = 500.0f;
+	WallRunMinSpeed = 100.0f;
+	WallRunFalloffGravityScale = 50.0f;
+	WallRunProbeDistance = 50.0f;
+	WallJumpSideVelocity = 450.0f;
+	WallJumpUpVelocity = 450.0f;
+	SlideHalfHeight = 48.0f;
+	SlideMeshOffset = 50.0f;
+	VaultDuration = 1.0f;
+	ParkourFixedTimeStep = 1.0f / 60.0f;
+	MaxParkourFixedSteps = 10;
+
+	bWantsToWallRun = false;
+	bWantsToWallJump = false;
+	bWantsToSlide = false;
+	bWantsToVault = false;
+
+	bIsWallRunFalloff = false;
+	bHasWallRunWall = false;
+	bWallRunRightSide = false;
+
+	WallRunNormal = FVector::ZeroVector;
+	WallRunDirection = FVector::ZeroVector;
+	VaultTimeRemaining = 0.0f;
+	FixedStepAccumulator = 0.0f;
+	FixedStepPreviousLocation = FVector::ZeroVector;
+}
+
+/// <summary>
+/// Requests a wall run along the wall the character found
+/// </summary>
+/// <param name="WallNormal">the normal of the wall</param>
+/// <param name="bRightSide">whether the wall is on the right of the character</param>
+void UParkourMovementComponent::StartWallRun(const FVector& WallNormal, bool bRightSide)
+{
+	bWantsToWallRun = true;
+	bHasWallRunWall = true;
+	bWallRunRightSide = bRightSide;
+	WallRunNormal = WallNormal;
+}
+
+/// <summary>
+/// Stops requesting a wall run, it ends at the start of the next move
+/// </summary>
+void UParkourMovementComponent::StopWallRun()
+{
+	bWantsToWallRun = false;
+	bHasWallRunWall = false;
+}
+
+/// <summary>
+/// Requests a jump off the wall on the next move
+/// </summary>
+void UParkourMovementComponent::WallJump()
+{
+	bWantsToWallJump = true;
+}
+
+/// <summary>
+/// Requests starting or stopping a slide on the next move
+/// </summary>
+void UParkourMovementComponent::SetWantsToSlide(bool bInWantsToSlide)
+{
+	bWantsToSlide = bInWantsToSlide;
+}
+
+/// <summary>
+/// Requests a vault or climb on the next move
+/// </summary>
+void UParkourMovementComponent::RequestVault()
+{
+	bWantsToVault = true;
+}
+
+/// <summary>
+/// Starts the vault mode along the path the character works out from its last climb
+/// check. Collision stays on the whole time, so the capsule keeps its physics state and
+/// its overlaps, and the move starts from where the character is instead of teleporting.
+/// Only the wall being vaulted is ignored by the capsule's moves
+/// </summary>
+void UParkourMovementComponent::StartVault()
+{
+	ATestComplexSystemCharacter* parkourOwner = Cast<ATestComplexSystemCharacter>(CharacterOwner);
+	if (IsVaulting() || !parkourOwner)
+		return;
+
+	VaultPath = parkourOwner->OnVaultStarted();
+	SetVaultObstacle(parkourOwner->GetVaultObstacle());
+
+	VaultTimeRemaining = VaultDuration;
+	SetMovementMode(MOVE_Custom, (uint8)EParkourMovementMode::Vault);
+}
+
+/// <summary>
+/// Goes back to walking once a vault or climb is over
+/// </summary>
+void UParkourMovementComponent::StopVault()
+{
+	if (!IsVaulting())
+		return;
+
+	VaultTimeRemaining = 0.0f;
+
+	//Set the movement back to normal, leaving the vault mode stops ignoring the wall
+	SetMovementMode(MOVE_Walking);
+}
+
+void UParkourMovementComponent::SetVaultObstacle(UPrimitiveComponent* Obstacle)
+{
+	if (UPrimitiveComponent* oldObstacle = VaultObstacle.Get())
+		UpdatedPrimitive->IgnoreComponentWhenMoving(oldObstacle, false);
+
+	VaultObstacle = Obstacle;
+	if (Obstacle)
+		UpdatedPrimitive->IgnoreComponentWhenMoving(Obstacle, true);
+}
+
+/// <summary>
+/// Counts the characters that are wall running this frame for the profilers
+/// </summary>
+void UParkourMovementComponent::TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	if (IsWallRunning())
+		PARKOUR_COUNT(WallRunners, 1);
+}
+
+bool UParkourMovementComponent::IsMovingOnGround() const
+{
+	//Sliding is walking with a smaller capsule
+	return Super::IsMovingOnGround() || IsSliding();
+}
+
+float UParkourMovementComponent::GetMaxSpeed() const
+{
+	if (MovementMode == MOVE_Custom)
+	{
+		switch ((EParkourMovementMode)CustomMovementMode)
+		{
+		case EParkourMovementMode::WallRun:
+			return WallRunSpeed;
+		case EParkourMovementMode::Slide:
+			return MaxWalkSpeed;
+		default:
+			break;
+		}
+	}
+
+	return Super::GetMaxSpeed();
+}
+
+/// <summary>
+/// Keeps the rotation the fixed step modes start with. Turning to face the input would steer
+/// the wall run into or off the wall, and turns a frame at a time instead of a step at a time
+/// </summary>
+void UParkourMovementComponent::PhysicsRotation(float DeltaTime)
+{
+	if (IsFixedStepMode())
+		return;
+
+	Super::PhysicsRotation(DeltaTime);
+}
+
+/// <summary>
+/// Switches between the parkour modes from the requests before the move runs, on the
+/// owning client, on the server and when replaying moves after a correction
+/// </summary>
+void UParkourMovementComponent::UpdateCharacterStateBeforeMovement(float DeltaSeconds)
+{
+	Super::UpdateCharacterStateBeforeMovement(DeltaSeconds);
+
+	UpdateVault();
+	UpdateSlide();
+	UpdateWallRun();
+}
+
+void UParkourMovementComponent::UpdateWallRun()
+{
+	if (IsWallRunning())
+	{
+		//Jump off the wall away from the side it is on
+		if (bWantsToWallJump)
+		{
+			FVector actorRightVector = UpdatedComponent->GetRightVector();
+			FVector launchVelocity = actorRightVector * (bWallRunRightSide ? -WallJumpSideVelocity : WallJumpSideVelocity);
+			launchVelocity.Z = WallJumpUpVelocity;
+
+			//Drop the wall too, or the next move would start running on it again before a probe clears it
+			StopWallRun();
+			EndWallRun(false);
+			Velocity += launchVelocity;
+		}
+		//The wall ended or the character stopped asking to run on it
+		else if (!bWantsToWallRun)
+		{
+			EndWallRun(false);
+		}
+		return;
+	}
+
+	if (!bWantsToWallRun || !IsFalling() || bIsWallRunFalloff)
+		return;
+
+	//The server of a remote player only gets the flag, so it finds the wall itself
+	if (!bHasWallRunWall && !FindWallRunWall())
+		return;
+
+	SetMovementMode(MOVE_Custom, (uint8)EParkourMovementMode::WallRun);
+}
+
+void UParkourMovementComponent::UpdateSlide()
+{
+	if (bWantsToSlide && !IsSliding() && MovementMode == MOVE_Walking)
+		SetMovementMode(MOVE_Custom, (uint8)EParkourMovementMode::Slide);
+	else if (!bWantsToSlide && IsSliding())
+		SetMovementMode(MOVE_Walking);
+}
+
+void UParkourMovementComponent::UpdateVault()
+{
+	ATestComplexSystemCharacter* parkourOwner = Cast<ATestComplexSystemCharacter>(CharacterOwner);
+	if (!bWantsToVault || IsVaulting() || !parkourOwner)
+		return;
+
+	//The owning client has already checked the wall when it asked to vault. The server
+	//of a remote player checks the same wall itself
+	if (CharacterOwner->GetLocalRole() == ROLE_Authority && !CharacterOwner->IsLocallyControlled() && !parkourOwner->CheckForClimbing())
+		return;
+
+	StartVault();
+}
+
+void UParkourMovementComponent::PhysCustom(float deltaTime, int32 Iterations)
+{
+	switch ((EParkourMovementMode)CustomMovementMode)
+	{
+	case EParkourMovementMode::WallRun:
+		PhysWallRun(deltaTime, Iterations);
+		break;
+	case EParkourMovementMode::Slide:
+		PhysSlide(deltaTime, Iterations);
+		break;
+	case EParkourMovementMode::Vault:
+		PhysVault(deltaTime, Iterations);
+		break;
+	default:
+		Super::PhysCustom(deltaTime, Iterations);
+		break;
+	}
+}
+
+/// <summary>
+/// Adds the move to the time not simulated yet and works out how many whole steps fit in it
+/// </summary>
+/// <param name="deltaTime">the time of the move</param>
+/// <returns>the number of fixed steps to run</returns>
+int32 UParkourMovementComponent::ConsumeFixedSteps(float deltaTime)
+{
+	FixedStepAccumulator += deltaTime;
+
+	int32 steps = FMath::FloorToInt(FixedStepAccumulator / ParkourFixedTimeStep);
+	FixedStepAccumulator -= steps * ParkourFixedTimeStep;
+	if (steps > MaxParkourFixedSteps)
+		steps = MaxParkourFixedSteps;
+
+	return steps;
+}
+
+float UParkourMovementComponent::TakeFixedStepRemainder(int32 StepsNotRun)
+{
+	const float remainder = StepsNotRun * ParkourFixedTimeStep + FixedStepAccumulator;
+	FixedStepAccumulator = 0.0f;
+	return remainder;
+}
+
+/// <summary>
+/// Runs straight along the wall with no up or down movement. Hitting something slides
+/// along it, and running out of speed or wall drops the character off it. Runs in fixed
+/// steps, so how soon the character runs out of speed doesn't depend on the frame rate.
+/// The wall is checked every step, since characters that probe rarely or not at all would
+/// otherwise keep running on past its end
+/// </summary>
+void UParkourMovementComponent::PhysWallRun(float deltaTime, int32 Iterations)
+{
+	if (deltaTime < MIN_TICK_TIME)
+		return;
+
+	if (!CharacterOwner || !(CharacterOwner->Controller || bRunPhysicsWithNoController || CharacterOwner->GetLocalRole() == ROLE_SimulatedProxy))
+		return;
+
+	FCollisionQueryParams wallParams(SCENE_QUERY_STAT(ParkourWallRunWallCheck));
+	wallParams.AddIgnoredActor(CharacterOwner);
+	const float wallCheckDistance = CharacterOwner->GetCapsuleComponent()->GetScaledCapsuleRadius() + WallRunProbeDistance;
+
+	const int32 steps = ConsumeFixedSteps(deltaTime);
+	for (int32 step = 0; step < steps; ++step)
+	{
+		Iterations++;
+		bJustTeleported = false;
+		const float timeTick = ParkourFixedTimeStep;
+		FixedStepPreviousLocation = UpdatedComponent->GetComponentLocation();
+
+		//Past the end of the wall the character falls, and stops asking to run until it finds another wall
+		const FVector wallCheckStart = UpdatedComponent->GetComponentLocation();
+		PARKOUR_COUNT_TRACES(1);
+		if (!GetWorld()->LineTraceTestByChannel(wallCheckStart, wallCheckStart - WallRunNormal * wallCheckDistance, ECC_Parkour, wallParams))
+		{
+			StopWallRun();
+			EndWallRun(false);
+			if (ATestComplexSystemCharacter* parkourOwner = Cast<ATestComplexSystemCharacter>(CharacterOwner))
+				parkourOwner->OnWallRunFalloff();
+
+			StartNewPhysics(TakeFixedStepRemainder(steps - step), Iterations);
+			return;
+		}
+
+		//Run along the wall at wall run speed, root motion still wins if there is any
+		const FVector oldLocation = UpdatedComponent->GetComponentLocation();
+		if (!HasAnimRootMotion() && !CurrentRootMotion.HasOverrideVelocity())
+			Velocity = WallRunDirection * WallRunSpeed;
+		ApplyRootMotionToVelocity(timeTick);
+		Velocity.Z = 0.0f;
+
+		const FVector delta = Velocity * timeTick;
+		FHitResult hit(1.0f);
+		SafeMoveUpdatedComponent(delta, UpdatedComponent->GetComponentQuat(), true, hit);
+		if (hit.Time < 1.0f)
+		{
+			HandleImpact(hit, timeTick, delta);
+			SlideAlongSurface(delta, 1.0f - hit.Time, hit.Normal, hit, true);
+		}
+
+		if (!bJustTeleported && !HasAnimRootMotion() && !CurrentRootMotion.HasOverrideVelocity())
+			Velocity = (UpdatedComponent->GetComponentLocation() - oldLocation) / timeTick;
+
+		//If the speed along the wall drops too low, fall off the wall. The rest of the move falls
+		if (FVector::DotProduct(Velocity, WallRunDirection) <= WallRunMinSpeed)
+		{
+			EndWallRun(true);
+			StartNewPhysics(TakeFixedStepRemainder(steps - step - 1), Iterations);
+			return;
+		}
+	}
+}
+
+/// <summary>
+/// Slides along the ground using the walking physics with the slide capsule
+/// </summary>
+void UParkourMovementComponent::PhysSlide(float deltaTime, int32 Iterations)
+{
+	PhysWalking(deltaTime, Iterations);
+}
+
+/// <summary>
+/// Sweeps along the vault path, warping the vault or climb animation onto the wall that
+/// was found. Any root motion in the montage is replaced by the path, so the capsule can't
+/// be carried into the wall. Hitting anything other than the wall slides along it, and the
+/// path is followed from wherever the capsule ends up, so a correction mid vault converges
+/// back onto it. Runs in fixed steps and goes back to walking on the step the vault is over,
+/// so the vault ends at the same point along the path at any frame rate
+/// </summary>
+void UParkourMovementComponent::PhysVault(float deltaTime, int32 Iterations)
+{
+	if (deltaTime < MIN_TICK_TIME)
+		return;
+
+	const int32 steps = ConsumeFixedSteps(deltaTime);
+	for (int32 step = 0; step < steps; ++step)
+	{
+		Iterations++;
+		bJustTeleported = false;
+		FixedStepPreviousLocation = UpdatedComponent->GetComponentLocation();
+
+		//Count down the vault that is playing
+		VaultTimeRemaining -= ParkourFixedTimeStep;
+
+		const float alpha = VaultDuration > 0.0f ? FMath::Clamp(1.0f - VaultTimeRemaining / VaultDuration, 0.0f, 1.0f) : 1.0f;
+		const FVector oldLocation = UpdatedComponent->GetComponentLocation();
+		const FVector delta = VaultPath.GetLocation(alpha) - oldLocation;
+
+		FHitResult hit(1.0f);
+		SafeMoveUpdatedComponent(delta, UpdatedComponent->GetComponentQuat(), true, hit);
+		if (hit.Time < 1.0f)
+			SlideAlongSurface(delta, 1.0f - hit.Time, hit.Normal, hit, true);
+
+		//The velocity the capsule actually had, so a blocked step doesn't leave the vault faster than it moved
+		if (!bJustTeleported)
+			Velocity = (UpdatedComponent->GetComponentLocation() - oldLocation) / ParkourFixedTimeStep;
+
+		if (VaultTimeRemaining <= 0.0f)
+		{
+			if (ATestComplexSystemCharacter* parkourOwner = Cast<ATestComplexSystemCharacter>(CharacterOwner))
+				parkourOwner->StopVaultOrGetUp();
+			else
+				StopVault();
+
+			//The rest of the move walks
+			StartNewPhysics(TakeFixedStepRemainder(steps - step - 1), Iterations);
+			return;
+		}
+	}
+}
+
+/// <summary>
+/// The capsule only moves on whole steps, so between steps the mesh is drawn part of the
+/// way from the step before, by how far the time not simulated yet is into the next step.
+/// Dedicated servers draw nothing, so they leave the mesh alone, and simulated proxies
+/// already have their mesh smoothed by the movement component
+/// </summary>
+void UParkourMovementComponent::UpdateFixedStepPresentation()
+{
+	USkeletalMeshComponent* mesh = CharacterOwner ? CharacterOwner->GetMesh() : nullptr;
+	if (!mesh || IsNetMode(NM_DedicatedServer) || CharacterOwner->GetLocalRole() == ROLE_SimulatedProxy)
+		return;
+
+	FVector offset = FVector::ZeroVector;
+	if (IsFixedStepMode())
+	{
+		const float alpha = FMath::Clamp(FixedStepAccumulator / ParkourFixedTimeStep, 0.0f, 1.0f);
+		const FVector location = UpdatedComponent->GetComponentLocation();
+		offset = UpdatedComponent->GetComponentQuat().UnrotateVector(FMath::Lerp(FixedStepPreviousLocation, location, alpha) - location);
+	}
+
+	mesh->SetRelativeLocation(CharacterOwner->GetBaseTranslationOffset() + offset);
+}
+
+/// <summary>
+/// Leaves the wall run mode and starts falling
+/// </summary>
+/// <param name="bFalloff">whether the character ran out of speed and should drop off the wall</param>
+void UParkourMovementComponent::EndWallRun(bool bFalloff)
+{
+	bIsWallRunFalloff = bFalloff;
+	if (bFalloff)
+		GravityScale = WallRunFalloffGravityScale;
+
+	SetMovementMode(MOVE_Falling);
+
+	if (bFalloff)
+	{
+		if (ATestComplexSystemCharacter* parkourOwner = Cast<ATestComplexSystemCharacter>(CharacterOwner))
+			parkourOwner->OnWallRunFalloff();
+	}
+}
+
+/// <summary>
+/// Shrinks or grows the capsule and moves the mesh so it stays on the ground
+/// </summary>
+/// <param name="bSliding">whether the slide is starting or stopping</param>
+void UParkourMovementComponent::SetSlideCapsule(bool bSliding)
+{
+	UCapsuleComponent* capsule = CharacterOwner->GetCapsuleComponent();
+	UCapsuleComponent* defaultCapsule = CharacterOwner->GetClass()->GetDefaultObject<ACharacter>()->GetCapsuleComponent();
+	capsule->SetCapsuleHalfHeight(bSliding ? SlideHalfHeight : defaultCapsule->GetUnscaledCapsuleHalfHeight());
+
+	USkeletalMeshComponent* mesh = CharacterOwner->GetMesh();
+	FVector meshLocation = mesh->GetComponentLocation();
+	meshLocation.Z += bSliding ? SlideMeshOffset : -SlideMeshOffset;
+	mesh->SetWorldLocation(meshLocation);
+}
+
+/// <summary>
+/// Line traces to both sides for the wall to run on, used by the server of a remote player
+/// </summary>
+/// <returns>true if a wall was found</returns>
+bool UParkourMovementComponent::FindWallRunWall()
+{
+	FCollisionQueryParams TraceParams(SCENE_QUERY_STAT(ParkourServerWallRunTrace));
+	TraceParams.AddIgnoredActor(CharacterOwner);
+	TraceParams.bReturnPhysicalMaterial = true;
+
+	const FVector startLocation = UpdatedComponent->GetComponentLocation();
+	const FVector rightVector = UpdatedComponent->GetRightVector();
+
+	//Check the side the character was last on first
+	const bool sides[2] = { bWallRunRightSide, !bWallRunRightSide };
+	for (bool rightSide : sides)
+	{
+		FHitResult out;
+		FVector endLocation = startLocation + rightVector * (rightSide ? WallRunProbeDistance : -WallRunProbeDistance);
+		PARKOUR_COUNT_TRACES(1);
+		if (GetWorld()->LineTraceSingleByChannel(out, startLocation, endLocation, ECC_Parkour, TraceParams)
+			&& EnumHasAnyFlags(UParkourPhysicalMaterial::GetSurface(out), EParkourSurface::WallRun))
+		{
+			WallRunNormal = out.Normal;
+			bWallRunRightSide = rightSide;
+			bHasWallRunWall = true;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/// <summary>
+/// Clears the one shot requests once the move that used them is done
+/// </summary>
+void UParkourMovementComponent::OnMovementUpdated(float DeltaSeconds, const FVector& OldLocation, const FVector& OldVelocity)
+{
+	Super::OnMovementUpdated(DeltaSeconds, OldLocation, OldVelocity);
+
+	bWantsToWallJump = false;
+	bWantsToVault = false;
+
+	if (IsFixedStepMode())
+		UpdateFixedStepPresentation();
+}
+
+/// <summary>
+/// Sets up and tears down the parkour modes as they are entered and left. This is the
+/// only place the capsule, rotation and gravity are changed for parkour
+/// </summary>
+void UParkourMovementComponent::OnMovementModeChanged(EMovementMode PreviousMovementMode, uint8 PreviousCustomMode)
+{
+	Super::OnMovementModeChanged(PreviousMovementMode, PreviousCustomMode);
+
+	if (PreviousMovementMode == MOVE_Custom && PreviousCustomMode == (uint8)EParkourMovementMode::Slide)
+		SetSlideCapsule(false);
+
+	//However a vault ends, the wall stops being ignored
+	if (PreviousMovementMode == MOVE_Custom && PreviousCustomMode == (uint8)EParkourMovementMode::Vault)
+		SetVaultObstacle(nullptr);
+
+	//The fixed step modes start with no time owed, and put the mesh back on the capsule when they end
+	const bool bWasFixedStepMode = PreviousMovementMode == MOVE_Custom && (PreviousCustomMode == (uint8)EParkourMovementMode::WallRun || PreviousCustomMode == (uint8)EParkourMovementMode::Vault);
+	if (IsFixedStepMode() && !bWasFixedStepMode)
+	{
+		FixedStepAccumulator = 0.0f;
+		FixedStepPreviousLocation = UpdatedComponent->GetComponentLocation();
+	}
+	else if (bWasFixedStepMode && !IsFixedStepMode())
+	{
+		FixedStepAccumulator = 0.0f;
+		UpdateFixedStepPresentation();
+	}
+
+	//Landing ends the drop off a wall
+	if (PreviousMovementMode == MOVE_Falling && MovementMode != MOVE_Falling && bIsWallRunFalloff)
+	{
+		bIsWallRunFalloff = false;
+		GravityScale = 1.0f;
+	}
+
+	if (IsSliding())
+	{
+		SetSlideCapsule(true);
+	}
+	else if (IsWallRunning())
+	{
+		//Simulated proxies only get the movement mode, so they find the wall to know which side it
+		//is on for the animation, and keep the rotation the server sends
+		if (CharacterOwner->GetLocalRole() == ROLE_SimulatedProxy)
+		{
+			FindWallRunWall();
+			return;
+		}
+
+		//Face along the wall, exactly 90 degrees away from its normal, and run straight ahead
+		FRotator newRotation(0.0f, WallRunNormal.Rotation().Yaw + (bWallRunRightSide ? 90.0f : -90.0f), 0.0f);
+		MoveUpdatedComponent(FVector::ZeroVector, newRotation.Quaternion(), false);
+		WallRunDirection = newRotation.Vector();
+		Velocity = WallRunDirection * WallRunSpeed;
+	}
+}
+
+/// <summary>
+/// Unpacks the parkour requests of a remote player on the server
+/// </summary>
+void UParkourMovementComponent::UpdateFromCompressedFlags(uint8 Flags)
+{
+	Super::UpdateFromCompressedFlags(Flags);
+
+	const bool bWantedToWallRun = bWantsToWallRun;
+	bWantsToWallRun = (Flags & FLAG_WantsToWallRun) != 0;
+	bWantsToWallJump = (Flags & FLAG_WantsToWallJump) != 0;
+	bWantsToSlide = (Flags & FLAG_WantsToSlide) != 0;
+	bWantsToVault = (Flags & FLAG_WantsToVault) != 0;
+
+	//A new wall run needs the server to find the wall again
+	if (!bWantedToWallRun && bWantsToWallRun)
+		bHasWallRunWall = false;
+}
+
+FNetworkPredictionData_Client* UParkourMovementComponent::GetPredictionData_Client() const
+{
+	if (ClientPredictionData == nullptr)
+	{
+		UParkourMovementComponent* MutableThis = const_cast<UParkourMovementComponent*>(this);
+		MutableThis->ClientPredictionData = new FNetworkPredictionData_Client_Parkour(*this);
+	}
+
+	return ClientPredictionData;
+}
+
+/// <summary>
+/// Counts the corrections the server sends, shown under "stat Parkour"
+/// </summary>
+void UParkourMovementComponent::OnClientCorrectionReceived(FNetworkPredictionData_Client_Character& ClientData, float TimeStamp, FVector NewLocation, FVector NewVelocity, UPrimitiveComponent* NewBase, FName NewBaseBoneName, bool bHasBase, bool bBaseRelativePosition, uint8 ServerMovementMode)
+{
+	INC_DWORD_STAT(STAT_ParkourClientCorrections);
+
+	Super::OnClientCorrectionReceived(ClientData, TimeStamp, NewLocation, NewVelocity, NewBase, NewBaseBoneName, bHasBase, bBaseRelativePosition, ServerMovementMode);
+}
+
+/// <summary>
+/// Counts the client moves the server disagrees with and sends a correction for, shown
+/// under "stat Parkour" on the server and written to the load test report
+/// </summary>
+bool UParkourMovementComponent::ServerCheckClientError(float ClientTimeStamp, float DeltaTime, const FVector& Accel, const FVector& ClientWorldLocation, const FVector& RelativeClientLocation, UPrimitiveComponent* ClientMovementBase, FName ClientBaseBoneName, uint8 ClientMovementMode)
+{
+	const bool bError = Super::ServerCheckClientError(ClientTimeStamp, DeltaTime, Accel, ClientWorldLocation, RelativeClientLocation, ClientMovementBase, ClientBaseBoneName, ClientMovementMode);
+	if (bError)
+	{
+		INC_DWORD_STAT(STAT_ParkourServerCorrections);
+		++ServerCorrectionCount;
+	}
+	return bError;
+}
+
+/// <summary>
+/// Gets how many client moves the server has corrected
+/// </summary>
+/// <returns>the corrections since the game started, across every character</returns>
+uint32 UParkourMovementComponent::GetServerCorrectionCount()
+{
+	return ServerCorrectionCount;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// FSavedMove_Parkour
+
+void FSavedMove_Parkour::Clear()
+{
+	Super::Clear();
+
+	bSavedWantsToWallRun = false;
+	bSavedWantsToWallJump = false;
+	bSavedWantsToSlide = false;
+	bSavedWantsToVault = false;
+	bSavedFixedStepMode = false;
+	SavedFixedStepAccumulator = 0.0f;
+	SavedVaultTimeRemaining = 0.0f;
+	SavedVaultPath = FParkourVaultPath();
+}
+
+uint8 FSavedMove_Parkour::GetCompressedFlags() const
+{
+	uint8 Result = Super::GetCompressedFlags();
+
+	if (bSavedWantsToWallRun)
+		Result |= FLAG_WantsToWallRun;
+	if (bSavedWantsToWallJump)
+		Result |= FLAG_WantsToWallJump;
+	if (bSavedWantsToSlide)
+		Result |= FLAG_WantsToSlide;
+	if (bSavedWantsToVault)
+		Result |= FLAG_WantsToVault;
+
+	return Result;
+}
+
+bool FSavedMove_Parkour::CanCombineWith(const FSavedMovePtr& NewMove, ACharacter* InCharacter, float MaxDelta) const
+{
+	const FSavedMove_Parkour* NewParkourMove = static_cast<const FSavedMove_Parkour*>(NewMove.Get());
+
+	//Moves that change a parkour request can't be merged or the request would be lost. Vault
+	//moves are fixed step moves, so the vault saved with the first move is never merged away
+	if (bSavedWantsToWallRun != NewParkourMove->bSavedWantsToWallRun
+		|| bSavedWantsToSlide != NewParkourMove->bSavedWantsToSlide
+		|| bSavedWantsToWallJump || NewParkourMove->bSavedWantsToWallJump
+		|| bSavedWantsToVault || NewParkourMove->bSavedWantsToVault
+		|| bSavedFixedStepMode || NewParkourMove->bSavedFixedStepMode)
+	{
+		return false;
+	}
+
+	return Super::CanCombineWith(NewMove, InCharacter, MaxDelta);
+}
+
+void FSavedMove_Parkour::SetMoveFor(ACharacter* C, float InDeltaTime, FVector const& NewAccel, FNetworkPredictionData_Client_Character& ClientData)
+{
+	Super::SetMoveFor(C, InDeltaTime, NewAccel, ClientData);
+
+	if (UParkourMovementComponent* ParkourMovement = Cast<UParkourMovementComponent>(C->GetCharacterMovement()))
+	{
+		bSavedWantsToWallRun = ParkourMovement->bWantsToWallRun;
+		bSavedWantsToWallJump = ParkourMovement->bWantsToWallJump;
+		bSavedWantsToSlide = ParkourMovement->bWantsToSlide;
+		bSavedWantsToVault = ParkourMovement->bWantsToVault;
+		bSavedFixedStepMode = ParkourMovement->IsFixedStepMode();
+		SavedFixedStepAccumulator = ParkourMovement->FixedStepAccumulator;
+		SavedVaultTimeRemaining = ParkourMovement->VaultTimeRemaining;
+		SavedVaultPath = ParkourMovement->VaultPath;
+	}
+}
+
+void FSavedMove_Parkour::PrepMoveFor(ACharacter* C)
+{
+	Super::PrepMoveFor(C);
+
+	if (UParkourMovementComponent* ParkourMovement = Cast<UParkourMovementComponent>(C->GetCharacterMovement()))
+	{
+		ParkourMovement->bWantsToWallRun = bSavedWantsToWallRun;
+		ParkourMovement->bWantsToWallJump = bSavedWantsToWallJump;
+		ParkourMovement->bWantsToSlide = bSavedWantsToSlide;
+		ParkourMovement->bWantsToVault = bSavedWantsToVault;
+		ParkourMovement->FixedStepAccumulator = SavedFixedStepAccumulator;
+		//Replays after a correction would otherwise count down a vault timer the first run already used up
+		ParkourMovement->VaultTimeRemaining = SavedVaultTimeRemaining;
+		ParkourMovement->VaultPath = SavedVaultPath;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// FNetworkPredictionData_Client_Parkour
+
+FNetworkPredictionData_Client_Parkour::FNetworkPredictionData_Client_Parkour(const UCharacterMovementComponent& ClientMovement)
+	: Super(ClientMovement)
+{
+}
+
+FSavedMovePtr FNetworkPredictionData_Client_Parkour::AllocateNewMove()
+{
+	return FSavedMovePtr(new FSavedMove_Parkour());
+}
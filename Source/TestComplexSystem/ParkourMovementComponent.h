@@ -0,0 +1,247 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "ParkourTypes.h"
+#include "ParkourMovementComponent.generated.h"
+
+/** The custom movement modes used by parkour, set as the custom mode of MOVE_Custom */
+UENUM(BlueprintType)
+enum class EParkourMovementMode : uint8
+{
+	None,
+	/** Running along a wall without falling */
+	WallRun,
+	/** Walking with a shrunk capsule */
+	Slide,
+	/** Moving along a path over or onto a wall, with collision on and only the wall ignored */
+	Vault
+};
+
+/**
+ * Character movement with the parkour moves built in as custom movement modes. Wall
+ * running, sliding and vaulting each have their own physics in PhysCustom and run inside
+ * the substeps of the movement update. The character only requests them, and the requests
+ * are sent to the server as compressed flags on every saved move so the owning client
+ * predicts them and replays them after a correction.
+ * Wall runs and vaults are simulated in fixed steps of ParkourFixedTimeStep whatever the
+ * frame rate, with the time left over carried to the next move, so a server ticking at
+ * 20 Hz and a client rendering at 144 Hz get the same wall run out of the same input.
+ * The mesh is drawn between the last two steps so the fixed steps don't show.
+ */
+UCLASS()
+class UParkourMovementComponent : public UCharacterMovementComponent
+{
+	GENERATED_BODY()
+
+	friend class FSavedMove_Parkour;
+
+public:
+	UParkourMovementComponent();
+
+	/** Speed along the wall while wall running */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Parkour")
+	float WallRunSpeed;
+
+	/** Wall running stops once the forward speed drops to this */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Parkour")
+	float WallRunMinSpeed;
+
+	/** Gravity scale after wall running stops from running out of speed, until the character lands */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Parkour")
+	float WallRunFalloffGravityScale;
+
+	/** How far to the side the server looks for the wall of a remote player */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Parkour")
+	float WallRunProbeDistance;
+
+	/** Velocity added away from the wall and upwards when jumping off it */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Parkour")
+	float WallJumpSideVelocity;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Parkour")
+	float WallJumpUpVelocity;
+
+	/** Capsule half height while sliding, and how far the mesh is raised to stay on the ground */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Parkour")
+	float SlideHalfHeight;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Parkour")
+	float SlideMeshOffset;
+
+	/** How long a vault or climb lasts before movement goes back to walking */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Parkour")
+	float VaultDuration;
+
+	/** Length of one step of the wall run and vault physics */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Parkour", meta = (ClampMin = "0.001"))
+	float ParkourFixedTimeStep;
+
+	/** The most fixed steps run in one move, time past that is dropped so a hitch can't snowball */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Parkour", meta = (ClampMin = "1"))
+	int32 MaxParkourFixedSteps;
+
+	/** Requests a wall run along a wall on one side of the character */
+	void StartWallRun(const FVector& WallNormal, bool bRightSide);
+
+	/** Stops requesting a wall run */
+	void StopWallRun();
+
+	/** Requests a jump off the wall being run on */
+	void WallJump();
+
+	/** Requests starting or stopping a slide */
+	void SetWantsToSlide(bool bWantsToSlide);
+
+	/** Requests a vault or climb over the wall found by the character's climb check */
+	void RequestVault();
+
+	/** Starts a vault or climb over the wall found by the character's climb check right away, a requested vault starts here on the next move */
+	void StartVault();
+
+	/** Ends a vault or climb and goes back to walking */
+	void StopVault();
+
+	/** Returns false while dropping off a wall or vaulting */
+	bool CanWallRun() const { return !bIsWallRunFalloff && !IsVaulting(); }
+
+	/** Returns true if in the given parkour movement mode */
+	bool IsParkourMode(EParkourMovementMode Mode) const { return MovementMode == MOVE_Custom && CustomMovementMode == (uint8)Mode; }
+
+	bool IsWallRunning() const { return IsParkourMode(EParkourMovementMode::WallRun); }
+	bool IsSliding() const { return IsParkourMode(EParkourMovementMode::Slide); }
+	bool IsVaulting() const { return IsParkourMode(EParkourMovementMode::Vault); }
+
+	/** Returns true if the wall being run on is to the right of the character, on every copy of it */
+	bool IsWallRunRightSide() const { return bWallRunRightSide; }
+
+	/** Returns true in the parkour modes simulated in fixed steps */
+	bool IsFixedStepMode() const { return IsWallRunning() || IsVaulting(); }
+
+	//Begin UActorComponent Interface
+	virtual void TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+	//End UActorComponent Interface
+
+	//Begin UCharacterMovementComponent Interface
+	virtual bool IsMovingOnGround() const override;
+	virtual float GetMaxSpeed() const override;
+	virtual void PhysicsRotation(float DeltaTime) override;
+	virtual void UpdateFromCompressedFlags(uint8 Flags) override;
+	virtual class FNetworkPredictionData_Client* GetPredictionData_Client() const override;
+	virtual void OnClientCorrectionReceived(class FNetworkPredictionData_Client_Character& ClientData, float TimeStamp, FVector NewLocation, FVector NewVelocity, UPrimitiveComponent* NewBase, FName NewBaseBoneName, bool bHasBase, bool bBaseRelativePosition, uint8 ServerMovementMode) override;
+	virtual bool ServerCheckClientError(float ClientTimeStamp, float DeltaTime, const FVector& Accel, const FVector& ClientWorldLocation, const FVector& RelativeClientLocation, UPrimitiveComponent* ClientMovementBase, FName ClientBaseBoneName, uint8 ClientMovementMode) override;
+	//End UCharacterMovementComponent Interface
+
+	/** Returns how many client moves the server has corrected since the game started, across every character */
+	static uint32 GetServerCorrectionCount();
+
+protected:
+	//Begin UCharacterMovementComponent Interface
+	virtual void UpdateCharacterStateBeforeMovement(float DeltaSeconds) override;
+	virtual void OnMovementUpdated(float DeltaSeconds, const FVector& OldLocation, const FVector& OldVelocity) override;
+	virtual void OnMovementModeChanged(EMovementMode PreviousMovementMode, uint8 PreviousCustomMode) override;
+	virtual void PhysCustom(float deltaTime, int32 Iterations) override;
+	//End UCharacterMovementComponent Interface
+
+	/** Runs along the wall at wall run speed with no vertical movement */
+	void PhysWallRun(float deltaTime, int32 Iterations);
+
+	/** Walks with the shrunk slide capsule */
+	void PhysSlide(float deltaTime, int32 Iterations);
+
+	/** Moves along the vault path, until the vault is over */
+	void PhysVault(float deltaTime, int32 Iterations);
+
+private:
+	/** Starts and stops the wall run mode from the requests at the start of a move */
+	void UpdateWallRun();
+
+	/** Starts and stops the slide mode from the request at the start of a move */
+	void UpdateSlide();
+
+	/** Starts the vault mode from the request at the start of a move */
+	void UpdateVault();
+
+	/** Leaves the wall run mode and starts falling, dropping quickly if the character ran out of speed */
+	void EndWallRun(bool bFalloff);
+
+	/** Shrinks or grows the capsule, moving the mesh so it stays on the ground */
+	void SetSlideCapsule(bool bSliding);
+
+	/** Finds the wall of a remote player on the server, which only has the wall run flag */
+	bool FindWallRunWall();
+
+	/** Stops the capsule ignoring the last wall vaulted and starts it ignoring a new one */
+	void SetVaultObstacle(UPrimitiveComponent* Obstacle);
+
+	/** Adds the time of a move to the fixed step accumulator and takes out the whole steps to run */
+	int32 ConsumeFixedSteps(float deltaTime);
+
+	/** Empties the fixed step accumulator, returning the time it held plus the steps not run yet */
+	float TakeFixedStepRemainder(int32 StepsNotRun);
+
+	/** Draws the mesh between the last two fixed steps, or back on the capsule outside the fixed step modes */
+	void UpdateFixedStepPresentation();
+
+	//Requests, sent to the server as compressed flags
+	uint8 bWantsToWallRun : 1;
+	uint8 bWantsToWallJump : 1;
+	uint8 bWantsToSlide : 1;
+	uint8 bWantsToVault : 1;
+
+	//Wall run state that isn't part of the movement mode
+	uint8 bIsWallRunFalloff : 1;
+	uint8 bHasWallRunWall : 1;
+	uint8 bWallRunRightSide : 1;
+
+	FVector WallRunNormal;
+	//The way along the wall the character runs, set when the wall run starts so turning can't steer it
+	FVector WallRunDirection;
+	float VaultTimeRemaining;
+
+	//Time not simulated yet in the fixed step modes, always less than one step
+	float FixedStepAccumulator;
+	//Where the capsule was before the last fixed step, for drawing the mesh between steps
+	FVector FixedStepPreviousLocation;
+
+	//The vault or climb being done, and the wall it goes over
+	FParkourVaultPath VaultPath;
+	TWeakObjectPtr<UPrimitiveComponent> VaultObstacle;
+};
+
+/** A saved move that also remembers the parkour requests made during it */
+class FSavedMove_Parkour : public FSavedMove_Character
+{
+public:
+	typedef FSavedMove_Character Super;
+
+	virtual void Clear() override;
+	virtual uint8 GetCompressedFlags() const override;
+	virtual bool CanCombineWith(const FSavedMovePtr& NewMove, ACharacter* InCharacter, float MaxDelta) const override;
+	virtual void SetMoveFor(ACharacter* C, float InDeltaTime, FVector const& NewAccel, class FNetworkPredictionData_Client_Character& ClientData) override;
+	virtual void PrepMoveFor(ACharacter* C) override;
+
+	uint8 bSavedWantsToWallRun : 1;
+	uint8 bSavedWantsToWallJump : 1;
+	uint8 bSavedWantsToSlide : 1;
+	uint8 bSavedWantsToVault : 1;
+
+	//Moves in the fixed step modes aren't combined, the server has to run the same steps
+	uint8 bSavedFixedStepMode : 1;
+	float SavedFixedStepAccumulator;
+
+	//The vault at the start of the move, so a replayed vault counts down from the same time along the same path
+	float SavedVaultTimeRemaining;
+	FParkourVaultPath SavedVaultPath;
+};
+
+/** Client prediction data that allocates parkour saved moves */
+class FNetworkPredictionData_Client_Parkour : public FNetworkPredictionData_Client_Character
+{
+public:
+	typedef FNetworkPredictionData_Client_Character Super;
+
+	FNetworkPredictionData_Client_Parkour(const UCharacterMovementComponent& ClientMovement);
+
+	virtual FSavedMovePtr AllocateNewMove() override;
+};
@@ -0,0 +1,28 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ParkourNavAreas.h"
+
+//A vault is over in a moment, so it only costs a little more than walking
+UNavArea_ParkourVault::UNavArea_ParkourVault()
+{
+	DefaultCost = 1.5f;
+	FixedAreaEnteringCost = 50.0f;
+	DrawColor = FColor(64, 200, 255);
+}
+
+//Climbs stop the character while the animation plays
+UNavArea_ParkourClimb::UNavArea_ParkourClimb()
+{
+	DefaultCost = 2.0f;
+	FixedAreaEnteringCost = 150.0f;
+	DrawColor = FColor(255, 160, 32);
+}
+
+//Wall runs can fall off, so they are only taken when the way round is a lot longer
+UNavArea_ParkourWallRun::UNavArea_ParkourWallRun()
+{
+	DefaultCost = 2.0f;
+	FixedAreaEnteringCost = 300.0f;
+	DrawColor = FColor(200, 64, 255);
+}
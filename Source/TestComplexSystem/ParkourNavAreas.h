@@ -0,0 +1,38 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "NavAreas/NavArea.h"
+#include "ParkourNavAreas.generated.h"
+
+/**
+ * Nav link areas for the parkour traversals. Each costs more than walking the same distance,
+ * so AI only vaults, climbs or wall runs when it saves a real detour.
+ */
+UCLASS()
+class UNavArea_ParkourVault : public UNavArea
+{
+	GENERATED_BODY()
+
+public:
+	UNavArea_ParkourVault();
+};
+
+UCLASS()
+class UNavArea_ParkourClimb : public UNavArea
+{
+	GENERATED_BODY()
+
+public:
+	UNavArea_ParkourClimb();
+};
+
+UCLASS()
+class UNavArea_ParkourWallRun : public UNavArea
+{
+	GENERATED_BODY()
+
+public:
+	UNavArea_ParkourWallRun();
+};
@@ -0,0 +1,484 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ParkourNavLinkGenerator.h"
+#include "ParkourNavAreas.h"
+#include "ParkourLedgeProbe.h"
+#include "ParkourPhysicalMaterial.h"
+#include "ParkourTypes.h"
+#include "TestComplexSystem.h"
+#include "Async/Async.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "NavigationSystem.h"
+#include "NavLinkComponent.h"
+#include "NavMesh/RecastNavMesh.h"
+
+DECLARE_CYCLE_STAT(TEXT("Nav Link Scan"), STAT_ParkourNavLinkScan, STATGROUP_Parkour);
+DECLARE_CYCLE_STAT(TEXT("Nav Link Apply"), STAT_ParkourNavLinkApply, STATGROUP_Parkour);
+
+static TAutoConsoleVariable<int32> CVarParkourNavLinks(
+	TEXT("parkour.NavLinks"),
+	1,
+	TEXT("When on, nav links are added over the obstacles parkour characters can vault, climb or wall run past,\n")
+	TEXT("and kept up to date as the navmesh changes. AI parkour characters vault, climb or jump when they reach the start of one.\n")
+	TEXT("Needs runtime navmesh generation to add links while playing.\n")
+	TEXT("0: off, 1: on (default)"),
+	ECVF_Default);
+
+/// <summary>
+/// Drops the parkour nav links of the world and scans the navmesh for them again
+/// </summary>
+/// <param name="World">the world to rebuild the links of</param>
+static void RebuildNavLinksCommand(UWorld* World)
+{
+	if (UParkourNavLinkGenerator* generator = World ? World->GetSubsystem<UParkourNavLinkGenerator>() : nullptr)
+		generator->Rebuild();
+}
+
+static FAutoConsoleCommandWithWorld ParkourRebuildNavLinksCommand(
+	TEXT("parkour.RebuildNavLinks"),
+	TEXT("Drops the parkour nav links and scans the whole navmesh for them again"),
+	FConsoleCommandWithWorldDelegate::CreateStatic(&RebuildNavLinksCommand));
+
+//How close the middle of a poly edge has to be to a portal to lead on to another poly
+static const float PortalTolerance = 5.0f;
+
+//How far the navmesh is searched up and down for the ends of a link
+static const FVector LinkProjectionExtent(50.0f, 50.0f, FParkourLedgeProbe::HeightProbeHeight);
+
+void UParkourNavLinkGenerator::Deinitialize()
+{
+	//The probes use the world, so they have to finish before it goes
+	if (PendingScan.IsValid())
+		PendingScan.Wait();
+
+	if (UNavigationSystemV1* navSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld()))
+		navSys->OnNavigationGenerationFinishedDelegate.RemoveDynamic(this, &UParkourNavLinkGenerator::OnNavigationGenerationFinished);
+
+	if (AActor* host = LinkHost.Get())
+		host->Destroy();
+
+	Tiles.Empty();
+
+	Super::Deinitialize();
+}
+
+const FParkourNavLink* UParkourNavLinkGenerator::FindLink(const FVector& Location, float Radius) const
+{
+	const FParkourNavLink* nearest = nullptr;
+	float nearestDistanceSquared = FMath::Square(Radius);
+
+	for (const TPair<int32, FTileLinks>& tile : Tiles)
+	{
+		for (const FParkourNavLink& link : tile.Value.Links)
+		{
+			const float distanceSquared = FVector::DistSquared(link.Start, Location);
+			if (distanceSquared <= nearestDistanceSquared)
+			{
+				nearest = &link;
+				nearestDistanceSquared = distanceSquared;
+			}
+		}
+	}
+
+	return nearest;
+}
+
+void UParkourNavLinkGenerator::Rebuild()
+{
+	for (TPair<int32, FTileLinks>& tile : Tiles)
+	{
+		if (UNavLinkComponent* component = tile.Value.Component.Get())
+			component->DestroyComponent();
+	}
+
+	Tiles.Empty();
+	bNavigationDirty = true;
+}
+
+void UParkourNavLinkGenerator::OnNavigationGenerationFinished(ANavigationData* NavData)
+{
+	bNavigationDirty = true;
+}
+
+/// <summary>
+/// Picks up the probe results once they are in, and starts a new scan once the navmesh has
+/// finished building. Only one scan runs at a time, changes made while one is running are
+/// scanned after it
+/// </summary>
+/// <param name="DeltaTime">time since the last tick</param>
+void UParkourNavLinkGenerator::Tick(float DeltaTime)
+{
+	if (PendingScan.IsValid())
+	{
+		if (!PendingScan.IsReady())
+			return;
+
+		TArray<FLinkCandidate> candidates = PendingScan.Get();
+		PendingScan = TFuture<TArray<FLinkCandidate>>();
+		ApplyScan(MoveTemp(candidates));
+	}
+
+	if (CVarParkourNavLinks.GetValueOnGameThread() == 0)
+		return;
+
+	UNavigationSystemV1* navSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	if (!navSys)
+		return;
+
+	//The navigation system is made after the subsystems, so it is bound to here
+	if (!bBoundToNavigation)
+	{
+		navSys->OnNavigationGenerationFinishedDelegate.AddUniqueDynamic(this, &UParkourNavLinkGenerator::OnNavigationGenerationFinished);
+		bBoundToNavigation = true;
+	}
+
+	if (!bNavigationDirty || navSys->IsNavigationBuildInProgress())
+		return;
+
+	ARecastNavMesh* navMesh = Cast<ARecastNavMesh>(navSys->GetDefaultNavDataInstance(FNavigationSystem::DontCreate));
+	if (!navMesh)
+		return;
+
+	bNavigationDirty = false;
+	StartScan(navMesh);
+}
+
+/// <summary>
+/// Hashes the polys of every tile and gathers the edges of the ones that changed. Links
+/// are off-mesh connections with two verts, so adding them doesn't change the hash of
+/// their tile and set off another scan
+/// </summary>
+/// <param name="NavMesh">the navmesh to scan</param>
+void UParkourNavLinkGenerator::StartScan(ARecastNavMesh* NavMesh)
+{
+	SCOPE_CYCLE_COUNTER(STAT_ParkourNavLinkScan);
+
+	PendingSignatures.Reset();
+	TArray<FEdgeSample> samples;
+	TArray<FNavPoly> polys;
+	TArray<FVector> verts;
+
+	const int32 tileCount = NavMesh->GetNavMeshTilesCount();
+	for (int32 tile = 0; tile < tileCount; ++tile)
+	{
+		polys.Reset();
+		NavMesh->GetPolysInTile(tile, polys);
+
+		uint32 signature = 0;
+		for (const FNavPoly& poly : polys)
+		{
+			verts.Reset();
+			if (!NavMesh->GetPolyVerts(poly.Ref, verts) || verts.Num() < 3)
+				continue;
+
+			for (const FVector& vert : verts)
+				signature = HashCombine(signature, GetTypeHash(FIntVector(vert)));
+		}
+
+		const FTileLinks* tileLinks = Tiles.Find(tile);
+		const uint32 lastSignature = tileLinks ? tileLinks->Signature : 0;
+		if (signature == lastSignature)
+			continue;
+
+		PendingSignatures.Add(tile, signature);
+		GatherEdgeSamples(NavMesh, tile, samples);
+	}
+
+	//Tiles that are gone lose their links
+	for (const TPair<int32, FTileLinks>& tile : Tiles)
+	{
+		if (tile.Key >= tileCount)
+			PendingSignatures.Add(tile.Key, 0);
+	}
+
+	if (PendingSignatures.Num() == 0)
+		return;
+
+	UE_LOG(LogParkour, Verbose, TEXT("Scanning %d nav tiles for parkour links, %d edge samples"), PendingSignatures.Num(), samples.Num());
+
+	const UWorld* world = GetWorld();
+	const float agentRadius = NavMesh->GetConfig().AgentRadius;
+	const float agentHalfHeight = NavMesh->GetConfig().AgentHeight * 0.5f;
+	PendingNavMesh = NavMesh;
+
+	//Deinitialize waits for the probes, so the world outlives them
+	PendingScan = Async(EAsyncExecution::ThreadPool, [world, agentRadius, agentHalfHeight, samples = MoveTemp(samples)]()
+	{
+		TArray<FLinkCandidate> candidates;
+		FLinkCandidate candidate;
+		for (const FEdgeSample& sample : samples)
+		{
+			if (ProbeEdge(world, sample, agentRadius, agentHalfHeight, candidate))
+				candidates.Add(candidate);
+		}
+		return candidates;
+	});
+}
+
+/// <summary>
+/// Walks round every poly of the tile and samples the edges that don't lead on to another
+/// poly, since those are where the navmesh stops at a wall or a drop
+/// </summary>
+void UParkourNavLinkGenerator::GatherEdgeSamples(const ARecastNavMesh* NavMesh, int32 Tile, TArray<FEdgeSample>& OutSamples) const
+{
+	TArray<FNavPoly> polys;
+	TArray<FVector> verts;
+	TArray<FNavigationPortalEdge> portals;
+	NavMesh->GetPolysInTile(Tile, polys);
+
+	for (const FNavPoly& poly : polys)
+	{
+		verts.Reset();
+		if (!NavMesh->GetPolyVerts(poly.Ref, verts) || verts.Num() < 3)
+			continue;
+
+		portals.Reset();
+		NavMesh->GetPolyEdges(poly.Ref, portals);
+
+		for (int32 i = 0; i < verts.Num(); ++i)
+		{
+			const FVector& start = verts[i];
+			const FVector& end = verts[(i + 1) % verts.Num()];
+			const FVector edge = end - start;
+			const float length = edge.Size2D();
+			if (length < MinEdgeLength)
+				continue;
+
+			const FVector middle = (start + end) * 0.5f;
+			const bool isPortal = portals.ContainsByPredicate([&middle](const FNavigationPortalEdge& Portal)
+			{
+				return FMath::PointDistToSegmentSquared(middle, Portal.Left, Portal.Right) < FMath::Square(PortalTolerance);
+			});
+			if (isPortal)
+				continue;
+
+			//Flat and pointing away from the middle of the poly
+			FVector outward = FVector(edge.Y, -edge.X, 0.0f).GetSafeNormal();
+			if (FVector::DotProduct(outward, poly.Center - middle) > 0.0f)
+				outward = -outward;
+
+			const int32 sampleCount = FMath::Max(1, FMath::FloorToInt(length / EdgeSampleSpacing));
+			for (int32 sampleIndex = 0; sampleIndex < sampleCount; ++sampleIndex)
+				OutSamples.Add({ Tile, FMath::Lerp(start, end, (sampleIndex + 0.5f) / sampleCount), outward });
+		}
+	}
+}
+
+/// <summary>
+/// Runs the climb probe of a character standing on the edge and facing off it. A wall with
+/// a top is a vault or a climb, the same as CheckForClimbing would find. With no wall and a
+/// gap in front, a wall alongside the gap that runs far enough on is a wall run
+/// </summary>
+/// <param name="World">the world to trace in</param>
+/// <param name="Sample">the edge sample to probe from</param>
+/// <param name="AgentRadius">the radius of the nav agent</param>
+/// <param name="AgentHalfHeight">half the height of the nav agent</param>
+/// <param name="OutCandidate">the link that was found, with its end not on the navmesh yet</param>
+/// <returns>true if there is a parkour link here</returns>
+bool UParkourNavLinkGenerator::ProbeEdge(const UWorld* World, const FEdgeSample& Sample, float AgentRadius, float AgentHalfHeight, FLinkCandidate& OutCandidate)
+{
+	FCollisionQueryParams params(SCENE_QUERY_STAT(ParkourNavLinkProbe));
+	params.bReturnPhysicalMaterial = true;
+
+	//Where the actor location of a character standing on the edge would be
+	const FVector actorLocation = Sample.Location + FVector(0.0f, 0.0f, AgentHalfHeight);
+	const FVector probeStart = actorLocation - FVector(0.0f, 0.0f, FParkourLedgeProbe::ProbeHeightOffset);
+
+	OutCandidate.Tile = Sample.Tile;
+	OutCandidate.Link.Start = Sample.Location;
+
+	FHitResult wallHit;
+	if (FParkourLedgeProbe::TraceWall(World, probeStart, Sample.Outward, params, wallHit))
+	{
+		FParkourLedge ledge;
+		if (!FParkourLedgeProbe::TraceTop(World, wallHit, params, ledge))
+			return false;
+
+		//Vaults land past the far edge, climbs end standing on the top just past the face
+		if (ledge.Action == EParkourLedgeAction::Vault)
+		{
+			OutCandidate.Link.Type = EParkourNavLinkType::Vault;
+			OutCandidate.Link.End = ledge.OtherWallHeight - ledge.WallNormal.GetSafeNormal2D() * (AgentRadius + FParkourLedgeProbe::VaultClearance);
+			OutCandidate.Link.End.Z = Sample.Location.Z;
+		}
+		else
+		{
+			OutCandidate.Link.Type = EParkourNavLinkType::Climb;
+			OutCandidate.Link.End = ledge.WallHeight - ledge.WallNormal.GetSafeNormal2D() * AgentRadius;
+		}
+		return true;
+	}
+
+	//Ground right past the edge is a step down the navmesh can walk or fall off already
+	const FVector gapLocation = Sample.Location + Sample.Outward * GapProbeDistance;
+	if (World->LineTraceTestByChannel(gapLocation + FVector(0.0f, 0.0f, AgentHalfHeight), gapLocation - FVector(0.0f, 0.0f, GapDepth), ECC_Parkour, params))
+		return false;
+
+	//The ground to land on at the end of the run
+	const FVector landingLocation = Sample.Location + Sample.Outward * WallRunLength;
+	FHitResult landingHit;
+	if (!World->LineTraceSingleByChannel(landingHit, landingLocation + FVector(0.0f, 0.0f, AgentHalfHeight * 2.0f), landingLocation - FVector(0.0f, 0.0f, GapDepth), ECC_Parkour, params))
+		return false;
+
+	//Wall runs follow walls to the side of the character, so the wall has to be beside the
+	//gap and run along it for the whole way
+	const FVector right = FVector(-Sample.Outward.Y, Sample.Outward.X, 0.0f);
+	for (float side : { 1.0f, -1.0f })
+	{
+		bool runnable = true;
+		for (float distance : { GapProbeDistance, WallRunLength - GapProbeDistance })
+		{
+			const FVector sideStart = actorLocation + Sample.Outward * distance;
+			FHitResult sideHit;
+			if (!World->LineTraceSingleByChannel(sideHit, sideStart, sideStart + right * side * WallRunSideDistance, ECC_Parkour, params)
+				|| FMath::Abs(FVector::DotProduct(sideHit.ImpactNormal, Sample.Outward)) > 0.3f
+				|| !EnumHasAnyFlags(UParkourPhysicalMaterial::GetSurface(sideHit), EParkourSurface::WallRun))
+			{
+				runnable = false;
+				break;
+			}
+		}
+
+		if (runnable)
+		{
+			OutCandidate.Link.Type = EParkourNavLinkType::WallRun;
+			OutCandidate.Link.End = landingHit.ImpactPoint;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/// <summary>
+/// Puts both ends of every link on the navmesh and drops the ones that don't land on it,
+/// then swaps the links of each scanned tile for the new ones
+/// </summary>
+void UParkourNavLinkGenerator::ApplyScan(TArray<FLinkCandidate>&& Candidates)
+{
+	SCOPE_CYCLE_COUNTER(STAT_ParkourNavLinkApply);
+
+	UNavigationSystemV1* navSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	ARecastNavMesh* navMesh = PendingNavMesh.Get();
+	if (!navSys || !navMesh)
+	{
+		//Scan everything again once there is a navmesh to put the links on
+		bNavigationDirty = true;
+		return;
+	}
+
+	const float agentRadius = navMesh->GetConfig().AgentRadius;
+
+	TMap<int32, TArray<FParkourNavLink>> tileLinks;
+	for (FLinkCandidate& candidate : Candidates)
+	{
+		FNavLocation start;
+		FNavLocation end;
+		if (!navSys->ProjectPointToNavigation(candidate.Link.Start, start, LinkProjectionExtent, navMesh)
+			|| !navSys->ProjectPointToNavigation(candidate.Link.End, end, LinkProjectionExtent, navMesh))
+			continue;
+
+		//An end that comes back to the edge doesn't get anywhere
+		if (FVector::DistSquared2D(start.Location, end.Location) < FMath::Square(agentRadius))
+			continue;
+
+		candidate.Link.Start = start.Location;
+		candidate.Link.End = end.Location;
+		tileLinks.FindOrAdd(candidate.Tile).Add(candidate.Link);
+	}
+
+	int32 linkCount = 0;
+	for (const TPair<int32, uint32>& scanned : PendingSignatures)
+	{
+		FTileLinks& tile = Tiles.FindOrAdd(scanned.Key);
+		if (UNavLinkComponent* component = tile.Component.Get())
+			component->DestroyComponent();
+
+		tile.Signature = scanned.Value;
+		tile.Links.Reset();
+		tile.Component.Reset();
+		if (TArray<FParkourNavLink>* links = tileLinks.Find(scanned.Key))
+		{
+			tile.Links = MoveTemp(*links);
+			tile.Component = CreateLinkComponent(tile.Links);
+			linkCount += tile.Links.Num();
+		}
+		else if (tile.Signature == 0)
+		{
+			Tiles.Remove(scanned.Key);
+		}
+	}
+
+	UE_LOG(LogParkour, Verbose, TEXT("Added %d parkour nav links over %d nav tiles"), linkCount, PendingSignatures.Num());
+	PendingSignatures.Reset();
+	PendingNavMesh.Reset();
+}
+
+/// <summary>
+/// Links are placed in world space, so the component sits on the origin and isn't attached
+/// </summary>
+UNavLinkComponent* UParkourNavLinkGenerator::CreateLinkComponent(const TArray<FParkourNavLink>& Links)
+{
+	AActor* host = LinkHost.Get();
+	if (!host)
+	{
+		FActorSpawnParameters spawnParams;
+		spawnParams.ObjectFlags |= RF_Transient;
+		host = GetWorld()->SpawnActor<AActor>(spawnParams);
+		if (!host)
+			return nullptr;
+
+		LinkHost = host;
+	}
+
+	UNavLinkComponent* component = NewObject<UNavLinkComponent>(host, NAME_None, RF_Transient);
+	component->Links.Reset();
+	for (const FParkourNavLink& link : Links)
+	{
+		FNavigationLink& navLink = component->Links.AddDefaulted_GetRef();
+		navLink.Left = link.Start;
+		navLink.Right = link.End;
+		navLink.Direction = ENavLinkDirection::LeftToRight;
+
+		switch (link.Type)
+		{
+		case EParkourNavLinkType::Vault:
+			navLink.SetAreaClass(UNavArea_ParkourVault::StaticClass());
+			break;
+		case EParkourNavLinkType::Climb:
+			navLink.SetAreaClass(UNavArea_ParkourClimb::StaticClass());
+			break;
+		case EParkourNavLinkType::WallRun:
+			navLink.SetAreaClass(UNavArea_ParkourWallRun::StaticClass());
+			break;
+		}
+	}
+
+	component->RegisterComponent();
+	return component;
+}
+
+ETickableTickType UParkourNavLinkGenerator::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+/// <summary>
+/// Links are only made for game worlds, so they aren't saved into levels from the editor
+/// </summary>
+bool UParkourNavLinkGenerator::IsTickable() const
+{
+	return GetWorld() != nullptr && GetWorld()->IsGameWorld() && !IsPendingKill();
+}
+
+TStatId UParkourNavLinkGenerator::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UParkourNavLinkGenerator, STATGROUP_Tickables);
+}
+
+UWorld* UParkourNavLinkGenerator::GetTickableGameObjectWorld() const
+{
+	return GetWorld();
+}
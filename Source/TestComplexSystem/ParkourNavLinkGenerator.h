@@ -0,0 +1,142 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "Async/Future.h"
+#include "ParkourNavLinkGenerator.generated.h"
+
+class ANavigationData;
+class ARecastNavMesh;
+class UNavLinkComponent;
+
+//The traversal a parkour nav link stands for
+enum class EParkourNavLinkType : uint8
+{
+	Vault,
+	Climb,
+	WallRun
+};
+
+//A parkour nav link, kept so AI reaching the start of one knows what to do
+struct FParkourNavLink
+{
+	FVector Start;
+	FVector End;
+	EParkourNavLinkType Type;
+};
+
+/**
+ * Adds nav links over the obstacles parkour characters can get past, so AI takes the same
+ * short cuts as the players instead of walking round. The edges of the navmesh are probed
+ * with the same ledge probe as CheckForClimbing: walls with a far edge in reach get vault
+ * links, taller walls climb links, and gaps with an untagged wall alongside them wall run
+ * links. Only the tiles that changed since the last scan are probed again, and the probes
+ * run on a worker thread, the game thread only reads the navmesh and adds the links.
+ * AI parkour characters look their link up with FindLink when they reach its start.
+ * Turned off with parkour.NavLinks 0.
+ */
+UCLASS()
+class UParkourNavLinkGenerator : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	// USubsystem interface
+	virtual void Deinitialize() override;
+	// End of USubsystem interface
+
+	/**
+	 * Finds the parkour link starting nearest a location.
+	 * @param Location	where the AI is
+	 * @param Radius	how far from the location the link can start
+	 * @return the link, or null if none starts in range
+	 */
+	const FParkourNavLink* FindLink(const FVector& Location, float Radius) const;
+
+	/** Drops every link and scans the whole navmesh again */
+	void Rebuild();
+
+	// FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override;
+	// End of FTickableGameObject interface
+
+	/** Probes along the navmesh edges at most this far apart */
+	static constexpr float EdgeSampleSpacing = 150.0f;
+	/** Navmesh edges shorter than this aren't probed */
+	static constexpr float MinEdgeLength = 60.0f;
+	/** How far out from an edge a gap is looked for */
+	static constexpr float GapProbeDistance = 100.0f;
+	/** How far down a gap has to go before it is worth wall running over */
+	static constexpr float GapDepth = 200.0f;
+	/** How far to each side of a gap a wall to run on is looked for */
+	static constexpr float WallRunSideDistance = 150.0f;
+	/** How far along a wall a wall run link goes */
+	static constexpr float WallRunLength = 600.0f;
+
+private:
+	/** A spot on a navmesh edge to probe from */
+	struct FEdgeSample
+	{
+		int32 Tile;
+		FVector Location;
+		//Flat, pointing off the navmesh
+		FVector Outward;
+	};
+
+	/** What the probes found at an edge sample, before the end is put on the navmesh */
+	struct FLinkCandidate
+	{
+		int32 Tile;
+		FParkourNavLink Link;
+	};
+
+	UFUNCTION()
+	void OnNavigationGenerationFinished(ANavigationData* NavData);
+
+	/** Finds the tiles that changed since the last scan and starts probing their edges */
+	void StartScan(ARecastNavMesh* NavMesh);
+
+	/** Adds the edge samples of a tile */
+	void GatherEdgeSamples(const ARecastNavMesh* NavMesh, int32 Tile, TArray<FEdgeSample>& OutSamples) const;
+
+	/** Puts the links the probes found on the navmesh and swaps them in for the old links of their tiles */
+	void ApplyScan(TArray<FLinkCandidate>&& Candidates);
+
+	/** Runs the probes of one edge sample, on a worker thread */
+	static bool ProbeEdge(const UWorld* World, const FEdgeSample& Sample, float AgentRadius, float AgentHalfHeight, FLinkCandidate& OutCandidate);
+
+	/** Creates the component holding the links of a tile */
+	UNavLinkComponent* CreateLinkComponent(const TArray<FParkourNavLink>& Links);
+
+	/** Keeps the links of each tile in their own component, so a changed tile only rebuilds its own links */
+	struct FTileLinks
+	{
+		//Hash of the polys of the tile when it was last scanned
+		uint32 Signature = 0;
+		TArray<FParkourNavLink> Links;
+		TWeakObjectPtr<UNavLinkComponent> Component;
+	};
+
+	TMap<int32, FTileLinks> Tiles;
+
+	/** Holds the link components */
+	TWeakObjectPtr<AActor> LinkHost;
+
+	/** The probes running on a worker thread */
+	TFuture<TArray<FLinkCandidate>> PendingScan;
+	/** The tiles being scanned and their new signatures */
+	TMap<int32, uint32> PendingSignatures;
+	/** The navmesh being scanned */
+	TWeakObjectPtr<ARecastNavMesh> PendingNavMesh;
+
+	/** Set when the navmesh has changed and should be scanned again */
+	bool bNavigationDirty = true;
+	bool bBoundToNavigation = false;
+};
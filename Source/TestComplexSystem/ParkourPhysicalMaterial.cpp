@@ -0,0 +1,38 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ParkourPhysicalMaterial.h"
+#include "UObject/Package.h"
+
+UParkourPhysicalMaterial::UParkourPhysicalMaterial()
+{
+	SurfaceFlags = (int32)EParkourSurface::All;
+}
+
+/// <summary>
+/// Reads the parkour moves allowed on the surface of a hit from its physical material
+/// </summary>
+/// <param name="Hit">the hit, from a query with bReturnPhysicalMaterial set</param>
+/// <returns>the moves the surface allows, every move if it has no parkour physical material</returns>
+EParkourSurface UParkourPhysicalMaterial::GetSurface(const FHitResult& Hit)
+{
+	const UParkourPhysicalMaterial* material = Cast<UParkourPhysicalMaterial>(Hit.PhysMaterial.Get());
+	return material ? (EParkourSurface)material->SurfaceFlags : EParkourSurface::All;
+}
+
+/// <summary>
+/// Gets the material the parkour surface subsystem puts on surfaces tagged NoWallrun. It is
+/// made the first time it is asked for and kept for the rest of the run
+/// </summary>
+/// <returns>the material</returns>
+UParkourPhysicalMaterial* UParkourPhysicalMaterial::GetNoWallrunMaterial()
+{
+	static UParkourPhysicalMaterial* noWallrunMaterial = nullptr;
+	if (!noWallrunMaterial)
+	{
+		noWallrunMaterial = NewObject<UParkourPhysicalMaterial>(GetTransientPackage(), TEXT("ParkourNoWallrunMaterial"));
+		noWallrunMaterial->SurfaceFlags = (int32)(EParkourSurface::Climb | EParkourSurface::Vault);
+		noWallrunMaterial->AddToRoot();
+	}
+	return noWallrunMaterial;
+}
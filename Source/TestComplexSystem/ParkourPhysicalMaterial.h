@@ -0,0 +1,43 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PhysicalMaterials/PhysicalMaterial.h"
+#include "ParkourPhysicalMaterial.generated.h"
+
+//What a surface can be used for by the parkour characters
+UENUM(meta = (Bitflags, UseEnumValuesAsMaskValuesInEditor = "true"))
+enum class EParkourSurface : uint8
+{
+	None = 0 UMETA(Hidden),
+	WallRun = 1 << 0,
+	Climb = 1 << 1,
+	Vault = 1 << 2,
+	All = 7 UMETA(Hidden)
+};
+ENUM_CLASS_FLAGS(EParkourSurface);
+
+/**
+ * A physical material that says which parkour moves its surfaces can be used for. The
+ * probes ask for the physical material of their hits, so the moves a wall allows come
+ * straight off the hit. Surfaces with any other physical material allow every move.
+ */
+UCLASS()
+class UParkourPhysicalMaterial : public UPhysicalMaterial
+{
+	GENERATED_BODY()
+
+public:
+	UParkourPhysicalMaterial();
+
+	/** Returns the parkour moves the surface of a hit allows, the hit must be from a query returning physical materials */
+	static EParkourSurface GetSurface(const FHitResult& Hit);
+
+	/** Returns the material given to surfaces tagged NoWallrun, everything but wall running */
+	static UParkourPhysicalMaterial* GetNoWallrunMaterial();
+
+	/** The parkour moves surfaces with this material can be used for */
+	UPROPERTY(EditAnywhere, Category = Parkour, meta = (Bitmask, BitmaskEnum = "EParkourSurface"))
+	int32 SurfaceFlags;
+};
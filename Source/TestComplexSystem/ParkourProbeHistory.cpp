@@ -0,0 +1,156 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ParkourProbeHistory.h"
+
+#if PARKOUR_PROBE_HISTORY
+
+#include "TestComplexSystem.h"
+#include "TestComplexSystemCharacter.h"
+#include "Components/PrimitiveComponent.h"
+#include "DrawDebugHelpers.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+#include "Kismet/GameplayStatics.h"
+
+static const TCHAR* GetProbeName(EParkourProbe Probe)
+{
+	switch (Probe)
+	{
+	case EParkourProbe::Ledge:
+		return TEXT("Ledge");
+	case EParkourProbe::WallRunRight:
+		return TEXT("WallRunRight");
+	default:
+		return TEXT("WallRunLeft");
+	}
+}
+
+static const TCHAR* GetOutcomeName(EParkourProbeOutcome Outcome)
+{
+	switch (Outcome)
+	{
+	case EParkourProbeOutcome::Skipped:
+		return TEXT("Skipped");
+	case EParkourProbeOutcome::Miss:
+		return TEXT("Miss");
+	case EParkourProbeOutcome::Rejected:
+		return TEXT("Rejected");
+	default:
+		return TEXT("Used");
+	}
+}
+
+static FColor GetOutcomeColor(EParkourProbeOutcome Outcome)
+{
+	switch (Outcome)
+	{
+	case EParkourProbeOutcome::Skipped:
+		return FColor::Silver;
+	case EParkourProbeOutcome::Miss:
+		return FColor::Red;
+	case EParkourProbeOutcome::Rejected:
+		return FColor::Orange;
+	default:
+		return FColor::Green;
+	}
+}
+
+/// <summary>
+/// Draws each probe as a line from its start to its end in the colour of its outcome, with
+/// the hit point and the way the wall faces where a wall was hit. Probes answered by a baked
+/// ledge index have no line
+/// </summary>
+/// <param name="World">the world to draw in</param>
+/// <param name="Duration">how many seconds the lines stay up</param>
+void FParkourProbeHistory::Draw(const UWorld* World, float Duration) const
+{
+	for (int32 i = 0; i < Count; ++i)
+	{
+		const FParkourProbeRecord& record = (*this)[i];
+		const FColor color = GetOutcomeColor(record.Outcome);
+
+		//Lookups in a baked ledge index didn't trace, so only what they found is drawn
+		if (record.bTraced)
+			DrawDebugLine(World, record.Start, record.End, color, false, Duration);
+		if (record.Outcome == EParkourProbeOutcome::Rejected || record.Outcome == EParkourProbeOutcome::Used)
+		{
+			DrawDebugPoint(World, record.ImpactPoint, 8.0f, color, false, Duration);
+			DrawDebugDirectionalArrow(World, record.ImpactPoint, record.ImpactPoint + record.ImpactNormal * 30.0f, 10.0f, color, false, Duration);
+		}
+	}
+}
+
+/// <summary>
+/// Writes a line for each probe with how long ago it ran, what came of it, whether it traced
+/// or was looked up in a baked ledge index and what it hit
+/// </summary>
+/// <param name="Owner">the name of the character the probes are from</param>
+/// <param name="Now">the world time to measure the age of the probes from</param>
+void FParkourProbeHistory::Dump(const FString& Owner, float Now) const
+{
+	UE_LOG(LogParkour, Display, TEXT("%s: last %d of %d probes"), *Owner, Count, Capacity);
+	for (int32 i = 0; i < Count; ++i)
+	{
+		const FParkourProbeRecord& record = (*this)[i];
+		const UPrimitiveComponent* component = record.Component.Get();
+		UE_LOG(LogParkour, Display, TEXT("  %7.3fs %-12s %-8s %-7s start (%s) end (%s) hit %s at (%s) normal (%s)"),
+			record.Time - Now, GetProbeName(record.Probe), GetOutcomeName(record.Outcome), record.bTraced ? TEXT("traced") : TEXT("indexed"),
+			*record.Start.ToCompactString(), *record.End.ToCompactString(),
+			component ? *FString::Printf(TEXT("%s.%s"), *GetNameSafe(component->GetOwner()), *component->GetName()) : TEXT("nothing"),
+			*record.ImpactPoint.ToCompactString(), *record.ImpactNormal.ToCompactString());
+	}
+}
+
+/// <summary>
+/// Draws or dumps the probe history of the first player's character, or of every parkour
+/// character. Dedicated servers have nothing to draw to, so they only dump
+/// </summary>
+/// <param name="Args">Draw, Dump or Clear, then All to use every character and the seconds to draw for</param>
+/// <param name="World">the world of the characters</param>
+static void ShowProbeHistory(const TArray<FString>& Args, UWorld* World)
+{
+	if (!World)
+		return;
+
+	const FString mode = Args.Num() > 0 ? Args[0] : TEXT("Draw");
+	const bool all = Args.Contains(TEXT("All"));
+	float duration = 10.0f;
+	for (const FString& arg : Args)
+	{
+		if (arg.IsNumeric())
+			duration = FCString::Atof(*arg);
+	}
+
+	TArray<ATestComplexSystemCharacter*, TInlineAllocator<1>> characters;
+	if (all)
+	{
+		for (TActorIterator<ATestComplexSystemCharacter> It(World); It; ++It)
+			characters.Add(*It);
+	}
+	else if (ATestComplexSystemCharacter* character = Cast<ATestComplexSystemCharacter>(UGameplayStatics::GetPlayerPawn(World, 0)))
+	{
+		characters.Add(character);
+	}
+
+	for (ATestComplexSystemCharacter* character : characters)
+	{
+		FParkourProbeHistory& history = character->GetProbeHistory();
+		if (mode == TEXT("Clear"))
+			history.Reset();
+		else if (mode == TEXT("Dump") || World->GetNetMode() == NM_DedicatedServer)
+			history.Dump(character->GetName(), World->GetTimeSeconds());
+		else
+			history.Draw(World, duration);
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs ParkourProbeHistoryCommand(
+	TEXT("parkour.ProbeHistory"),
+	TEXT("Draws or logs the last climb and wall run probes of the player, or of every parkour character. Green was used, orange found a wall that wasn't used, red missed and grey was skipped by the probe budget.\n")
+	TEXT("Ledge probes answered by a baked ledge index didn't trace, so they are drawn without a line and dumped as indexed.\n")
+	TEXT("Usage: parkour.ProbeHistory <Draw|Dump|Clear=Draw> <All> <Seconds=10>"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&ShowProbeHistory));
+
+#endif
@@ -0,0 +1,130 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+//The probe history is compiled out of shipping builds so it costs nothing in production
+#ifndef PARKOUR_PROBE_HISTORY
+#define PARKOUR_PROBE_HISTORY !UE_BUILD_SHIPPING
+#endif
+
+#if PARKOUR_PROBE_HISTORY
+
+class UPrimitiveComponent;
+
+//Which of the character's probes a record is from
+enum class EParkourProbe : uint8
+{
+	Ledge,
+	WallRunRight,
+	WallRunLeft
+};
+
+//What came of a probe
+enum class EParkourProbeOutcome : uint8
+{
+	//The probe budget was used up, so the probe didn't run
+	Skipped,
+	//Nothing was found
+	Miss,
+	//A wall was found but not used, because of the character's state, the wall's surface or
+	//because nothing went on to climb or vault it
+	Rejected,
+	//The wall was used to climb, vault or wall run
+	Used
+};
+
+/** One probe of a parkour character */
+struct FParkourProbeRecord
+{
+	//World time the probe ran at
+	float Time;
+	FVector Start;
+	FVector End;
+	//Where the wall was hit and the way it faces, zero on a miss
+	FVector ImpactPoint;
+	FVector ImpactNormal;
+	TWeakObjectPtr<UPrimitiveComponent> Component;
+	EParkourProbe Probe;
+	EParkourProbeOutcome Outcome;
+	//False when the wall was looked up in a baked ledge index instead of traced for
+	bool bTraced;
+};
+
+/**
+ * The last probes of a parkour character, kept in a fixed size ring buffer inside the character
+ * so recording never allocates. Nothing is drawn while recording, parkour.ProbeHistory draws
+ * or dumps the buffer after the fact.
+ */
+class FParkourProbeHistory
+{
+public:
+	//How many probes are kept, the oldest are written over
+	static constexpr int32 Capacity = 64;
+
+	void Add(float Time, EParkourProbe Probe, EParkourProbeOutcome Outcome, const FVector& Start, const FVector& End,
+		const FVector& ImpactPoint, const FVector& ImpactNormal, UPrimitiveComponent* Component, bool bTraced = true)
+	{
+		FParkourProbeRecord& record = Records[Head];
+		record.Time = Time;
+		record.Start = Start;
+		record.End = End;
+		record.ImpactPoint = ImpactPoint;
+		record.ImpactNormal = ImpactNormal;
+		record.Component = Component;
+		record.Probe = Probe;
+		record.Outcome = Outcome;
+		record.bTraced = bTraced;
+
+		Head = (Head + 1) % Capacity;
+		Count = FMath::Min(Count + 1, Capacity);
+	}
+
+	int32 Num() const { return Count; }
+
+	/** Gets a record, 0 being the oldest */
+	const FParkourProbeRecord& operator[](int32 Index) const
+	{
+		check(Index >= 0 && Index < Count);
+		return Records[(Head - Count + Index + Capacity) % Capacity];
+	}
+
+	/**
+	 * Marks the newest record of a probe as used, for probes whose wall is only used later on.
+	 * Only a record that found a wall and hasn't been used yet is marked.
+	 */
+	void MarkUsed(EParkourProbe Probe)
+	{
+		for (int32 i = Count - 1; i >= 0; --i)
+		{
+			FParkourProbeRecord& record = Records[(Head - Count + i + Capacity) % Capacity];
+			if (record.Probe != Probe)
+				continue;
+
+			if (record.Outcome == EParkourProbeOutcome::Rejected)
+				record.Outcome = EParkourProbeOutcome::Used;
+			return;
+		}
+	}
+
+	void Reset()
+	{
+		Head = 0;
+		Count = 0;
+	}
+
+	/** Draws every record, coloured by outcome, for a number of seconds */
+	void Draw(const UWorld* World, float Duration) const;
+
+	/** Writes every record to the log, oldest first */
+	void Dump(const FString& Owner, float Now) const;
+
+private:
+	FParkourProbeRecord Records[Capacity];
+	//The slot the next record is written to
+	int32 Head = 0;
+	int32 Count = 0;
+};
+
+#endif
@@ -0,0 +1,132 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ParkourProbeScheduler.h"
+#include "TestComplexSystemCharacter.h"
+#include "ParkourStats.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Probe Scheduler"), STAT_ParkourProbeScheduler, STATGROUP_Parkour);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Probes Run"), STAT_ParkourProbesRun, STATGROUP_Parkour);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Probes Deferred"), STAT_ParkourProbesDeferred, STATGROUP_Parkour);
+
+static TAutoConsoleVariable<int32> CVarParkourMaxProbeTracesPerFrame(
+	TEXT("parkour.MaxProbeTracesPerFrame"),
+	64,
+	TEXT("The most parkour probe traces made each frame by characters not controlled by a player.\n")
+	TEXT("Probes that don't fit are dropped and keep their last result until a later frame. On by default, which holds AI back\n")
+	TEXT("whenever more than this many traces are asked for in a frame. 0: no budget, characters probe as they tick"),
+	ECVF_Default);
+
+void UParkourProbeScheduler::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	WorldTickStartHandle = FWorldDelegates::OnWorldTickStart.AddUObject(this, &UParkourProbeScheduler::OnWorldTickStart);
+}
+
+void UParkourProbeScheduler::Deinitialize()
+{
+	FWorldDelegates::OnWorldTickStart.Remove(WorldTickStartHandle);
+
+	Super::Deinitialize();
+}
+
+/// <summary>
+/// Starts the budget over at the start of the frame rather than at the end of the queue, so
+/// traces taken by the batched probes count towards the frame they run in whichever of the
+/// two tickables runs first
+/// </summary>
+void UParkourProbeScheduler::OnWorldTickStart(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+{
+	if (World == GetWorld())
+		TracesThisFrame = 0;
+}
+
+bool UParkourProbeScheduler::IsBudgeted()
+{
+	return CVarParkourMaxProbeTracesPerFrame.GetValueOnGameThread() > 0;
+}
+
+/// <summary>
+/// Players are never held back. A local player would feel the missed probe, and the server
+/// checks a remote player's vault when it moves, so refusing it would undo a vault the
+/// client has already predicted and send it a correction. Replays exempt their characters
+/// so a recording plays the same whatever else is probing
+/// </summary>
+bool UParkourProbeScheduler::IsExempt(const ATestComplexSystemCharacter* Character)
+{
+	return Character->IsPlayerControlled() || Character->IsProbeBudgetExempt();
+}
+
+void UParkourProbeScheduler::RequestProbe(ATestComplexSystemCharacter* Character, float Priority, int32 Traces)
+{
+	Requests.Add({ Character, Priority, Traces });
+}
+
+/// <summary>
+/// Players always get their traces, everyone else only gets them while the budget lasts
+/// </summary>
+bool UParkourProbeScheduler::TryConsume(const ATestComplexSystemCharacter* Character, int32 Traces)
+{
+	if (!IsExempt(Character) && TracesThisFrame + Traces > CVarParkourMaxProbeTracesPerFrame.GetValueOnGameThread())
+		return false;
+
+	TracesThisFrame += Traces;
+	return true;
+}
+
+/// <summary>
+/// Runs the queued wall run probes in priority order until the budget runs out, and drops
+/// the rest. Tickable objects tick after the actors, so every request of the frame is in by now
+/// </summary>
+/// <param name="DeltaTime">time since the last tick</param>
+void UParkourProbeScheduler::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_ParkourProbeScheduler);
+
+	const int32 maxTraces = CVarParkourMaxProbeTracesPerFrame.GetValueOnGameThread();
+
+	Requests.Sort([](const FProbeRequest& A, const FProbeRequest& B) { return A.Priority > B.Priority; });
+
+	for (const FProbeRequest& request : Requests)
+	{
+		ATestComplexSystemCharacter* character = request.Character.Get();
+		if (!character)
+			continue;
+
+		//Probes that don't fit are dropped, the character asks again next tick with a higher priority
+		if (!IsExempt(character) && TracesThisFrame + request.Traces > maxTraces)
+		{
+			INC_DWORD_STAT(STAT_ParkourProbesDeferred);
+			continue;
+		}
+
+		TracesThisFrame += request.Traces;
+		INC_DWORD_STAT(STAT_ParkourProbesRun);
+		character->RunScheduledProbe();
+	}
+
+	Requests.Reset();
+}
+
+ETickableTickType UParkourProbeScheduler::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+bool UParkourProbeScheduler::IsTickable() const
+{
+	return GetWorld() != nullptr && !IsPendingKill();
+}
+
+TStatId UParkourProbeScheduler::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UParkourProbeScheduler, STATGROUP_Tickables);
+}
+
+UWorld* UParkourProbeScheduler::GetTickableGameObjectWorld() const
+{
+	return GetWorld();
+}
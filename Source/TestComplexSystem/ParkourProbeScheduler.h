@@ -0,0 +1,85 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "Engine/EngineBaseTypes.h"
+#include "ParkourProbeScheduler.generated.h"
+
+class ATestComplexSystemCharacter;
+
+/**
+ * Caps how many parkour line traces are made each frame across every character. Climb
+ * checks take their traces from the frame's budget as they happen, wall run probes are
+ * queued during the frame and the most important ones run at the end of it with whatever
+ * budget is left. Probes that don't fit are dropped, and their characters keep their last
+ * result and ask again on their next tick, with a higher priority for having waited. The
+ * budget starts over when the world starts ticking, so climb checks, batched probes and the
+ * queue all draw on the same frame's budget whatever order they run in. Characters
+ * controlled by a player, local or remote, are never held back, so the cap only applies
+ * to everything else.
+ * The budget is set with parkour.MaxProbeTracesPerFrame and is on by default, 0 turns the scheduler off.
+ */
+UCLASS()
+class UParkourProbeScheduler : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	// USubsystem interface
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	// End of USubsystem interface
+
+	/** Returns true if the budget is on and probes should go through the scheduler */
+	static bool IsBudgeted();
+
+	/**
+	 * Queues a wall run probe to run at the end of the frame if it fits in the budget.
+	 * @param Character	the character to probe for
+	 * @param Priority	higher runs first, see ATestComplexSystemCharacter::GetProbePriority
+	 * @param Traces	the most traces the probe can make
+	 */
+	void RequestProbe(ATestComplexSystemCharacter* Character, float Priority, int32 Traces);
+
+	/**
+	 * Takes traces out of this frame's budget for a probe that has to run right away.
+	 * @param Character	the character probing
+	 * @param Traces	the most traces the probe can make
+	 * @return false if the probe doesn't fit and should be skipped
+	 */
+	bool TryConsume(const ATestComplexSystemCharacter* Character, int32 Traces);
+
+	// FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override;
+	// End of FTickableGameObject interface
+
+private:
+	/** A wall run probe waiting for the end of the frame */
+	struct FProbeRequest
+	{
+		TWeakObjectPtr<ATestComplexSystemCharacter> Character;
+		float Priority;
+		int32 Traces;
+	};
+
+	/** Starts a new budget before anything in the world ticks */
+	void OnWorldTickStart(UWorld* World, ELevelTick TickType, float DeltaSeconds);
+
+	/** Returns true if the character is controlled by a player or exempted, and is never held back */
+	static bool IsExempt(const ATestComplexSystemCharacter* Character);
+
+	/** Wall run probes queued this frame, reused every frame */
+	TArray<FProbeRequest> Requests;
+
+	/** Traces already taken out of this frame's budget */
+	int32 TracesThisFrame = 0;
+
+	FDelegateHandle WorldTickStartHandle;
+};
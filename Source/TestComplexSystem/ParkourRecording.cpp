@@ -0,0 +1,186 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ParkourRecording.h"
+#include "TestComplexSystem.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+FParkourRecordingWriter::FParkourRecordingWriter(uint16 InSampleRate, float InPositionStep)
+	: SampleRate(FMath::Max<uint16>(1, InSampleRate))
+	, PositionStep(InPositionStep)
+	, Origin(FVector::ZeroVector)
+	, bClamped(false)
+{
+}
+
+/// <summary>
+/// Quantizes a sample. Positions are whole steps from the first sample, which covers about
+/// 650 metres either way at the default 2 unit step
+/// </summary>
+void FParkourRecordingWriter::AddSample(const FVector& Location, float Yaw, EParkourRunnerState State)
+{
+	if (Samples.Num() == 0)
+		Origin = Location;
+
+	const FVector steps = (Location - Origin) / PositionStep;
+	auto quantize = [this](float Value)
+	{
+		const int32 rounded = FMath::RoundToInt(Value);
+		const int32 clamped = FMath::Clamp(rounded, (int32)MIN_int16, (int32)MAX_int16);
+		bClamped |= rounded != clamped;
+		return (int16)clamped;
+	};
+
+	FParkourRecordingSample& sample = Samples.AddDefaulted_GetRef();
+	sample.X = quantize(steps.X);
+	sample.Y = quantize(steps.Y);
+	sample.Z = quantize(steps.Z);
+	sample.Yaw = FRotator::CompressAxisToShort(Yaw);
+	sample.State = State;
+	sample.Reserved = 0;
+}
+
+void FParkourRecordingWriter::AddAction(EParkourRecordedAction Action)
+{
+	FParkourRecordingAction& action = Actions.AddZeroed_GetRef();
+	action.Sample = FMath::Max(0, Samples.Num() - 1);
+	action.Action = Action;
+}
+
+bool FParkourRecordingWriter::Save(const FString& FileName) const
+{
+	if (bClamped)
+		UE_LOG(LogParkour, Warning, TEXT("Parkour recording %s went too far from where it started, some samples were clamped"), *FileName);
+
+	FParkourRecordingHeader header;
+	header.Magic = Magic;
+	header.Version = Version;
+	header.SampleRate = SampleRate;
+	header.NumSamples = Samples.Num();
+	header.NumActions = Actions.Num();
+	header.OriginX = Origin.X;
+	header.OriginY = Origin.Y;
+	header.OriginZ = Origin.Z;
+	header.PositionStep = PositionStep;
+
+	TArray<uint8> data;
+	data.Reserve(sizeof(header) + Samples.Num() * sizeof(FParkourRecordingSample) + Actions.Num() * sizeof(FParkourRecordingAction));
+	data.Append((const uint8*)&header, sizeof(header));
+	data.Append((const uint8*)Samples.GetData(), Samples.Num() * sizeof(FParkourRecordingSample));
+	data.Append((const uint8*)Actions.GetData(), Actions.Num() * sizeof(FParkourRecordingAction));
+
+	return FFileHelper::SaveArrayToFile(data, *FileName);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// FParkourRecordingReader
+
+FParkourRecordingReader::FParkourRecordingReader()
+	: Header(nullptr)
+	, Samples(nullptr)
+	, Actions(nullptr)
+{
+}
+
+FParkourRecordingReader::~FParkourRecordingReader()
+{
+	Close();
+}
+
+/// <summary>
+/// Maps the whole file and points the header, samples and actions straight into it after
+/// checking the sizes add up
+/// </summary>
+bool FParkourRecordingReader::Open(const FString& FileName)
+{
+	Close();
+
+	const uint8* data = nullptr;
+	int64 size = 0;
+
+	MappedHandle.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*FileName));
+	if (MappedHandle)
+		MappedRegion.Reset(MappedHandle->MapRegion(0, MappedHandle->GetFileSize()));
+
+	if (MappedRegion)
+	{
+		data = MappedRegion->GetMappedPtr();
+		size = MappedRegion->GetMappedSize();
+	}
+	else if (FFileHelper::LoadFileToArray(LoadedData, *FileName, FILEREAD_Silent))
+	{
+		data = LoadedData.GetData();
+		size = LoadedData.Num();
+	}
+
+	if (!data || size < (int64)sizeof(FParkourRecordingHeader))
+	{
+		Close();
+		return false;
+	}
+
+	const FParkourRecordingHeader* header = (const FParkourRecordingHeader*)data;
+	const int64 expectedSize = sizeof(FParkourRecordingHeader) + (int64)header->NumSamples * sizeof(FParkourRecordingSample) + (int64)header->NumActions * sizeof(FParkourRecordingAction);
+	if (header->Magic != FParkourRecordingWriter::Magic || header->Version != FParkourRecordingWriter::Version || header->SampleRate == 0 || header->NumSamples == 0 || size < expectedSize)
+	{
+		UE_LOG(LogParkour, Warning, TEXT("%s isn't a parkour recording this version can read"), *FileName);
+		Close();
+		return false;
+	}
+
+	Header = header;
+	Samples = (const FParkourRecordingSample*)(data + sizeof(FParkourRecordingHeader));
+	Actions = (const FParkourRecordingAction*)(Samples + header->NumSamples);
+	return true;
+}
+
+void FParkourRecordingReader::Close()
+{
+	Header = nullptr;
+	Samples = nullptr;
+	Actions = nullptr;
+
+	MappedRegion.Reset();
+	MappedHandle.Reset();
+	LoadedData.Empty();
+}
+
+FVector FParkourRecordingReader::GetLocation(int32 SampleIndex) const
+{
+	const FParkourRecordingSample& sample = Samples[SampleIndex];
+	return FVector(Header->OriginX, Header->OriginY, Header->OriginZ) + FVector(sample.X, sample.Y, sample.Z) * Header->PositionStep;
+}
+
+float FParkourRecordingReader::GetYaw(int32 SampleIndex) const
+{
+	return FRotator::DecompressAxisFromShort(Samples[SampleIndex].Yaw);
+}
+
+/// <summary>
+/// Blends the location and yaw between the two samples either side of the time. The state
+/// isn't blended, it is the state of the earlier sample
+/// </summary>
+void FParkourRecordingReader::Evaluate(float Time, FVector& OutLocation, float& OutYaw, EParkourRunnerState& OutState) const
+{
+	const float samplePosition = FMath::Clamp(Time / GetSampleInterval(), 0.0f, (float)(GetNumSamples() - 1));
+	const int32 from = FMath::FloorToInt(samplePosition);
+	const int32 to = FMath::Min(from + 1, GetNumSamples() - 1);
+	const float alpha = samplePosition - from;
+
+	OutLocation = FMath::Lerp(GetLocation(from), GetLocation(to), alpha);
+	OutYaw = FMath::Lerp(GetYaw(from), GetYaw(from) + FRotator::NormalizeAxis(GetYaw(to) - GetYaw(from)), alpha);
+	OutState = GetState(from);
+}
+
+FString FParkourRecordingReader::GetRecordingDir()
+{
+	return FPaths::ProjectSavedDir() / TEXT("Parkour") / TEXT("Recordings");
+}
+
+FString FParkourRecordingReader::GetRecordingFile(const FString& Name)
+{
+	return GetRecordingDir() / (Name + TEXT(".pkr"));
+}
@@ -0,0 +1,147 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ParkourTypes.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+//The parkour actions a recording keeps, in the order they happened
+enum class EParkourRecordedAction : uint8
+{
+	StartSlide,
+	StopSlide,
+	VaultOrGetUp,
+	Jump,
+	WallJump
+};
+
+//Start of a recording file. The samples follow the header and the actions follow the samples
+struct FParkourRecordingHeader
+{
+	uint32 Magic;
+	uint16 Version;
+	//Samples per second
+	uint16 SampleRate;
+	uint32 NumSamples;
+	uint32 NumActions;
+	//Sample positions are stored as whole steps of PositionStep away from the origin
+	float OriginX;
+	float OriginY;
+	float OriginZ;
+	float PositionStep;
+};
+static_assert(sizeof(FParkourRecordingHeader) == 32, "The recording header is read straight from the file");
+
+//One sample of a recorded character, 10 bytes
+struct FParkourRecordingSample
+{
+	int16 X;
+	int16 Y;
+	int16 Z;
+	//Yaw over the full circle in 65536 steps
+	uint16 Yaw;
+	EParkourRunnerState State;
+	uint8 Reserved;
+};
+static_assert(sizeof(FParkourRecordingSample) == 10, "Recording samples are read straight from the file");
+
+//An action and the sample it happened on
+struct FParkourRecordingAction
+{
+	uint32 Sample;
+	EParkourRecordedAction Action;
+	uint8 Reserved[3];
+};
+static_assert(sizeof(FParkourRecordingAction) == 8, "Recording actions are read straight from the file");
+
+/**
+ * Records a parkour run as quantized samples taken at a fixed rate plus the actions taken
+ * between them, and writes it out in the layout FParkourRecordingReader maps.
+ */
+class FParkourRecordingWriter
+{
+public:
+	static constexpr uint32 Magic = 0x4B524150; // "PARK"
+	static constexpr uint16 Version = 1;
+
+	explicit FParkourRecordingWriter(uint16 InSampleRate = 30, float InPositionStep = 2.0f);
+
+	/** Adds a sample. The first sample sets the origin the rest are stored relative to */
+	void AddSample(const FVector& Location, float Yaw, EParkourRunnerState State);
+
+	/** Adds an action on the current sample */
+	void AddAction(EParkourRecordedAction Action);
+
+	/** Seconds between samples */
+	float GetSampleInterval() const { return 1.0f / SampleRate; }
+
+	int32 GetNumSamples() const { return Samples.Num(); }
+
+	/** Writes the recording to a file, returns false if it couldn't be written */
+	bool Save(const FString& FileName) const;
+
+private:
+	uint16 SampleRate;
+	float PositionStep;
+	FVector Origin;
+	//Whether a location had to be clamped to fit in the sample range
+	bool bClamped;
+
+	TArray<FParkourRecordingSample> Samples;
+	TArray<FParkourRecordingAction> Actions;
+};
+
+/**
+ * A recording mapped straight from disk. Nothing is copied or parsed, the samples and actions
+ * are read in place, so any number of ghosts can share one reader.
+ */
+class FParkourRecordingReader
+{
+public:
+	FParkourRecordingReader();
+	~FParkourRecordingReader();
+
+	/** Maps a recording file, falling back to loading it if the platform can't map files */
+	bool Open(const FString& FileName);
+
+	bool IsValid() const { return Header != nullptr; }
+
+	int32 GetNumSamples() const { return Header ? Header->NumSamples : 0; }
+	int32 GetNumActions() const { return Header ? Header->NumActions : 0; }
+	float GetSampleInterval() const { return Header ? 1.0f / Header->SampleRate : 0.0f; }
+	float GetDuration() const { return GetNumSamples() > 1 ? (GetNumSamples() - 1) * GetSampleInterval() : 0.0f; }
+
+	/** Returns the location of a sample */
+	FVector GetLocation(int32 SampleIndex) const;
+
+	/** Returns the yaw of a sample in degrees */
+	float GetYaw(int32 SampleIndex) const;
+
+	EParkourRunnerState GetState(int32 SampleIndex) const { return Samples[SampleIndex].State; }
+
+	const FParkourRecordingAction& GetAction(int32 ActionIndex) const { return Actions[ActionIndex]; }
+
+	/** Works out the location, yaw and state at a time, blending between the samples either side */
+	void Evaluate(float Time, FVector& OutLocation, float& OutYaw, EParkourRunnerState& OutState) const;
+
+	/** The recordings folder, Saved/Parkour/Recordings */
+	static FString GetRecordingDir();
+
+	/** The file of a named recording */
+	static FString GetRecordingFile(const FString& Name);
+
+private:
+	void Close();
+
+	TUniquePtr<IMappedFileHandle> MappedHandle;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+	//Used instead of the mapping on platforms that can't map files
+	TArray<uint8> LoadedData;
+
+	const FParkourRecordingHeader* Header;
+	const FParkourRecordingSample* Samples;
+	const FParkourRecordingAction* Actions;
+};
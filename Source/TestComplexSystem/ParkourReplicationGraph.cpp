@@ -0,0 +1,251 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ParkourReplicationGraph.h"
+#include "TestComplexSystemCharacter.h"
+#include "TestComplexSystem.h"
+#include "Engine/NetConnection.h"
+#include "Engine/NetDriver.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "GameFramework/Info.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+#include "UObject/UObjectIterator.h"
+
+UParkourReplicationGraph::UParkourReplicationGraph()
+{
+	GridCellSize = 10000.0f;
+	SpatialBias = FVector2D(-200000.0f, -200000.0f);
+
+	GridNode = nullptr;
+	AlwaysRelevantNode = nullptr;
+}
+
+/// <summary>
+/// Gets the parkour replication graph running the world's net driver
+/// </summary>
+/// <param name="World">the world to get the graph for</param>
+/// <returns>the graph, or null if the world isn't a server or another replication driver is configured</returns>
+UParkourReplicationGraph* UParkourReplicationGraph::Get(const UWorld* World)
+{
+	UNetDriver* netDriver = World ? World->GetNetDriver() : nullptr;
+	return netDriver ? Cast<UParkourReplicationGraph>(netDriver->GetReplicationDriver()) : nullptr;
+}
+
+/// <summary>
+/// Updates how many frames apart an actor replicates from its NetUpdateFrequency. The graph
+/// copies the period from the class settings when the actor is added, so a rate the actor
+/// sets later is only picked up through here
+/// </summary>
+/// <param name="Actor">the actor whose NetUpdateFrequency changed</param>
+void UParkourReplicationGraph::UpdateActorNetUpdateFrequency(AActor* Actor)
+{
+	if (FGlobalActorReplicationInfo* globalInfo = GlobalActorReplicationInfoMap.Find(Actor))
+		globalInfo->Settings.ReplicationPeriodFrame = GetReplicationPeriodFrameForFrequency(FMath::Max(Actor->NetUpdateFrequency, 0.1f));
+}
+
+/// <summary>
+/// Forgets the routing of the classes of the last world, blueprint classes may have been unloaded
+/// </summary>
+void UParkourReplicationGraph::ResetGameWorldState()
+{
+	Super::ResetGameWorldState();
+
+	ClassRouting.Reset();
+}
+
+/// <summary>
+/// Sets the replication settings of every replicated actor class loaded now. Classes loaded
+/// later use the settings of their closest native parent
+/// </summary>
+void UParkourReplicationGraph::InitGlobalActorClassSettings()
+{
+	Super::InitGlobalActorClassSettings();
+
+	InitClassSettings(AActor::StaticClass());
+	for (TObjectIterator<UClass> It; It; ++It)
+	{
+		UClass* actorClass = *It;
+		if (!actorClass->IsChildOf(AActor::StaticClass()) || actorClass->HasAnyClassFlags(CLASS_Abstract | CLASS_Deprecated | CLASS_NewerVersionExists))
+			continue;
+
+		//Skeleton and reinstanced blueprint classes aren't spawned
+		if (actorClass->GetName().StartsWith(TEXT("SKEL_")) || actorClass->GetName().StartsWith(TEXT("REINST_")))
+			continue;
+
+		if (actorClass->GetDefaultObject<AActor>()->GetIsReplicated())
+			InitClassSettings(actorClass);
+	}
+}
+
+/// <summary>
+/// Creates the grid the moving actors are kept in and the list of actors relevant to everyone
+/// </summary>
+void UParkourReplicationGraph::InitGlobalGraphNodes()
+{
+	GridNode = CreateNewNode<UReplicationGraphNode_GridSpatialization2D>();
+	GridNode->CellSize = GridCellSize;
+	GridNode->SpatialBias = SpatialBias;
+	AddGlobalGraphNode(GridNode);
+
+	AlwaysRelevantNode = CreateNewNode<UReplicationGraphNode_ActorList>();
+	AddGlobalGraphNode(AlwaysRelevantNode);
+}
+
+/// <summary>
+/// Gives a connection a node for its own controller and view target, which are left out of the grid
+/// </summary>
+/// <param name="RepGraphConnection">the connection being added</param>
+void UParkourReplicationGraph::InitConnectionGraphNodes(UNetReplicationGraphConnection* RepGraphConnection)
+{
+	Super::InitConnectionGraphNodes(RepGraphConnection);
+
+	UReplicationGraphNode_AlwaysRelevant_ForConnection* connectionNode = CreateNewNode<UReplicationGraphNode_AlwaysRelevant_ForConnection>();
+	AddConnectionGraphNode(connectionNode, RepGraphConnection);
+}
+
+/// <summary>
+/// Adds a new replicated actor to the grid or the always relevant list
+/// </summary>
+/// <param name="ActorInfo">the actor being added</param>
+/// <param name="GlobalInfo">the replication settings of the actor</param>
+void UParkourReplicationGraph::RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo)
+{
+	switch (GetRouting(ActorInfo.Class))
+	{
+	case EParkourRepRouting::AlwaysRelevant:
+		AlwaysRelevantNode->NotifyAddNetworkActor(ActorInfo);
+		break;
+	case EParkourRepRouting::SpatializeStatic:
+		GridNode->AddActor_Static(ActorInfo, GlobalInfo);
+		break;
+	case EParkourRepRouting::SpatializeDynamic:
+		GridNode->AddActor_Dynamic(ActorInfo, GlobalInfo);
+		break;
+	case EParkourRepRouting::SpatializeDormancy:
+		GridNode->AddActor_Dormancy(ActorInfo, GlobalInfo);
+		break;
+	default:
+		break;
+	}
+}
+
+/// <summary>
+/// Takes a replicated actor out of the node it was added to
+/// </summary>
+/// <param name="ActorInfo">the actor being removed</param>
+void UParkourReplicationGraph::RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo)
+{
+	switch (GetRouting(ActorInfo.Class))
+	{
+	case EParkourRepRouting::AlwaysRelevant:
+		AlwaysRelevantNode->NotifyRemoveNetworkActor(ActorInfo);
+		break;
+	case EParkourRepRouting::SpatializeStatic:
+		GridNode->RemoveActor_Static(ActorInfo);
+		break;
+	case EParkourRepRouting::SpatializeDynamic:
+		GridNode->RemoveActor_Dynamic(ActorInfo);
+		break;
+	case EParkourRepRouting::SpatializeDormancy:
+		GridNode->RemoveActor_Dormancy(ActorInfo);
+		break;
+	default:
+		break;
+	}
+}
+
+/// <summary>
+/// Finds the node an actor class goes to from its class defaults, and remembers it for the
+/// next actor of the class
+/// </summary>
+/// <param name="Class">the actor class</param>
+/// <returns>the node the class goes to</returns>
+EParkourRepRouting UParkourReplicationGraph::GetRouting(UClass* Class)
+{
+	if (const EParkourRepRouting* routing = ClassRouting.Find(Class))
+		return *routing;
+
+	const AActor* defaults = Class->GetDefaultObject<AActor>();
+	EParkourRepRouting routing;
+	//Controllers and anything else only their owner sees
+	if (defaults->bOnlyRelevantToOwner)
+		routing = EParkourRepRouting::NotRouted;
+	//Game state, player states and other actors everyone needs
+	else if (defaults->bAlwaysRelevant || Class->IsChildOf(AInfo::StaticClass()))
+		routing = EParkourRepRouting::AlwaysRelevant;
+	//Characters and anything else that moves
+	else if (Class->IsChildOf(APawn::StaticClass()) || defaults->IsReplicatingMovement())
+		routing = EParkourRepRouting::SpatializeDynamic;
+	else if (defaults->NetDormancy > DORM_Awake)
+		routing = EParkourRepRouting::SpatializeDormancy;
+	else
+		routing = EParkourRepRouting::SpatializeStatic;
+
+	ClassRouting.Add(Class, routing);
+	return routing;
+}
+
+/// <summary>
+/// Sets the replication period and cull distance of a class from its class defaults
+/// </summary>
+/// <param name="Class">the actor class</param>
+void UParkourReplicationGraph::InitClassSettings(UClass* Class)
+{
+	const AActor* defaults = Class->GetDefaultObject<AActor>();
+
+	FClassReplicationInfo classInfo;
+	classInfo.ReplicationPeriodFrame = GetReplicationPeriodFrameForFrequency(FMath::Max(defaults->NetUpdateFrequency, 0.1f));
+	//Actors outside the grid are relevant at any distance
+	const EParkourRepRouting routing = GetRouting(Class);
+	if (routing != EParkourRepRouting::NotRouted && routing != EParkourRepRouting::AlwaysRelevant)
+		classInfo.SetCullDistanceSquared(defaults->NetCullDistanceSquared);
+
+	GlobalActorReplicationInfoMap.SetClassInfo(Class, classInfo);
+}
+
+/// <summary>
+/// Logs the bandwidth of every client connection and how many characters replicate at each
+/// net update rate. Used with "stat Net" on the server, which has the server's net tick time,
+/// to compare lobbies with and without the replication graph and adaptive net update rates
+/// </summary>
+/// <param name="World">the server world</param>
+static void LogNetReport(UWorld* World)
+{
+	UNetDriver* netDriver = World->GetNetDriver();
+	if (!netDriver || !netDriver->IsServer())
+	{
+		UE_LOG(LogParkour, Warning, TEXT("parkour.NetReport has to run on the server"));
+		return;
+	}
+
+	UE_LOG(LogParkour, Log, TEXT("Replication driver: %s"), netDriver->GetReplicationDriver() ? *netDriver->GetReplicationDriver()->GetClass()->GetName() : TEXT("none"));
+
+	int64 totalOutBytes = 0;
+	for (UNetConnection* connection : netDriver->ClientConnections)
+	{
+		if (!connection)
+			continue;
+
+		totalOutBytes += connection->OutBytesPerSecond;
+		UE_LOG(LogParkour, Log, TEXT("  %s: out %.1f KB/s, in %.1f KB/s, ping %.0f ms"),
+			connection->PlayerController ? *connection->PlayerController->GetName() : *connection->LowLevelGetRemoteAddress(true),
+			connection->OutBytesPerSecond / 1024.0f, connection->InBytesPerSecond / 1024.0f, connection->AvgLag * 1000.0f);
+	}
+	if (netDriver->ClientConnections.Num() > 0)
+		UE_LOG(LogParkour, Log, TEXT("%d clients, %.1f KB/s out per client"), netDriver->ClientConnections.Num(), totalOutBytes / 1024.0f / netDriver->ClientConnections.Num());
+
+	TMap<float, int32> charactersByRate;
+	for (TActorIterator<ATestComplexSystemCharacter> It(World); It; ++It)
+		charactersByRate.FindOrAdd(It->NetUpdateFrequency)++;
+	charactersByRate.KeySort([](float A, float B) { return A > B; });
+	for (const TPair<float, int32>& rate : charactersByRate)
+		UE_LOG(LogParkour, Log, TEXT("  %d characters at %.0f Hz"), rate.Value, rate.Key);
+}
+
+static FAutoConsoleCommandWithWorld ParkourNetReportCommand(
+	TEXT("parkour.NetReport"),
+	TEXT("Logs the bandwidth of every client and how many characters replicate at each net update rate. Run on the server."),
+	FConsoleCommandWithWorldDelegate::CreateStatic(&LogNetReport));
@@ -0,0 +1,82 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ReplicationGraph.h"
+#include "ParkourReplicationGraph.generated.h"
+
+class UReplicationGraphNode_ActorList;
+class UReplicationGraphNode_GridSpatialization2D;
+
+//Which node of the graph an actor class goes to
+enum class EParkourRepRouting : uint8
+{
+	//Only relevant to its owner, picked up by the connection's own node
+	NotRouted,
+	//Relevant to every connection
+	AlwaysRelevant,
+	//Put in a grid cell once and left there
+	SpatializeStatic,
+	//Moved between grid cells every frame
+	SpatializeDynamic,
+	//Put in a grid cell, and moved while awake
+	SpatializeDormancy
+};
+
+/**
+ * Replication graph for big parkour lobbies. Characters and other moving actors are kept
+ * in a 2D grid of cells and each connection only gathers the cells around its viewer, so
+ * the server doesn't check every actor against every connection each frame. Game state,
+ * player states and other always relevant actors go in one list shared by every
+ * connection. The graph also takes the net update rate characters set for themselves as
+ * they start and stop parkour moves.
+ * Enabled through ReplicationDriverClassName in DefaultEngine.ini.
+ */
+UCLASS(transient, config=Game)
+class UParkourReplicationGraph : public UReplicationGraph
+{
+	GENERATED_BODY()
+
+public:
+	UParkourReplicationGraph();
+
+	/** Returns the parkour replication graph of a world, or null if it isn't the world's replication driver */
+	static UParkourReplicationGraph* Get(const UWorld* World);
+
+	/** Picks up a new NetUpdateFrequency on an actor already in the graph */
+	void UpdateActorNetUpdateFrequency(AActor* Actor);
+
+	// UReplicationGraph interface
+	virtual void ResetGameWorldState() override;
+	virtual void InitGlobalActorClassSettings() override;
+	virtual void InitGlobalGraphNodes() override;
+	virtual void InitConnectionGraphNodes(UNetReplicationGraphConnection* RepGraphConnection) override;
+	virtual void RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo) override;
+	virtual void RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo) override;
+	// End of UReplicationGraph interface
+
+	/** Size of a grid cell, connections gather their own cell and the cells their cull distance reaches */
+	UPROPERTY(config, EditAnywhere, Category = Parkour)
+	float GridCellSize;
+
+	/** Corner of the grid, everything in the level should be above and right of it */
+	UPROPERTY(config, EditAnywhere, Category = Parkour)
+	FVector2D SpatialBias;
+
+private:
+	/** Finds the node an actor class goes to, from its class defaults */
+	EParkourRepRouting GetRouting(UClass* Class);
+
+	/** Sets the replication settings of a class from its class defaults */
+	void InitClassSettings(UClass* Class);
+
+	UPROPERTY()
+	UReplicationGraphNode_GridSpatialization2D* GridNode;
+
+	UPROPERTY()
+	UReplicationGraphNode_ActorList* AlwaysRelevantNode;
+
+	/** Routing of each class seen so far */
+	TMap<UClass*, EParkourRepRouting> ClassRouting;
+};
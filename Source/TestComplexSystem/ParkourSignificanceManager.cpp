@@ -0,0 +1,182 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ParkourSignificanceManager.h"
+#include "TestComplexSystemCharacter.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+
+static const FName ParkourCharacterTag(TEXT("ParkourCharacter"));
+
+UParkourSignificanceManager::UParkourSignificanceManager()
+{
+	MediumDistance = 2500.0f;
+	FarDistance = 6000.0f;
+	CullDistance = 12000.0f;
+	UpdateInterval = 0.2f;
+
+	MediumTickInterval = 1.0f / 30.0f;
+	FarTickInterval = 0.1f;
+	CulledTickInterval = 0.25f;
+
+	MediumProbeInterval = 2;
+	FarProbeInterval = 4;
+
+	TimeSinceUpdate = 0.0f;
+}
+
+/// <summary>
+/// Gets the parkour significance manager for the world
+/// </summary>
+/// <param name="World">the world to get the manager for</param>
+/// <returns>the manager, or null if another significance manager class is configured</returns>
+UParkourSignificanceManager* UParkourSignificanceManager::Get(const UWorld* World)
+{
+	return Cast<UParkourSignificanceManager>(USignificanceManager::Get(World));
+}
+
+/// <summary>
+/// Registers a character so it gets sorted into a significance tier on the next update
+/// </summary>
+/// <param name="Character">the character to register</param>
+void UParkourSignificanceManager::RegisterCharacter(ATestComplexSystemCharacter* Character)
+{
+	RegisterObject(Character, ParkourCharacterTag,
+		[this](FManagedObjectInfo* ObjectInfo, const FTransform& Viewpoint) { return CalculateSignificance(ObjectInfo, Viewpoint); },
+		EPostSignificanceType::Sequential,
+		[this](FManagedObjectInfo* ObjectInfo, float OldSignificance, float Significance, bool bFinal) { PostSignificanceUpdate(ObjectInfo, OldSignificance, Significance, bFinal); });
+}
+
+/// <summary>
+/// Unregisters a character and sets it back to full rate
+/// </summary>
+/// <param name="Character">the character to unregister</param>
+void UParkourSignificanceManager::UnregisterCharacter(ATestComplexSystemCharacter* Character)
+{
+	UnregisterObject(Character);
+	Character->SetParkourSignificance(EParkourSignificance::Full);
+}
+
+float UParkourSignificanceManager::GetTickInterval(EParkourSignificance Significance) const
+{
+	switch (Significance)
+	{
+	case EParkourSignificance::Medium:
+		return MediumTickInterval;
+	case EParkourSignificance::Far:
+		return FarTickInterval;
+	case EParkourSignificance::Culled:
+		return CulledTickInterval;
+	default:
+		return 0.0f;
+	}
+}
+
+int32 UParkourSignificanceManager::GetProbeInterval(EParkourSignificance Significance) const
+{
+	switch (Significance)
+	{
+	case EParkourSignificance::Medium:
+		return MediumProbeInterval;
+	case EParkourSignificance::Far:
+		return FarProbeInterval;
+	case EParkourSignificance::Culled:
+		return 0;
+	default:
+		return 1;
+	}
+}
+
+/// <summary>
+/// Works out the significance tier of a character from a single viewpoint. The
+/// manager keeps the highest tier out of all the viewpoints
+/// </summary>
+/// <param name="ObjectInfo">the registered character</param>
+/// <param name="Viewpoint">the viewpoint of a player</param>
+/// <returns>the tier as a float</returns>
+float UParkourSignificanceManager::CalculateSignificance(FManagedObjectInfo* ObjectInfo, const FTransform& Viewpoint) const
+{
+	ATestComplexSystemCharacter* character = CastChecked<ATestComplexSystemCharacter>(ObjectInfo->GetObject());
+
+	//Characters controlled by a local player always run at full rate
+	if (character->IsLocallyControlled() && character->IsPlayerControlled())
+		return (float)EParkourSignificance::Full;
+
+	float distanceSquared = FVector::DistSquared(character->GetActorLocation(), Viewpoint.GetLocation());
+
+	EParkourSignificance significance = EParkourSignificance::Full;
+	if (distanceSquared > FMath::Square(CullDistance))
+		significance = EParkourSignificance::Culled;
+	else if (distanceSquared > FMath::Square(FarDistance))
+		significance = EParkourSignificance::Far;
+	else if (distanceSquared > FMath::Square(MediumDistance))
+		significance = EParkourSignificance::Medium;
+
+	//Characters that haven't been rendered recently drop a tier. Nothing is rendered
+	//on a dedicated server so only distance is used there
+	if (significance > EParkourSignificance::Culled && !IsRunningDedicatedServer() && !character->WasRecentlyRendered(0.2f))
+		significance = (EParkourSignificance)((uint8)significance - 1);
+
+	return (float)significance;
+}
+
+/// <summary>
+/// Hands the final significance tier to the character
+/// </summary>
+void UParkourSignificanceManager::PostSignificanceUpdate(FManagedObjectInfo* ObjectInfo, float OldSignificance, float Significance, bool bFinal)
+{
+	if (!bFinal || OldSignificance == Significance)
+		return;
+
+	ATestComplexSystemCharacter* character = CastChecked<ATestComplexSystemCharacter>(ObjectInfo->GetObject());
+	character->SetParkourSignificance((EParkourSignificance)FMath::RoundToInt(Significance));
+}
+
+/// <summary>
+/// Updates the significance of every registered character from the viewpoints of the
+/// player controllers. On clients these are the local players, on a server they are
+/// every connected player
+/// </summary>
+/// <param name="DeltaTime">time since the last tick</param>
+void UParkourSignificanceManager::Tick(float DeltaTime)
+{
+	TimeSinceUpdate += DeltaTime;
+	if (TimeSinceUpdate < UpdateInterval)
+		return;
+	TimeSinceUpdate = 0.0f;
+
+	Viewpoints.Reset();
+	for (FConstPlayerControllerIterator iterator = GetWorld()->GetPlayerControllerIterator(); iterator; ++iterator)
+	{
+		APlayerController* playerController = iterator->Get();
+		if (!playerController)
+			continue;
+
+		FVector location;
+		FRotator rotation;
+		playerController->GetPlayerViewPoint(location, rotation);
+		Viewpoints.Emplace(rotation, location);
+	}
+
+	Update(Viewpoints);
+}
+
+ETickableTickType UParkourSignificanceManager::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+bool UParkourSignificanceManager::IsTickable() const
+{
+	return GetWorld() != nullptr && !IsPendingKill();
+}
+
+TStatId UParkourSignificanceManager::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UParkourSignificanceManager, STATGROUP_Tickables);
+}
+
+UWorld* UParkourSignificanceManager::GetTickableGameObjectWorld() const
+{
+	return GetWorld();
+}
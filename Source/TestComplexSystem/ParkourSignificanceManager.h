@@ -0,0 +1,91 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "SignificanceManager.h"
+#include "Tickable.h"
+#include "ParkourTypes.h"
+#include "ParkourSignificanceManager.generated.h"
+
+class ATestComplexSystemCharacter;
+
+/**
+ * Sorts parkour characters into significance tiers by their distance to the viewers and
+ * whether they were rendered recently. Lower tiers tick less often and probe for walls
+ * less often, and culled characters don't probe at all.
+ * Enabled through SignificanceManagerClassName in DefaultEngine.ini.
+ */
+UCLASS(config=Game)
+class UParkourSignificanceManager : public USignificanceManager, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	UParkourSignificanceManager();
+
+	/** Returns the parkour significance manager for a world, or null if it isn't the configured significance manager */
+	static UParkourSignificanceManager* Get(const UWorld* World);
+
+	/** Adds a character to be sorted into significance tiers */
+	void RegisterCharacter(ATestComplexSystemCharacter* Character);
+
+	/** Removes a character and puts it back to full rate */
+	void UnregisterCharacter(ATestComplexSystemCharacter* Character);
+
+	/** Returns the actor tick interval for a significance tier */
+	float GetTickInterval(EParkourSignificance Significance) const;
+
+	/** Returns how many ticks apart wall probes are for a significance tier, 0 means never probe */
+	int32 GetProbeInterval(EParkourSignificance Significance) const;
+
+	// FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override;
+	// End of FTickableGameObject interface
+
+	/** Characters further than this from every viewer drop to the medium tier */
+	UPROPERTY(config, EditAnywhere, Category = Parkour)
+	float MediumDistance;
+
+	/** Characters further than this from every viewer drop to the far tier */
+	UPROPERTY(config, EditAnywhere, Category = Parkour)
+	float FarDistance;
+
+	/** Characters further than this from every viewer stop probing for walls */
+	UPROPERTY(config, EditAnywhere, Category = Parkour)
+	float CullDistance;
+
+	/** Seconds between significance updates */
+	UPROPERTY(config, EditAnywhere, Category = Parkour)
+	float UpdateInterval;
+
+	/** Actor tick interval for the medium, far and culled tiers */
+	UPROPERTY(config, EditAnywhere, Category = Parkour)
+	float MediumTickInterval;
+	UPROPERTY(config, EditAnywhere, Category = Parkour)
+	float FarTickInterval;
+	UPROPERTY(config, EditAnywhere, Category = Parkour)
+	float CulledTickInterval;
+
+	/** Ticks between wall probes for the medium and far tiers */
+	UPROPERTY(config, EditAnywhere, Category = Parkour)
+	int32 MediumProbeInterval;
+	UPROPERTY(config, EditAnywhere, Category = Parkour)
+	int32 FarProbeInterval;
+
+private:
+	/** Works out the tier of a character from one viewpoint */
+	float CalculateSignificance(FManagedObjectInfo* ObjectInfo, const FTransform& Viewpoint) const;
+
+	/** Hands the new tier to the character once all the viewpoints have been checked */
+	void PostSignificanceUpdate(FManagedObjectInfo* ObjectInfo, float OldSignificance, float Significance, bool bFinal);
+
+	/** Viewpoints of the player controllers, reused every update */
+	TArray<FTransform> Viewpoints;
+
+	float TimeSinceUpdate;
+};
@@ -0,0 +1,35 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ParkourStats.h"
+
+DEFINE_STAT(STAT_ParkourTraces);
+DEFINE_STAT(STAT_ParkourWallRunners);
+DEFINE_STAT(STAT_ParkourVaults);
+DEFINE_STAT(STAT_ParkourClimbs);
+
+#if PARKOUR_PROFILING
+
+UE_TRACE_CHANNEL_DEFINE(ParkourChannel);
+
+CSV_DEFINE_CATEGORY(Parkour, true);
+
+TAtomic<uint32> GParkourTraceCount(0);
+
+/// <summary>
+/// Writes how many parkour traces were made this frame. The traces are counted from any
+/// thread as they are made, so this works out the frame's share once the frame is over
+/// </summary>
+void FParkourFrameStats::OnEndFrame()
+{
+	static uint32 LastTraceCount = 0;
+
+	const uint32 traceCount = GParkourTraceCount;
+	const uint32 frameTraces = traceCount - LastTraceCount;
+	LastTraceCount = traceCount;
+
+	SET_DWORD_STAT(STAT_ParkourTraces, frameTraces);
+	CSV_CUSTOM_STAT(Parkour, Traces, (int32)frameTraces, ECsvCustomStatOp::Set);
+}
+
+#endif
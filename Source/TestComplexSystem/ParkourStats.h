@@ -0,0 +1,66 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "Templates/Atomic.h"
+
+//Parkour profiling is compiled out of shipping builds so it costs nothing in production
+#ifndef PARKOUR_PROFILING
+#define PARKOUR_PROFILING !UE_BUILD_SHIPPING
+#endif
+
+#if PARKOUR_PROFILING
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "Trace/Trace.h"
+#endif
+
+//All parkour stats show up under "stat Parkour"
+DECLARE_STATS_GROUP(TEXT("Parkour"), STATGROUP_Parkour, STATCAT_Advanced);
+
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Traces"), STAT_ParkourTraces, STATGROUP_Parkour, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Wall Runners"), STAT_ParkourWallRunners, STATGROUP_Parkour, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Vaults Started"), STAT_ParkourVaults, STATGROUP_Parkour, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Climbs Started"), STAT_ParkourClimbs, STATGROUP_Parkour, );
+
+#if PARKOUR_PROFILING
+
+//Parkour scopes show up in Unreal Insights when tracing with -trace=cpu,parkour
+UE_TRACE_CHANNEL_EXTERN(ParkourChannel);
+
+//The parkour counters are written to the "Parkour" category of the CSV profiler
+CSV_DECLARE_CATEGORY_EXTERN(Parkour);
+
+//Every line trace made by the parkour characters and the shared ledge probes, from any
+//thread. Read by parkour.Bench to report how many traces each parkour check costs, and
+//written to the stats and the CSV profiler once a frame
+extern TAtomic<uint32> GParkourTraceCount;
+
+//Times a parkour function in "stat Parkour" and names it in Unreal Insights. Needs a cycle
+//stat called STAT_Parkour<Name>
+#define PARKOUR_SCOPE(Name) \
+	SCOPE_CYCLE_COUNTER(STAT_Parkour##Name); \
+	TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL(Parkour##Name, ParkourChannel)
+
+#define PARKOUR_COUNT_TRACES(Count) GParkourTraceCount += (Count)
+
+//Adds to a parkour counter for this frame in the stats and the CSV profiler
+#define PARKOUR_COUNT(Name, Count) \
+	INC_DWORD_STAT_BY(STAT_Parkour##Name, Count); \
+	CSV_CUSTOM_STAT(Parkour, Name, (int32)(Count), ECsvCustomStatOp::Accumulate)
+
+/** Writes the once a frame parkour counters, bound to the end of every frame by the game module */
+struct FParkourFrameStats
+{
+	static void OnEndFrame();
+};
+
+#else
+
+#define PARKOUR_SCOPE(Name)
+#define PARKOUR_COUNT_TRACES(Count)
+#define PARKOUR_COUNT(Name, Count)
+
+#endif
@@ -0,0 +1,86 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ParkourSurfaceSubsystem.h"
+#include "ParkourPhysicalMaterial.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/Level.h"
+#include "EngineUtils.h"
+
+static const FName NoWallrunTag(TEXT("NoWallrun"));
+
+void UParkourSurfaceSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	UWorld* world = GetWorld();
+	if (!world->IsGameWorld())
+		return;
+
+	ActorsInitializedHandle = FWorldDelegates::OnWorldInitializedActors.AddUObject(this, &UParkourSurfaceSubsystem::OnWorldInitializedActors);
+	LevelAddedHandle = FWorldDelegates::LevelAddedToWorld.AddUObject(this, &UParkourSurfaceSubsystem::OnLevelAddedToWorld);
+	ActorSpawnedHandle = world->AddOnActorSpawnedHandler(FOnActorSpawned::FDelegate::CreateUObject(this, &UParkourSurfaceSubsystem::OnActorSpawned));
+}
+
+void UParkourSurfaceSubsystem::Deinitialize()
+{
+	FWorldDelegates::OnWorldInitializedActors.Remove(ActorsInitializedHandle);
+	FWorldDelegates::LevelAddedToWorld.Remove(LevelAddedHandle);
+	if (ActorSpawnedHandle.IsValid())
+		GetWorld()->RemoveOnActorSpawnedHandler(ActorSpawnedHandle);
+
+	Super::Deinitialize();
+}
+
+/// <summary>
+/// Puts the NoWallrun material on the components of an actor tagged NoWallrun, or on its
+/// components tagged NoWallrun. Components that already have a parkour physical material
+/// keep it, it was set on purpose
+/// </summary>
+/// <param name="Actor">the actor to look at</param>
+void UParkourSurfaceSubsystem::ApplySurfaceTags(AActor* Actor)
+{
+	if (!Actor)
+		return;
+
+	const bool bActorTagged = Actor->ActorHasTag(NoWallrunTag);
+	TInlineComponentArray<UPrimitiveComponent*> components(Actor);
+	for (UPrimitiveComponent* component : components)
+	{
+		if (!bActorTagged && !component->ComponentHasTag(NoWallrunTag))
+			continue;
+
+		if (Cast<UParkourPhysicalMaterial>(component->BodyInstance.GetSimplePhysicalMaterial()))
+			continue;
+
+		component->SetPhysMaterialOverride(UParkourPhysicalMaterial::GetNoWallrunMaterial());
+
+		//Instances have their own bodies, made from the component's body when the physics state is created
+		if (component->IsA<UInstancedStaticMeshComponent>() && component->IsPhysicsStateCreated())
+			component->RecreatePhysicsState();
+	}
+}
+
+void UParkourSurfaceSubsystem::OnWorldInitializedActors(const UWorld::FActorsInitializedParams& Params)
+{
+	if (Params.World != GetWorld())
+		return;
+
+	for (TActorIterator<AActor> It(Params.World); It; ++It)
+		ApplySurfaceTags(*It);
+}
+
+void UParkourSurfaceSubsystem::OnLevelAddedToWorld(ULevel* Level, UWorld* World)
+{
+	if (World != GetWorld() || !Level)
+		return;
+
+	for (AActor* actor : Level->Actors)
+		ApplySurfaceTags(actor);
+}
+
+void UParkourSurfaceSubsystem::OnActorSpawned(AActor* Actor)
+{
+	ApplySurfaceTags(Actor);
+}
@@ -0,0 +1,41 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Engine/World.h"
+#include "ParkourSurfaceSubsystem.generated.h"
+
+class ULevel;
+
+/**
+ * Turns the NoWallrun tags of the level into parkour physical materials as actors are
+ * loaded or spawned, so the wall run probes read the surface off the hit instead of
+ * searching tags every probe. Actors tagged NoWallrun have it put on every component,
+ * and components tagged NoWallrun, like the instanced walls of a parkour course, on
+ * just that component. Tags added after an actor is spawned aren't picked up.
+ */
+UCLASS()
+class UParkourSurfaceSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// USubsystem interface
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	// End of USubsystem interface
+
+	/** Puts the NoWallrun material on the tagged components of an actor */
+	static void ApplySurfaceTags(AActor* Actor);
+
+private:
+	void OnWorldInitializedActors(const UWorld::FActorsInitializedParams& Params);
+	void OnLevelAddedToWorld(ULevel* Level, UWorld* World);
+	void OnActorSpawned(AActor* Actor);
+
+	FDelegateHandle ActorsInitializedHandle;
+	FDelegateHandle LevelAddedHandle;
+	FDelegateHandle ActorSpawnedHandle;
+};
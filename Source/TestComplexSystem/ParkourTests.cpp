@@ -0,0 +1,392 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "ParkourLedgeCache.h"
+#include "ParkourLedgeProbe.h"
+#include "ParkourPhysicalMaterial.h"
+#include "ParkourRecording.h"
+#include "ParkourSurfaceSubsystem.h"
+#include "ParkourTypes.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/Engine.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/StaticMeshActor.h"
+#include "Engine/World.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+//The parkour tests run anywhere the game runs, under Automation RunTests TestComplexSystem.Parkour
+static const uint32 ParkourTestFlags = EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter;
+
+//The forward probe of the tests starts here and looks along +X, test walls have their face within its reach
+static const FVector TestProbeStart(0.0f, 0.0f, 20.0f);
+static const float TestWallFaceX = 50.0f;
+
+/**
+ * A game world with its own physics scene for the tests to build walls in, destroyed when
+ * the test is done with it
+ */
+class FParkourTestWorld
+{
+public:
+	FParkourTestWorld()
+	{
+		World = UWorld::CreateWorld(EWorldType::Game, false);
+		FWorldContext& worldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+		worldContext.SetCurrentWorld(World);
+		World->InitializeActorsForPlay(FURL());
+		World->BeginPlay();
+
+		Cube = LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Cube.Cube"));
+	}
+
+	~FParkourTestWorld()
+	{
+		GEngine->DestroyWorldContext(World);
+		World->DestroyWorld(false);
+	}
+
+	/** Spawns a movable box made from the engine cube, which is 100 units on each side */
+	AStaticMeshActor* SpawnBox(const FVector& Center, const FVector& Size)
+	{
+		AStaticMeshActor* box = World->SpawnActor<AStaticMeshActor>(Center, FRotator::ZeroRotator);
+		if (!box)
+			return nullptr;
+
+		UStaticMeshComponent* mesh = box->GetStaticMeshComponent();
+		mesh->SetMobility(EComponentMobility::Movable);
+		mesh->SetStaticMesh(Cube);
+		box->SetActorScale3D(Size / 100.0f);
+		return box;
+	}
+
+	/** Spawns a wall standing on z = 0 with its face across the forward probe of the tests */
+	AStaticMeshActor* SpawnWall(float Height, float Thickness)
+	{
+		return SpawnBox(FVector(TestWallFaceX + Thickness * 0.5f, 0.0f, Height * 0.5f), FVector(Thickness, 400.0f, Height));
+	}
+
+	UWorld* World;
+	UStaticMesh* Cube;
+};
+
+/// <summary>
+/// Makes the query params the character's climb check uses
+/// </summary>
+static FCollisionQueryParams MakeProbeParams()
+{
+	FCollisionQueryParams params(SCENE_QUERY_STAT(ParkourTestTrace));
+	params.bReturnPhysicalMaterial = true;
+	return params;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Ledge classification
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FParkourLedgeClassifyTest, "TestComplexSystem.Parkour.LedgeProbe.Classify", ParkourTestFlags)
+
+/// <summary>
+/// Walls with their far edge in reach are vaulted, walls without it are climbed
+/// </summary>
+bool FParkourLedgeClassifyTest::RunTest(const FString& Parameters)
+{
+	FParkourLedge ledge;
+	ledge.WallLocation = FVector(0.0f, 0.0f, 20.0f);
+	ledge.WallHeight = FVector(-10.0f, 0.0f, 100.0f);
+
+	ledge.Thickness = 20.0f;
+	FParkourLedgeProbe::Classify(ledge);
+	TestEqual(TEXT("Height is measured from the wall location"), ledge.Height, 80.0f);
+	TestTrue(TEXT("A thin wall has its far edge in reach"), ledge.bHasFarEdge);
+	TestTrue(TEXT("A thin wall is vaulted"), ledge.Action == EParkourLedgeAction::Vault);
+
+	ledge.Thickness = FParkourLedgeProbe::ThicknessProbeDepth;
+	FParkourLedgeProbe::Classify(ledge);
+	TestFalse(TEXT("A wall as thick as the probe reaches has no far edge"), ledge.bHasFarEdge);
+	TestTrue(TEXT("A thick wall is climbed"), ledge.Action == EParkourLedgeAction::Climb);
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FParkourLedgeProbeTest, "TestComplexSystem.Parkour.LedgeProbe.Trace", ParkourTestFlags)
+
+/// <summary>
+/// Runs the ledge probe at walls of different heights and thicknesses and checks what it makes of them
+/// </summary>
+bool FParkourLedgeProbeTest::RunTest(const FString& Parameters)
+{
+	FParkourTestWorld testWorld;
+	if (!TestNotNull(TEXT("Engine cube"), testWorld.Cube))
+		return false;
+
+	const FCollisionQueryParams params = MakeProbeParams();
+
+	//Runs the probe at one wall, removing the wall afterwards so the next one is alone
+	auto probeWall = [&](float height, float thickness, FParkourLedge& ledge)
+	{
+		AStaticMeshActor* wall = testWorld.SpawnWall(height, thickness);
+		const bool hasLedge = FParkourLedgeProbe::Trace(testWorld.World, TestProbeStart, FVector::ForwardVector, params, ledge);
+		if (wall)
+			wall->Destroy();
+		return hasLedge;
+	};
+
+	FParkourLedge ledge;
+	TestFalse(TEXT("Nothing in front has no ledge"), FParkourLedgeProbe::Trace(testWorld.World, TestProbeStart, FVector::ForwardVector, params, ledge));
+
+	TestFalse(TEXT("A wall below the forward probe has no ledge"), probeWall(10.0f, 20.0f, ledge));
+
+	if (TestTrue(TEXT("A low thin wall has a ledge"), probeWall(80.0f, 20.0f, ledge)))
+	{
+		TestTrue(TEXT("A low thin wall is vaulted"), ledge.Action == EParkourLedgeAction::Vault);
+		TestEqual(TEXT("Low thin wall thickness"), ledge.Thickness, 20.0f, 1.0f);
+		TestEqual(TEXT("Low thin wall height"), ledge.Height, 80.0f - TestProbeStart.Z, 1.0f);
+		TestTrue(TEXT("A low wall is low enough to vault without climbing"), ledge.Height <= FParkourLedgeProbe::ClimbHeight);
+	}
+
+	if (TestTrue(TEXT("A low thick wall has a ledge"), probeWall(80.0f, 200.0f, ledge)))
+	{
+		TestTrue(TEXT("A low thick wall is climbed"), ledge.Action == EParkourLedgeAction::Climb);
+		TestEqual(TEXT("Low thick wall thickness"), ledge.Thickness, FParkourLedgeProbe::ThicknessProbeDepth);
+	}
+
+	if (TestTrue(TEXT("A high thin wall has a ledge"), probeWall(150.0f, 20.0f, ledge)))
+	{
+		TestTrue(TEXT("A high thin wall is vaulted"), ledge.Action == EParkourLedgeAction::Vault);
+		TestTrue(TEXT("A high wall is too high to vault without climbing"), ledge.Height > FParkourLedgeProbe::ClimbHeight);
+	}
+
+	TestFalse(TEXT("A wall taller than the top probe reaches has no ledge"), probeWall(400.0f, 200.0f, ledge));
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Ledge cache
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FParkourLedgeCacheTest, "TestComplexSystem.Parkour.LedgeCache", ParkourTestFlags)
+
+/// <summary>
+/// Checks the cache gives back what the top probe found, drops it once the wall moves, and
+/// evicts the walls that weren't run at again when it fills up
+/// </summary>
+bool FParkourLedgeCacheTest::RunTest(const FString& Parameters)
+{
+	FParkourTestWorld testWorld;
+	if (!TestNotNull(TEXT("Engine cube"), testWorld.Cube))
+		return false;
+
+	const FCollisionQueryParams params = MakeProbeParams();
+	AStaticMeshActor* wall = testWorld.SpawnWall(80.0f, 20.0f);
+
+	FHitResult wallHit;
+	FParkourLedge tracedLedge;
+	if (!TestTrue(TEXT("The forward probe hits the wall"), FParkourLedgeProbe::TraceWall(testWorld.World, TestProbeStart, FVector::ForwardVector, params, wallHit))
+		|| !TestTrue(TEXT("The top probe finds the ledge"), FParkourLedgeProbe::TraceTop(testWorld.World, wallHit, params, tracedLedge)))
+		return false;
+
+	FParkourLedgeCache cache;
+	FParkourLedge cachedLedge;
+	bool hasLedge = false;
+	TestFalse(TEXT("An empty cache misses"), cache.Find(wallHit, cachedLedge, hasLedge));
+
+	cache.Add(wallHit, &tracedLedge);
+	if (TestTrue(TEXT("The wall is found after it is added"), cache.Find(wallHit, cachedLedge, hasLedge)))
+	{
+		TestTrue(TEXT("The cached wall has a ledge"), hasLedge);
+		TestTrue(TEXT("The cached ledge has the traced action"), cachedLedge.Action == tracedLedge.Action);
+		TestEqual(TEXT("The cached ledge has the traced height"), cachedLedge.Height, tracedLedge.Height, KINDA_SMALL_NUMBER);
+		TestEqual(TEXT("The cached ledge has the traced thickness"), cachedLedge.Thickness, tracedLedge.Thickness, KINDA_SMALL_NUMBER);
+	}
+	TestEqual(TEXT("The hit is counted"), (int64)cache.GetHits(), (int64)1);
+	TestEqual(TEXT("The miss is counted"), (int64)cache.GetMisses(), (int64)1);
+
+	//Moving the wall makes what was found on it out of date
+	wall->SetActorLocation(wall->GetActorLocation() + FVector(0.0f, 0.0f, 30.0f));
+	TestFalse(TEXT("A wall that has moved misses"), cache.Find(wallHit, cachedLedge, hasLedge));
+	TestEqual(TEXT("The entry of a wall that has moved is dropped"), cache.Num(), 0);
+
+	//Walls the top probe found nothing on are remembered too
+	cache.Add(wallHit, nullptr);
+	TestTrue(TEXT("A wall with no ledge is found"), cache.Find(wallHit, cachedLedge, hasLedge));
+	TestFalse(TEXT("A wall with no ledge has no ledge"), hasLedge);
+	TestTrue(TEXT("A wall with no ledge has no action"), cachedLedge.Action == EParkourLedgeAction::None);
+
+	FHitResult noComponentHit = wallHit;
+	noComponentHit.Component = nullptr;
+	TestFalse(TEXT("A hit with no component misses"), cache.Find(noComponentHit, cachedLedge, hasLedge));
+
+	cache.RemoveLevel(wall->GetLevel());
+	TestEqual(TEXT("The entries of a removed level are dropped"), cache.Num(), 0);
+
+	//Filling the cache drops the walls nobody ran at again, and keeps the ones that were
+	const uint64 hitsBeforeFilling = cache.GetHits();
+	auto makeHit = [&wallHit](int32 index)
+	{
+		FHitResult hit = wallHit;
+		hit.Location.Y += (index + 1) * FParkourLedgeCache::CellSize;
+		return hit;
+	};
+	cache.Add(wallHit, &tracedLedge);
+	cache.Add(makeHit(0), &tracedLedge);
+	for (int32 i = 1; i <= FParkourLedgeCache::MaxEntries / 2; ++i)
+		cache.Add(makeHit(i), &tracedLedge);
+	TestTrue(TEXT("A wall from the last generation is still found"), cache.Find(wallHit, cachedLedge, hasLedge));
+	for (int32 i = FParkourLedgeCache::MaxEntries / 2 + 1; i <= FParkourLedgeCache::MaxEntries; ++i)
+		cache.Add(makeHit(i), &tracedLedge);
+	TestTrue(TEXT("A wall found again outlives the next eviction"), cache.Find(wallHit, cachedLedge, hasLedge));
+	TestFalse(TEXT("A wall not found again is evicted"), cache.Find(makeHit(0), cachedLedge, hasLedge));
+	TestTrue(TEXT("The cache stays within its size"), cache.Num() <= FParkourLedgeCache::MaxEntries);
+	TestTrue(TEXT("Evictions are counted"), cache.GetEvictions() > 0);
+	TestEqual(TEXT("Evicting keeps the hit count"), (int64)cache.GetHits(), (int64)hitsBeforeFilling + 2);
+
+	cache.Empty();
+	TestEqual(TEXT("Emptying drops every entry"), cache.Num(), 0);
+	TestEqual(TEXT("Emptying resets the hits"), (int64)cache.GetHits(), (int64)0);
+	TestEqual(TEXT("Emptying resets the misses"), (int64)cache.GetMisses(), (int64)0);
+	TestEqual(TEXT("Emptying resets the evictions"), (int64)cache.GetEvictions(), (int64)0);
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Recordings
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FParkourRecordingTest, "TestComplexSystem.Parkour.Recording", ParkourTestFlags)
+
+/// <summary>
+/// Writes a recording, reads it back and checks the samples and actions survive within the quantization
+/// </summary>
+bool FParkourRecordingTest::RunTest(const FString& Parameters)
+{
+	const float positionStep = 2.0f;
+	FParkourRecordingWriter writer(30, positionStep);
+
+	const FVector origin(1000.0f, -2000.0f, 300.0f);
+	const int32 numSamples = 90;
+	auto getLocation = [&](int32 sample) { return origin + FVector(sample * 17.3f, sample * -4.1f, FMath::Sin(sample * 0.2f) * 100.0f); };
+	auto getYaw = [](int32 sample) { return FRotator::NormalizeAxis(sample * 7.5f); };
+	auto getState = [](int32 sample) { return sample < 30 ? EParkourRunnerState::None : sample < 60 ? EParkourRunnerState::Falling | EParkourRunnerState::WallRunning : EParkourRunnerState::Sliding; };
+
+	for (int32 sample = 0; sample < numSamples; ++sample)
+	{
+		writer.AddSample(getLocation(sample), getYaw(sample), getState(sample));
+		if (sample == 29)
+			writer.AddAction(EParkourRecordedAction::Jump);
+		else if (sample == 59)
+			writer.AddAction(EParkourRecordedAction::StartSlide);
+	}
+
+	const FString fileName = FPaths::AutomationTransientDir() / TEXT("ParkourRecordingTest.pkr");
+	if (!TestTrue(TEXT("The recording is written"), writer.Save(fileName)))
+		return false;
+
+	{
+		FParkourRecordingReader reader;
+		if (TestTrue(TEXT("The recording is read back"), reader.Open(fileName)))
+		{
+			TestEqual(TEXT("Sample count"), reader.GetNumSamples(), numSamples);
+			TestEqual(TEXT("Action count"), reader.GetNumActions(), 2);
+			TestEqual(TEXT("Sample interval"), reader.GetSampleInterval(), 1.0f / 30.0f, KINDA_SMALL_NUMBER);
+
+			for (int32 sample = 0; sample < reader.GetNumSamples(); ++sample)
+			{
+				if (!TestTrue(FString::Printf(TEXT("Sample %d location"), sample), reader.GetLocation(sample).Equals(getLocation(sample), positionStep * 0.5f + KINDA_SMALL_NUMBER))
+					|| !TestTrue(FString::Printf(TEXT("Sample %d yaw"), sample), FMath::Abs(FRotator::NormalizeAxis(reader.GetYaw(sample) - getYaw(sample))) < 0.01f)
+					|| !TestTrue(FString::Printf(TEXT("Sample %d state"), sample), reader.GetState(sample) == getState(sample)))
+					break;
+			}
+
+			if (reader.GetNumActions() == 2)
+			{
+				TestEqual(TEXT("First action sample"), (int32)reader.GetAction(0).Sample, 29);
+				TestTrue(TEXT("First action"), reader.GetAction(0).Action == EParkourRecordedAction::Jump);
+				TestEqual(TEXT("Second action sample"), (int32)reader.GetAction(1).Sample, 59);
+				TestTrue(TEXT("Second action"), reader.GetAction(1).Action == EParkourRecordedAction::StartSlide);
+			}
+
+			//Halfway between two samples is halfway between their locations, with the earlier state
+			FVector location;
+			float yaw;
+			EParkourRunnerState state;
+			reader.Evaluate(reader.GetSampleInterval() * 40.5f, location, yaw, state);
+			TestTrue(TEXT("Evaluated location"), location.Equals(FMath::Lerp(reader.GetLocation(40), reader.GetLocation(41), 0.5f), KINDA_SMALL_NUMBER));
+			TestTrue(TEXT("Evaluated state"), state == getState(40));
+		}
+	}
+
+	//A file that isn't a recording is turned down
+	const FString badFileName = FPaths::AutomationTransientDir() / TEXT("ParkourRecordingTestBad.pkr");
+	TArray<uint8> badData;
+	badData.SetNumZeroed(64);
+	FFileHelper::SaveArrayToFile(badData, *badFileName);
+	{
+		FParkourRecordingReader reader;
+		AddExpectedError(TEXT("isn't a parkour recording"), EAutomationExpectedErrorFlags::Contains, 1);
+		TestFalse(TEXT("A file that isn't a recording isn't opened"), reader.Open(badFileName));
+	}
+
+	IFileManager::Get().Delete(*fileName);
+	IFileManager::Get().Delete(*badFileName);
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Parkour surfaces
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FParkourSurfaceTest, "TestComplexSystem.Parkour.Surface", ParkourTestFlags)
+
+/// <summary>
+/// Checks a wall tagged NoWallrun can't be wall run on but can still be vaulted, and that a
+/// surface that can't be climbed or vaulted has no ledge
+/// </summary>
+bool FParkourSurfaceTest::RunTest(const FString& Parameters)
+{
+	FParkourTestWorld testWorld;
+	if (!TestNotNull(TEXT("Engine cube"), testWorld.Cube))
+		return false;
+
+	const FCollisionQueryParams params = MakeProbeParams();
+
+	//Traces along the forward probe and reads the surface off the hit
+	auto probeSurface = [&](EParkourSurface& surface)
+	{
+		FHitResult hit;
+		if (!FParkourLedgeProbe::TraceWall(testWorld.World, TestProbeStart, FVector::ForwardVector, params, hit))
+			return false;
+		surface = UParkourPhysicalMaterial::GetSurface(hit);
+		return true;
+	};
+
+	EParkourSurface surface = EParkourSurface::None;
+	FParkourLedge ledge;
+	AStaticMeshActor* wall = testWorld.SpawnWall(80.0f, 20.0f);
+	if (TestTrue(TEXT("The probe hits a plain wall"), probeSurface(surface)))
+		TestTrue(TEXT("A plain wall allows every move"), surface == EParkourSurface::All);
+
+	//Tags are turned into the NoWallrun material by the surface subsystem
+	wall->Tags.Add(TEXT("NoWallrun"));
+	UParkourSurfaceSubsystem::ApplySurfaceTags(wall);
+	if (TestTrue(TEXT("The probe hits a NoWallrun wall"), probeSurface(surface)))
+	{
+		TestFalse(TEXT("A NoWallrun wall can't be wall run on"), EnumHasAnyFlags(surface, EParkourSurface::WallRun));
+		TestTrue(TEXT("A NoWallrun wall can be climbed and vaulted"), EnumHasAllFlags(surface, EParkourSurface::Climb | EParkourSurface::Vault));
+	}
+	TestTrue(TEXT("A NoWallrun wall can still be vaulted"), FParkourLedgeProbe::Trace(testWorld.World, TestProbeStart, FVector::ForwardVector, params, ledge));
+
+	//A surface only for wall running has no ledge
+	UParkourPhysicalMaterial* wallRunOnly = NewObject<UParkourPhysicalMaterial>();
+	wallRunOnly->SurfaceFlags = (int32)EParkourSurface::WallRun;
+	wall->GetStaticMeshComponent()->SetPhysMaterialOverride(wallRunOnly);
+	TestFalse(TEXT("A wall run only wall can't be vaulted"), FParkourLedgeProbe::Trace(testWorld.World, TestProbeStart, FVector::ForwardVector, params, ledge));
+
+	return true;
+}
+
+#endif
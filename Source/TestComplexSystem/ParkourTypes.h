@@ -0,0 +1,91 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+//The trace channel every parkour probe uses, "Parkour" in DefaultEngine.ini. It blocks by
+//default, so only characters and anything that should never be run on, climbed or vaulted
+//ignore it, and those are left out before the narrow phase
+#define ECC_Parkour ECC_GameTraceChannel1
+
+//How much parkour work a character does per frame, from no probing at all up to
+//full rate. Set by the parkour significance manager from the distance and visibility
+//of the character to the viewers
+enum class EParkourSignificance : uint8
+{
+	Culled,
+	Far,
+	Medium,
+	Full
+};
+
+//What a crowd runner or a recorded character is doing, kept as bits so the whole state is one byte
+enum class EParkourRunnerState : uint8
+{
+	None = 0,
+	Falling = 1 << 0,
+	WallRunning = 1 << 1,
+	RightSide = 1 << 2,
+	Sliding = 1 << 3,
+	Vaulting = 1 << 4,
+	Climbing = 1 << 5,
+	//The crowd runner is being simulated by a full character near the player
+	Promoted = 1 << 6
+};
+ENUM_CLASS_FLAGS(EParkourRunnerState);
+
+//What a character should do with the wall in front of it
+enum class EParkourLedgeAction : uint8
+{
+	None,
+	//The far edge of the wall is within reach, so the character goes over it
+	Vault,
+	//The top of the wall carries on past reach, so the character gets up onto it
+	Climb
+};
+
+//The path a character takes over or onto a wall. It rises straight up until it clears the
+//top of the wall, then moves across, so it never has to go through the wall
+struct FParkourVaultPath
+{
+	FVector Start = FVector::ZeroVector;
+	//Where the rise ends, straight above the start
+	FVector Apex = FVector::ZeroVector;
+	FVector End = FVector::ZeroVector;
+	//How much of the vault is spent rising
+	float RiseFraction = 0.4f;
+
+	//Returns the location on the path, from 0 at the start to 1 at the end
+	FVector GetLocation(float Alpha) const
+	{
+		if (Alpha < RiseFraction)
+			return FMath::InterpEaseOut(Start, Apex, Alpha / RiseFraction, 2.0f);
+		return FMath::InterpEaseInOut(Apex, End, (Alpha - RiseFraction) / (1.0f - RiseFraction), 2.0f);
+	}
+};
+
+//The result of checking the wall in front of a character for climbing or vaulting
+struct FParkourLedge
+{
+	//Where the forward probe hit the wall and the way the wall is facing
+	FVector WallLocation = FVector::ZeroVector;
+	FVector WallNormal = FVector::ZeroVector;
+
+	//The top of the wall just past its face, and the top of the wall at its far edge, or as
+	//far in as the probe reaches if the far edge is out of reach
+	FVector WallHeight = FVector::ZeroVector;
+	FVector OtherWallHeight = FVector::ZeroVector;
+
+	//How high the top of the wall is above the wall location
+	float Height = 0.0f;
+	//How far the top of the wall goes in from its face before the far edge
+	float Thickness = 0.0f;
+	//Whether the far edge was found. If not the wall is at least as thick as the probe reaches
+	bool bHasFarEdge = false;
+
+	EParkourLedgeAction Action = EParkourLedgeAction::None;
+
+	//The component the forward probe hit
+	class UPrimitiveComponent* WallComponent = nullptr;
+};
@@ -8,6 +8,12 @@ public class TestComplexSystem : ModuleRules
 	{
 		PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
 
-		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "HeadMountedDisplay" });
+		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "SignificanceManager", "NavigationSystem", "ReplicationGraph", "PhysicsCore" });
+
+		// Dedicated servers have no headset to reset, so they don't link the VR module
+		if (Target.Type != TargetType.Server)
+		{
+			PublicDependencyModuleNames.Add("HeadMountedDisplay");
+		}
 	}
 }
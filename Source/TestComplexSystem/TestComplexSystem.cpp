@@ -2,6 +2,31 @@
 
 #include "TestComplexSystem.h"
 #include "Modules/ModuleManager.h"
+#include "Misc/CoreDelegates.h"
+#include "ParkourStats.h"
 
-IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, TestComplexSystem, "TestComplexSystem" );
- 
\ No newline at end of file
+/** Game module that writes the once a frame parkour counters when profiling is compiled in */
+class FTestComplexSystemModule : public FDefaultGameModuleImpl
+{
+public:
+	virtual void StartupModule() override
+	{
+#if PARKOUR_PROFILING
+		EndFrameHandle = FCoreDelegates::OnEndFrame.AddStatic(&FParkourFrameStats::OnEndFrame);
+#endif
+	}
+
+	virtual void ShutdownModule() override
+	{
+#if PARKOUR_PROFILING
+		FCoreDelegates::OnEndFrame.Remove(EndFrameHandle);
+#endif
+	}
+
+private:
+	FDelegateHandle EndFrameHandle;
+};
+
+IMPLEMENT_PRIMARY_GAME_MODULE( FTestComplexSystemModule, TestComplexSystem, "TestComplexSystem" );
+
+DEFINE_LOG_CATEGORY(LogParkour);
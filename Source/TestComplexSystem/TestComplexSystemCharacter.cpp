@@ -1,22 +1,153 @@
 // Copyright Epic Games, Inc. All Rights Reserved.
 
 #include "TestComplexSystemCharacter.h"
+#if !UE_SERVER
 #include "HeadMountedDisplayFunctionLibrary.h"
+#endif
 #include "Camera/CameraComponent.h"
+#include "Components/BoxComponent.h"
 #include "Components/CapsuleComponent.h"
 #include "Components/InputComponent.h"
+#include "Components/SkeletalMeshComponent.h"
 #include "GameFramework/CharacterMovementComponent.h"
 #include "GameFramework/Controller.h"
 #include "GameFramework/SpringArmComponent.h"
-#include "DrawDebugHelpers.h"
+#include "EngineUtils.h"
 #include "Kismet/KismetMathLibrary.h"
 #include <Kismet/KismetSystemLibrary.h>
 #include "Kismet/GameplayStatics.h"
+#include "HAL/IConsoleManager.h"
+#include "ParkourMovementComponent.h"
+#include "ParkourSignificanceManager.h"
+#include "ParkourProbeScheduler.h"
+#include "ParkourBatchSubsystem.h"
+#include "ParkourLedgeProbe.h"
+#include "ParkourLedgeIndexSubsystem.h"
+#include "ParkourNavLinkGenerator.h"
+#include "ParkourPhysicalMaterial.h"
+#include "ParkourReplicationGraph.h"
+#include "ParkourStats.h"
+#include "TestComplexSystem.h"
+
+DECLARE_CYCLE_STAT(TEXT("Character Tick"), STAT_ParkourTick, STATGROUP_Parkour);
+DECLARE_CYCLE_STAT(TEXT("CheckForWallRunning"), STAT_ParkourCheckForWallRunning, STATGROUP_Parkour);
+DECLARE_CYCLE_STAT(TEXT("CheckForClimbing"), STAT_ParkourCheckForClimbing, STATGROUP_Parkour);
+DECLARE_CYCLE_STAT(TEXT("StartVaultOrGetUp"), STAT_ParkourStartVaultOrGetUp, STATGROUP_Parkour);
+DECLARE_CYCLE_STAT(TEXT("CheckJump"), STAT_ParkourCheckJump, STATGROUP_Parkour);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Wall Run Traces (Sync)"), STAT_ParkourWallRunTracesSync, STATGROUP_Parkour);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Wall Run Traces (Async)"), STAT_ParkourWallRunTracesAsync, STATGROUP_Parkour);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Wall Run Traces Skipped (No Wall In Range)"), STAT_ParkourWallRunTracesSkipped, STATGROUP_Parkour);
+
+static TAutoConsoleVariable<int32> CVarParkourAsyncWallRunTraces(
+	TEXT("parkour.AsyncWallRunTraces"),
+	0,
+	TEXT("When on, wall run probes are issued as async traces and their results are used on the next tick.\n")
+	TEXT("0: blocking traces on the game thread (default), 1: async traces pipelined by one frame"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarParkourWallContactEvents(
+	TEXT("parkour.WallContactEvents"),
+	0,
+	TEXT("When on, airborne characters keep an overlap volume either side of them and only run the wall run probes\n")
+	TEXT("while a wall is inside it. Walls need Generate Overlap Events turned on to be found. A character keeps probing\n")
+	TEXT("every airborne tick until its volume has found a wall once, so levels with no such walls behave as with 0.\n")
+	TEXT("0: probe every airborne tick (default), 1: probe only with a wall in range"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarParkourAdaptiveNetUpdate(
+	TEXT("parkour.AdaptiveNetUpdate"),
+	1,
+	TEXT("When on, the server replicates characters often during parkour moves and rarely while they stand still.\n")
+	TEXT("0: the class default net update rate, 1: rate set by what the character is doing (default)"),
+	ECVF_Default);
+
+/// <summary>
+/// Spawns a grid of AI controlled characters high above the player so they spend a long time
+/// falling. Used with "stat Parkour" to compare the game thread cost of the wall run probes
+/// with parkour.AsyncWallRunTraces on and off
+/// </summary>
+/// <param name="Args">the number of characters to spawn and the height to spawn them at</param>
+/// <param name="World">the world to spawn the characters in</param>
+static void SpawnAirborneCharacters(const TArray<FString>& Args, UWorld* World)
+{
+	if (!World)
+		return;
+
+	int32 count = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 100;
+	float height = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 20000.0f;
+
+	//Spawn the same class as the player if it is a parkour character so the blueprint setup is used
+	APawn* playerPawn = UGameplayStatics::GetPlayerPawn(World, 0);
+	UClass* characterClass = (playerPawn && playerPawn->IsA<ATestComplexSystemCharacter>()) ? playerPawn->GetClass() : ATestComplexSystemCharacter::StaticClass();
+	FVector origin = playerPawn ? playerPawn->GetActorLocation() : FVector::ZeroVector;
+
+	FActorSpawnParameters spawnParams;
+	spawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	//Lay the characters out in a square grid above the player
+	int32 rowLength = FMath::Max(1, FMath::CeilToInt(FMath::Sqrt((float)count)));
+	for (int32 i = 0; i < count; ++i)
+	{
+		FVector location = origin + FVector((i % rowLength) * 200.0f, (i / rowLength) * 200.0f, height);
+		ATestComplexSystemCharacter* character = World->SpawnActor<ATestComplexSystemCharacter>(characterClass, location, FRotator::ZeroRotator, spawnParams);
+
+		//The movement component only simulates characters that have a controller
+		if (character)
+			character->SpawnDefaultController();
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs ParkourSpawnAirborneCharactersCommand(
+	TEXT("parkour.SpawnAirborneCharacters"),
+	TEXT("Spawns falling AI characters above the player for profiling wall run probes. Usage: parkour.SpawnAirborneCharacters <Count=100> <Height=20000>"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&SpawnAirborneCharacters));
+
+/// <summary>
+/// Logs what each parkour character costs in this build, to compare the client and
+/// dedicated server builds. Component sizes are the objects themselves plus whatever
+/// they hold on to, the tick cost per character is "stat Parkour" Tick over the count
+/// </summary>
+/// <param name="World">the world of the characters</param>
+static void LogPlayerFootprint(UWorld* World)
+{
+	if (!World)
+		return;
+
+	int32 characterCount = 0;
+	int32 componentCount = 0;
+	int32 tickingComponentCount = 0;
+	SIZE_T bytes = 0;
+	for (TActorIterator<ATestComplexSystemCharacter> it(World); it; ++it)
+	{
+		++characterCount;
+		bytes += it->GetClass()->GetStructureSize();
+		for (UActorComponent* component : it->GetComponents())
+		{
+			++componentCount;
+			if (component->IsComponentTickEnabled())
+				++tickingComponentCount;
+			bytes += component->GetClass()->GetStructureSize() + component->GetResourceSizeBytes(EResourceSizeMode::Exclusive);
+		}
+	}
+
+	if (characterCount == 0)
+		return;
+
+	UE_LOG(LogParkour, Display, TEXT("Parkour footprint (%s): %d characters, %.1f components, %.1f ticking components, %.1f KB per character"),
+		IsRunningDedicatedServer() ? TEXT("dedicated server") : TEXT("client"), characterCount, (float)componentCount / characterCount,
+		(float)tickingComponentCount / characterCount, bytes / 1024.0f / characterCount);
+}
+
+static FAutoConsoleCommandWithWorld ParkourPlayerFootprintCommand(
+	TEXT("parkour.PlayerFootprint"),
+	TEXT("Logs the components, ticking components and memory of each parkour character in this build"),
+	FConsoleCommandWithWorldDelegate::CreateStatic(&LogPlayerFootprint));
 
 //////////////////////////////////////////////////////////////////////////
 // ATestComplexSystemCharacter
 
-ATestComplexSystemCharacter::ATestComplexSystemCharacter()
+ATestComplexSystemCharacter::ATestComplexSystemCharacter(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer.SetDefaultSubobjectClass<UParkourMovementComponent>(ACharacter::CharacterMovementComponentName))
 {
 	// Set size for collision capsule
 	GetCapsuleComponent()->InitCapsuleSize(42.f, 96.0f);
@@ -36,7 +167,15 @@ ATestComplexSystemCharacter::ATestComplexSystemCharacter()
 	GetCharacterMovement()->JumpZVelocity = 600.f;
 	GetCharacterMovement()->AirControl = 0.2f;
 
-	// Create a camera boom (pulls in towards the player if there is a collision)
+	// Parkour moves are done by the movement component so they can be predicted
+	ParkourMovement = Cast<UParkourMovementComponent>(GetCharacterMovement());
+
+	// Parkour probes only look for walls, so characters are never hit by them
+	GetCapsuleComponent()->SetCollisionResponseToChannel(ECC_Parkour, ECR_Ignore);
+	GetMesh()->SetCollisionResponseToChannel(ECC_Parkour, ECR_Ignore);
+
+	// Create a camera boom (pulls in towards the player if there is a collision). Every build
+	// creates it so blueprints see the same components, dedicated servers turn it off in BeginPlay
 	CameraBoom = CreateDefaultSubobject<USpringArmComponent>(TEXT("CameraBoom"));
 	CameraBoom->SetupAttachment(RootComponent);
 	CameraBoom->TargetArmLength = 300.0f; // The camera follows at this distance behind the character	
@@ -47,8 +186,132 @@ ATestComplexSystemCharacter::ATestComplexSystemCharacter()
 	FollowCamera->SetupAttachment(CameraBoom, USpringArmComponent::SocketName); // Attach the camera to the end of the boom and let the boom adjust to match the controller orientation
 	FollowCamera->bUsePawnControlRotation = false; // Camera does not rotate relative to arm
 
+	// Create the wall sensor, reaching a little past the wall run probes on both sides. It is a pawn that only
+	// overlaps the world so it never overlaps the character or other characters, and it stays off until
+	// parkour.WallContactEvents turns it on
+	WallSensor = CreateDefaultSubobject<UBoxComponent>(TEXT("WallSensor"));
+	WallSensor->SetupAttachment(RootComponent);
+	WallSensor->InitBoxExtent(FVector(40.0f, 60.0f, 20.0f));
+	WallSensor->SetCollisionObjectType(ECC_Pawn);
+	WallSensor->SetCollisionResponseToAllChannels(ECR_Ignore);
+	WallSensor->SetCollisionResponseToChannel(ECC_WorldStatic, ECR_Overlap);
+	WallSensor->SetCollisionResponseToChannel(ECC_WorldDynamic, ECR_Overlap);
+	WallSensor->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	WallSensor->SetGenerateOverlapEvents(false);
+	WallSensor->SetCanEverAffectNavigation(false);
+
 	// Note: The skeletal mesh and anim blueprint references on the Mesh component (inherited from Character) 
 	// are set in the derived blueprint asset named MyCharacter (to avoid direct content references in C++)
+
+	//Run at full rate until the significance manager says otherwise
+	_significance = EParkourSignificance::Full;
+	_probeInterval = 1;
+	_ticksSinceProbe = 0;
+	_probeBudgetExempt = false;
+	_wallSensorFoundWall = false;
+	_nextNavLinkTime = 0.0f;
+
+	_timeSinceRecordedSample = 0.0f;
+	_wallThickness = 0.0f;
+
+	//Replicate often while a move can change in a frame, and rarely while nothing changes
+	ParkourNetUpdateFrequency = 60.0f;
+	MovingNetUpdateFrequency = 30.0f;
+	IdleNetUpdateFrequency = 5.0f;
+}
+
+/// <summary>
+/// Registers the character with the parkour significance manager and turns the camera
+/// boom off on dedicated servers
+/// </summary>
+void ATestComplexSystemCharacter::BeginPlay()
+{
+	Super::BeginPlay();
+
+	//Dedicated servers never look through the camera, so the boom stops ticking and probing for collision
+	if (IsRunningDedicatedServer() && CameraBoom)
+	{
+		CameraBoom->bDoCollisionTest = false;
+		CameraBoom->SetComponentTickEnabled(false);
+	}
+
+	if (UParkourSignificanceManager* significanceManager = UParkourSignificanceManager::Get(GetWorld()))
+		significanceManager->RegisterCharacter(this);
+}
+
+/// <summary>
+/// Unregisters the character from the parkour significance manager
+/// </summary>
+/// <param name="EndPlayReason">why the character is being removed</param>
+void ATestComplexSystemCharacter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UParkourSignificanceManager* significanceManager = UParkourSignificanceManager::Get(GetWorld()))
+		significanceManager->UnregisterCharacter(this);
+
+	Super::EndPlay(EndPlayReason);
+}
+
+/// <summary>
+/// Sets how much parkour work the character does. Lower tiers tick less often and
+/// probe for walls every few ticks, and culled characters stop probing completely
+/// </summary>
+/// <param name="significance">the new significance tier</param>
+void ATestComplexSystemCharacter::SetParkourSignificance(EParkourSignificance significance)
+{
+	_significance = significance;
+
+	UParkourSignificanceManager* significanceManager = UParkourSignificanceManager::Get(GetWorld());
+	if (!significanceManager || significance == EParkourSignificance::Full)
+	{
+		SetActorTickInterval(0.0f);
+		_probeInterval = 1;
+		return;
+	}
+
+	SetActorTickInterval(significanceManager->GetTickInterval(significance));
+	_probeInterval = significanceManager->GetProbeInterval(significance);
+}
+
+/// <summary>
+/// Whether this copy of the character decides when to wall run. The owning client and
+/// AI on the server probe for walls, the server of a remote player follows the flags
+/// the client sends and simulated proxies follow the replicated movement
+/// </summary>
+/// <returns>true if the character should probe for walls</returns>
+bool ATestComplexSystemCharacter::IsParkourLocallyDriven() const
+{
+	return IsLocallyControlled() || (GetLocalRole() == ROLE_Authority && GetRemoteRole() != ROLE_AutonomousProxy);
+}
+
+/// <summary>
+/// How soon the wall probe of the character should run when the probe budget is tight.
+/// More significant characters go first, then characters already on a wall that need
+/// to know when it ends, then characters falling downwards that could start a wall run.
+/// Characters go up the longer they wait so none of them wait forever
+/// </summary>
+/// <returns>the priority, higher runs first</returns>
+float ATestComplexSystemCharacter::GetProbePriority() const
+{
+	float priority = (float)_significance * 100.0f;
+
+	if (ParkourMovement->IsWallRunning())
+		priority += 50.0f;
+	else if (GetVelocity().Z < 0.0f)
+		priority += 25.0f;
+
+	return priority + _ticksSinceProbe * 10.0f;
+}
+
+/// <summary>
+/// Runs the wall probe, either right away or when the probe scheduler gets to it
+/// </summary>
+void ATestComplexSystemCharacter::RunScheduledProbe()
+{
+	_ticksSinceProbe = 0;
+
+	//The character may have landed between asking for the probe and the scheduler running it
+	if (GetCharacterMovement()->IsFalling() || ParkourMovement->IsWallRunning())
+		CheckForWallRunning();
 }
 
 /// <summary>
@@ -57,16 +320,29 @@ ATestComplexSystemCharacter::ATestComplexSystemCharacter()
 /// <param name="deltaTime"></param>
 void ATestComplexSystemCharacter::Tick(float deltaTime)
 {
-	//Gets the forward velocity of the player
-	float ForwardVelocity = FVector::DotProduct(GetVelocity(), GetActorForwardVector());
+	PARKOUR_SCOPE(Tick);
 
-	//Sets the current height of the player for wall running
-	_currentFrameHeight = GetActorLocation().Z;
-
-	//If the character is falling, check for wallrunning
-	if (GetCharacterMovement()->IsFalling())
+	//If the character is falling or already on a wall, check for wallrunning. Characters far
+	//from the players only check every few ticks, and culled characters don't check at all
+	const bool airborne = GetCharacterMovement()->IsFalling() || ParkourMovement->IsWallRunning();
+	UpdateWallSensor(airborne && IsParkourLocallyDriven());
+	if (airborne)
 	{
-		CheckForWallRunning();
+		if (IsParkourLocallyDriven() && _probeInterval > 0 && ++_ticksSinceProbe >= _probeInterval)
+		{
+			//With batched probes the probe runs with every other character's at the end of the
+			//frame. With a probe budget the probe waits for the scheduler at the end of the frame,
+			//and keeps the last result if it doesn't fit. With no wall in range of the wall
+			//sensor the probe doesn't trace, so it runs right away
+			UParkourBatchSubsystem* probeBatch = GetWorld()->GetSubsystem<UParkourBatchSubsystem>();
+			UParkourProbeScheduler* probeScheduler = GetWorld()->GetSubsystem<UParkourProbeScheduler>();
+			if (probeBatch && UParkourBatchSubsystem::IsEnabled())
+				probeBatch->RequestProbe(this);
+			else if (probeScheduler && UParkourProbeScheduler::IsBudgeted() && HasWallContact())
+				probeScheduler->RequestProbe(this, GetProbePriority(), (_leftSide || _rightSide) ? 1 : 2);
+			else
+				RunScheduledProbe();
+		}
 	}
 	//Else...
 	else
@@ -77,29 +353,161 @@ void ATestComplexSystemCharacter::Tick(float deltaTime)
 		inAction = false;
 		_rightSide = false;
 		_leftSide = false;
-		//Set the gravity scale and plane constraint back to normal
-		GetCharacterMovement()->GravityScale = 1.0f;
-		GetCharacterMovement()->SetPlaneConstraintNormal(FVector(0.0f, 0.0f, 0.0f));
+		//The movement component puts gravity back to normal when landing
+		if (IsParkourLocallyDriven())
+			ParkourMovement->StopWallRun();
+		//Drop any async wall probes so a stale result isn't used on the next jump
+		_rightWallTraceHandle = FTraceHandle();
+		_leftWallTraceHandle = FTraceHandle();
+
+		//AI has no one to press jump for it, so it takes the parkour links on its path itself
+		if (IsParkourLocallyDriven() && !IsPlayerControlled() && GetController())
+			FollowNavLink();
 	}
-	
-	//If the forward velocity is less than 100 and the player is still wallrunning...
-	if (ForwardVelocity <= 100.0f && _isWallRunning)
+
+	//Sample the run at the recording rate when it is being recorded
+	if (_recorder)
 	{
-		//...turn off wallrunning by setting wallrunning, inaction, rightside and leftside to be false
-		_isWallRunning = false;
-		inAction = false;
-		_rightSide = false;
-		_leftSide = false;
-		//Set the gravity scale and plane constraint back to normal
-		GetCharacterMovement()->GravityScale = 50.0f;
-		GetCharacterMovement()->SetPlaneConstraintNormal(FVector(0.0f, 0.0f, 0.0f));
+		_timeSinceRecordedSample += deltaTime;
+		while (_timeSinceRecordedSample >= _recorder->GetSampleInterval())
+		{
+			_timeSinceRecordedSample -= _recorder->GetSampleInterval();
+			_recorder->AddSample(GetActorLocation(), GetActorRotation().Yaw, GetParkourState());
+		}
+	}
 
-		//GetWorldTimerManager().SetTimer(timerHandle, this, &ATestComplexSystemCharacter::TurnOffJumpOffWall, 1.5f, false);
+	UpdateNetUpdateFrequency();
+}
+
+/// <summary>
+/// Takes the parkour nav link AI is walking on to. Path following only walks towards the
+/// end of a link, so once the character is at the start of one and heading for its end it
+/// faces the end and vaults or climbs the wall, or jumps off the edge for a wall run, which
+/// the airborne wall probes then pick up. Links that can't be taken, like a wall that has
+/// moved since the scan, are left to path following for a while before being tried again
+/// </summary>
+void ATestComplexSystemCharacter::FollowNavLink()
+{
+	const float now = GetWorld()->GetTimeSeconds();
+	if (now < _nextNavLinkTime || inAction || !GetCharacterMovement()->IsMovingOnGround())
+		return;
+
+	//Path following keeps pushing towards the end of the link, even while a wall stops the character
+	const FVector acceleration = GetCharacterMovement()->GetCurrentAcceleration().GetSafeNormal2D();
+	if (acceleration.IsZero())
+		return;
+
+	UParkourNavLinkGenerator* navLinks = GetWorld()->GetSubsystem<UParkourNavLinkGenerator>();
+	if (!navLinks)
+		return;
+
+	//Links start on the navmesh, so they are found from the character's feet
+	const FVector feet = GetActorLocation() - FVector(0.0f, 0.0f, GetCapsuleComponent()->GetScaledCapsuleHalfHeight());
+	const FParkourNavLink* link = navLinks->FindLink(feet, NavLinkReachDistance);
+	if (!link)
+		return;
+
+	const FVector linkDirection = (link->End - link->Start).GetSafeNormal2D();
+	if (FVector::DotProduct(acceleration, linkDirection) < 0.5f)
+		return;
+
+	_nextNavLinkTime = now + NavLinkRetryInterval;
+
+	if (link->Type == EParkourNavLinkType::WallRun)
+	{
+		CheckJump();
+		return;
 	}
-	
-	//Set the last frame height to be the current frame height
-	_lastFrameHeight = _currentFrameHeight;
-	
+
+	//The ledge probe looks straight ahead, so face the wall first
+	SetActorRotation(FRotator(0.0f, linkDirection.Rotation().Yaw, 0.0f));
+	if (CheckForClimbing())
+		StartVaultOrGetUp();
+}
+
+/// <summary>
+/// Sets how often the server replicates the character from what it is doing. Characters
+/// replicate at the parkour rate through wall runs, vaults, climbs, slides and jumps, at
+/// the moving rate running on the ground and at the idle rate standing still. Going up
+/// to a higher rate also forces an update, so the start of a move goes out right away
+/// instead of waiting out the idle rate
+/// </summary>
+void ATestComplexSystemCharacter::UpdateNetUpdateFrequency()
+{
+	if (GetLocalRole() != ROLE_Authority || GetNetMode() == NM_Standalone)
+		return;
+
+	float frequency = GetClass()->GetDefaultObject<AActor>()->NetUpdateFrequency;
+	if (CVarParkourAdaptiveNetUpdate.GetValueOnGameThread())
+	{
+		if (GetCharacterMovement()->IsFalling() || ParkourMovement->IsWallRunning() || ParkourMovement->IsVaulting() || ParkourMovement->IsSliding() || isClimbing || _isJumpingOffWall)
+			frequency = ParkourNetUpdateFrequency;
+		else if (!GetVelocity().IsNearlyZero(1.0f) || GetCharacterMovement()->GetCurrentAcceleration().SizeSquared() > 0.0f)
+			frequency = MovingNetUpdateFrequency;
+		else
+			frequency = IdleNetUpdateFrequency;
+	}
+
+	if (frequency == NetUpdateFrequency)
+		return;
+
+	const bool speedingUp = frequency > NetUpdateFrequency;
+	NetUpdateFrequency = frequency;
+	//Set the floor from the new rate every time, so the engine's adaptive rate can climb back up after an idle period
+	MinNetUpdateFrequency = frequency;
+
+	//The replication graph copies the rate when the character is added, so tell it about the new one
+	if (UParkourReplicationGraph* replicationGraph = UParkourReplicationGraph::Get(GetWorld()))
+		replicationGraph->UpdateActorNetUpdateFrequency(this);
+
+	if (speedingUp)
+		ForceNetUpdate();
+}
+
+/// <summary>
+/// Starts recording the character's parkour run. Samples are taken in tick and the
+/// parkour actions are recorded as they happen
+/// </summary>
+void ATestComplexSystemCharacter::StartRecording()
+{
+	_recorder = MakeUnique<FParkourRecordingWriter>();
+	_timeSinceRecordedSample = 0.0f;
+	_recorder->AddSample(GetActorLocation(), GetActorRotation().Yaw, GetParkourState());
+}
+
+/// <summary>
+/// Stops recording and writes the recording to a file
+/// </summary>
+/// <param name="fileName">the file to write to</param>
+/// <returns>false if nothing was being recorded or the file couldn't be written</returns>
+bool ATestComplexSystemCharacter::StopRecording(const FString& fileName)
+{
+	if (!_recorder)
+		return false;
+
+	const bool saved = _recorder->Save(fileName);
+	_recorder.Reset();
+	return saved;
+}
+
+/// <summary>
+/// Gets what the character is doing as the state bits used by recordings
+/// </summary>
+/// <returns>the state bits</returns>
+EParkourRunnerState ATestComplexSystemCharacter::GetParkourState() const
+{
+	EParkourRunnerState state = EParkourRunnerState::None;
+	if (GetCharacterMovement()->IsFalling())
+		state |= EParkourRunnerState::Falling;
+	if (ParkourMovement->IsWallRunning())
+		state |= _onRightSide ? (EParkourRunnerState::WallRunning | EParkourRunnerState::RightSide) : EParkourRunnerState::WallRunning;
+	if (isSliding)
+		state |= EParkourRunnerState::Sliding;
+	if (isVaulting)
+		state |= EParkourRunnerState::Vaulting;
+	if (isClimbing)
+		state |= EParkourRunnerState::Climbing;
+	return state;
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -126,12 +534,14 @@ void ATestComplexSystemCharacter::SetupPlayerInputComponent(class UInputComponen
 	PlayerInputComponent->BindAxis("LookUp", this, &APawn::AddControllerPitchInput);
 	PlayerInputComponent->BindAxis("LookUpRate", this, &ATestComplexSystemCharacter::LookUpAtRate);
 
+#if !UE_SERVER
 	// handle touch devices
 	PlayerInputComponent->BindTouch(IE_Pressed, this, &ATestComplexSystemCharacter::TouchStarted);
 	PlayerInputComponent->BindTouch(IE_Released, this, &ATestComplexSystemCharacter::TouchStopped);
 
 	// VR headset functionality
 	PlayerInputComponent->BindAction("ResetVR", IE_Pressed, this, &ATestComplexSystemCharacter::OnResetVR);
+#endif
 }
 
 /// <summary>
@@ -179,13 +589,11 @@ void ATestComplexSystemCharacter::StartSlide()
 	inAction = true;
 	isSliding = true;
 
-	//Set the half heigh and get the new mesh location
-	GetCapsuleComponent()->SetCapsuleHalfHeight(48.0f);
-	FVector meshLocation = GetMesh()->GetComponentTransform().GetLocation();
-	meshLocation.Z += 50.0f;
+	if (_recorder)
+		_recorder->AddAction(EParkourRecordedAction::StartSlide);
 
-	//Set the new mesh location
-	GetMesh()->SetWorldLocation(meshLocation);
+	//The movement component shrinks the capsule and lowers the mesh on the next move
+	ParkourMovement->SetWantsToSlide(true);
 }
 
 /// <summary>
@@ -197,151 +605,127 @@ void ATestComplexSystemCharacter::StopSlide()
 	inAction = false;
 	isSliding = false;
 
-	//Set the half heigh and get the new mesh location
-	GetCapsuleComponent()->SetCapsuleHalfHeight(96.0f);
-	FVector meshLocation = GetMesh()->GetComponentTransform().GetLocation();
-	meshLocation.Z -= 50.0f;
+	if (_recorder)
+		_recorder->AddAction(EParkourRecordedAction::StopSlide);
 
-	//Set the new mesh location
-	GetMesh()->SetWorldLocation(meshLocation);
+	//The movement component puts the capsule and mesh back on the next move
+	ParkourMovement->SetWantsToSlide(false);
 }
 
 /// <summary>
-/// Checks if the player can climb the object it is facing
+/// Checks if the player can climb the object it is facing. Walls baked into a ledge
+/// index are looked up without tracing, the probes only run for walls that aren't static
+/// inside a baked area and for anywhere that hasn't been baked
 /// </summary>
 /// <returns>true if the player can climb</returns>
 bool ATestComplexSystemCharacter::CheckForClimbing()
 {
-	//Hit result and collision params for use in line tracing
-	FHitResult out;
-	FCollisionQueryParams TraceParams;
+	PARKOUR_SCOPE(CheckForClimbing);
+
+	//Skip the check if the probe budget for this frame is used up, as if there was no wall
+	UParkourProbeScheduler* probeScheduler = GetWorld()->GetSubsystem<UParkourProbeScheduler>();
+	if (probeScheduler && UParkourProbeScheduler::IsBudgeted() && !probeScheduler->TryConsume(this, FParkourLedgeProbe::MaxTraces))
+	{
+#if PARKOUR_PROBE_HISTORY
+		_probeHistory.Add(GetWorld()->GetTimeSeconds(), EParkourProbe::Ledge, EParkourProbeOutcome::Skipped,
+			GetActorLocation(), GetActorLocation() + GetActorForwardVector() * FParkourLedgeProbe::ForwardDistance,
+			FVector::ZeroVector, FVector::ZeroVector, nullptr);
+#endif
+		return false;
+	}
+
+	//Collision params for use in line tracing
+	FCollisionQueryParams TraceParams(SCENE_QUERY_STAT(ParkourClimbTrace));
 	//Ignores the player for line tracing
 	TraceParams.AddIgnoredActor(this);
+	//The physical material says whether the wall can be climbed or vaulted
+	TraceParams.bReturnPhysicalMaterial = true;
 
-	//Get the actor location and forward
-	FVector actorLocation = GetActorLocation(); 
+	//Get the actor location and forward, lowered to where the climb probe starts
+	FVector probeStart = GetActorLocation();
+	probeStart.Z -= FParkourLedgeProbe::ProbeHeightOffset;
 	FVector actorForward = GetActorForwardVector();
 
-	//Sets the actor location and forward to what it needs to be to climb
-	actorLocation.Z -= 44.0f; 
-	actorForward = actorForward * 70.0f;
-
-	//Sets the start location and end location for line tracing
-	FVector startLocation = actorLocation; 
-	FVector endLocation = actorLocation + actorForward; 
-
-	//Line traces to the object to climb
-	bool hasHit = GetWorld()->LineTraceSingleByChannel(out, startLocation, endLocation, ECC_Visibility, TraceParams);
+	//Look the wall up in the baked ledge index, tracing for it where it isn't baked
+	FParkourLedge ledge;
+	bool hasLedge = false;
+	bool traced = true;
+	if (UParkourLedgeIndexSubsystem* ledgeIndex = GetWorld()->GetSubsystem<UParkourLedgeIndexSubsystem>())
+		hasLedge = ledgeIndex->FindOrTraceLedge(probeStart, actorForward, TraceParams, ledge, &traced);
+	else
+		hasLedge = FParkourLedgeProbe::Trace(GetWorld(), probeStart, actorForward, TraceParams, ledge);
 
-	//If the line trace hits nothing, return
-	if (!hasHit)
-		return false;
+#if PARKOUR_PROBE_HISTORY
+	//A ledge isn't used until a vault or climb starts on it, OnVaultStarted marks it used then
+	_probeHistory.Add(GetWorld()->GetTimeSeconds(), EParkourProbe::Ledge, hasLedge ? EParkourProbeOutcome::Rejected : EParkourProbeOutcome::Miss,
+		probeStart, probeStart + actorForward * FParkourLedgeProbe::ForwardDistance, ledge.WallLocation, ledge.WallNormal, ledge.WallComponent, traced);
+#endif
 
-	//Gets the objects location and facing
-	_wallLocation = out.Location;
-	_wallNormal = out.Normal;
-
-	//Creates a rotator from the wall normal and gets the forward vector from the wall
-	FRotator rotator = UKismetMathLibrary::MakeRotFromX(_wallNormal);
-	FVector wallForward = UKismetMathLibrary::GetForwardVector(rotator);
-
-	//Sets the start and end location for line tracing using the walls forward and location.
-	//line traces to get the height of the wall to see if the player can vault or climb that high
-	wallForward *= -10.0f;
-	startLocation = (wallForward + _wallLocation);
-	startLocation.Z += 200.0f;
-	endLocation = startLocation;
-	endLocation.Z -= 200.0f;
-	
-	//Line trace the wall
-	hasHit = GetWorld()->LineTraceSingleByChannel(out, startLocation, endLocation, ECC_Visibility, TraceParams);
-	
-	//If the line trace hits nothing, return
-	if (!hasHit)
+	//If there is no wall to climb, return
+	if (!hasLedge)
 		return false;
 
-	//Wall height is the out location of the line trace
-	_wallHeight = out.Location;
-	//Sets if the player should climb based off the height of the wall
-	_shouldPlayerClimb = _wallHeight.Z - _wallLocation.Z > 60.0f;
-
-	//Creates a rotator from the wall normal and gets the forward vector from the wall
-	rotator = UKismetMathLibrary::MakeRotFromX(_wallNormal);
-	wallForward = UKismetMathLibrary::GetForwardVector(rotator);
-
-	//Sets the start and end location for line tracing using the walls forward and location.
-	//Line traces to get the thickness of the wall
-	wallForward *= -50.0f;
-	startLocation = (wallForward + _wallLocation);
-	startLocation.Z += 250.0f;
-	endLocation = startLocation;
-	endLocation.Z -= 300.0f;
-
-	//Line trace the wall to check the thickness 
-	hasHit = GetWorld()->LineTraceSingleByChannel(out, startLocation, endLocation, ECC_Visibility, TraceParams);
-
-	//If the line trace hits nothing, the wall is not thick
-	if (!hasHit)
-		_isWallThick = false;
-
-	//The height of the other wall is the line traces hit location
-	_otherWallHeight = out.Location;
-
-	//Sets if the wall is too thick based off the width of the walls hit
-	_isWallThick = !(_wallHeight.Z - _otherWallHeight.Z > 30.0f);
+	//Store the wall for vaulting or climbing
+	_wallLocation = ledge.WallLocation;
+	_wallNormal = ledge.WallNormal;
+	_wallHeight = ledge.WallHeight;
+	_otherWallHeight = ledge.OtherWallHeight;
+	_wallThickness = ledge.Thickness;
+	_wallComponent = ledge.WallComponent;
+	_shouldPlayerClimb = ledge.Height > FParkourLedgeProbe::ClimbHeight;
+	_isWallThick = ledge.Action == EParkourLedgeAction::Climb;
 
 	return true;
 }
 
 /// <summary>
-/// Starts vaulting functionality
+/// Starts vaulting functionality. The vault itself is started by the movement
+/// component on its next move so it is predicted on the owning client
 /// </summary>
 void ATestComplexSystemCharacter::StartVaultOrGetUp()
 {
-	//If already in action, return then set in action  and is climbing to be true
+	PARKOUR_SCOPE(StartVaultOrGetUp);
+
+	//If already in action, return
 	if (inAction || isClimbing || isVaulting)
 		return;
-	inAction = true;
 
-	//Set the player collision to be off and movement mode to be none
-	GetCapsuleComponent()->SetCollisionEnabled(ECollisionEnabled::NoCollision);
-	GetCharacterMovement()->SetMovementMode(EMovementMode::MOVE_Flying);
+	if (_recorder)
+		_recorder->AddAction(EParkourRecordedAction::VaultOrGetUp);
+
+	ParkourMovement->RequestVault();
+}
+
+/// <summary>
+/// Called by the movement component when a vault or climb starts. Sets the booleans
+/// for the animation and works out the path over or onto the wall
+/// </summary>
+/// <returns>the path to move the player along, starting where they are</returns>
+FParkourVaultPath ATestComplexSystemCharacter::OnVaultStarted()
+{
+	//Set in action to be true
+	inAction = true;
 
-	//Make a new vector for use in setting the actors location
-	FVector actorNewLocation;
+#if PARKOUR_PROBE_HISTORY
+	_probeHistory.MarkUsed(EParkourProbe::Ledge);
+#endif
 
 	//If the wall is too thick to vault over, then climb on top of the object
 	if (_isWallThick)
 	{
-		//Set climing to be true
 		isClimbing = true;
-		//Create a rotator from the walls normal and get the wall forward based off of that
-		FRotator rotator = UKismetMathLibrary::MakeRotFromX(_wallNormal);
-		FVector wallForward = UKismetMathLibrary::GetForwardVector(rotator);
-		//Set the wall forward back by 50
-		wallForward *= 50.0f;
-		//Set the new location to be where the player is plus the wall forward
-		//This is so the animation can play smoothly
-		actorNewLocation = wallForward + GetActorLocation();
-		SetActorLocation(actorNewLocation);
+		PARKOUR_COUNT(Climbs, 1);
 	}
-
 	//If the wall is not too thick then the player can vault
 	else
 	{
-		//Set is vaulting to be true
 		isVaulting = true;
-		//Set the new location to be the players location
-		//And the height is equal to the wall height minus 20
-		//This si so the animation can play smoothly
-		actorNewLocation = GetActorLocation();
-		actorNewLocation.Z = _wallHeight.Z - 20.0f;
-		SetActorLocation(actorNewLocation);
-
+		PARKOUR_COUNT(Vaults, 1);
 	}
 
-	//Set a timer so after the animation plays the collision, movement, and consequent booleans are set off
-	GetWorldTimerManager().SetTimer(timerHandle, this, &ATestComplexSystemCharacter::StopVaultOrGetUp, 1.0f, false);
+	//Move the player from where they are so there is no teleport
+	const UCapsuleComponent* capsule = GetCapsuleComponent();
+	return FParkourLedgeProbe::GetVaultPath(GetActorLocation(), capsule->GetScaledCapsuleRadius(), capsule->GetScaledCapsuleHalfHeight(), _wallLocation, _wallNormal, _wallHeight.Z, _wallThickness, _isWallThick);
 }
 
 /// <summary>
@@ -350,8 +734,7 @@ void ATestComplexSystemCharacter::StartVaultOrGetUp()
 void ATestComplexSystemCharacter::StopVaultOrGetUp()
 {
 	//Set the movement and collision back to normal
-	GetCapsuleComponent()->SetCollisionEnabled(ECollisionEnabled::QueryAndPhysics);
-	GetCharacterMovement()->SetMovementMode(EMovementMode::MOVE_Walking);
+	ParkourMovement->StopVault();
 
 	//Set the booleans to be false since the action is done
 	inAction = false;
@@ -359,6 +742,19 @@ void ATestComplexSystemCharacter::StopVaultOrGetUp()
 	isVaulting = false;
 }
 
+/// <summary>
+/// Called by the movement component when the player runs out of speed on a wall, or
+/// runs past its end, and drops off it
+/// </summary>
+void ATestComplexSystemCharacter::OnWallRunFalloff()
+{
+	//Turn off wallrunning by setting wallrunning, inaction, rightside and leftside to be false
+	_isWallRunning = false;
+	inAction = false;
+	_rightSide = false;
+	_leftSide = false;
+}
+
 /// <summary>
 /// Checks for wall running and does the wall running functionality. Is 
 /// called in update and only called when the player is in the air and 
@@ -366,156 +762,202 @@ void ATestComplexSystemCharacter::StopVaultOrGetUp()
 /// </summary>
 void ATestComplexSystemCharacter::CheckForWallRunning()
 {
-	//If the player is not on the left side of the wall
+	PARKOUR_SCOPE(CheckForWallRunning);
+
+	//The wall run probes only run airborne, so the wall sensor can be on
+	UpdateWallSensor(true);
+
+	//If the player is not on the left side of the wall, check the right side
 	if (!_leftSide)
 	{
+		FHitResult out;
+		bool hasHit = TraceWallRunSide(true, out);
 
-		//Hit result and collision params for use in line tracing
+		//If the wall can't be run on, return
+		if (!UpdateWallRunSide(true, hasHit, out))
+			return;
+	}
+
+	//If the player is not on the right side of the wall, check the left side
+	if (!_rightSide)
+	{
 		FHitResult out;
-		FCollisionQueryParams TraceParams;
-		//Ignores the player for line tracing
-		TraceParams.AddIgnoredActor(this);
+		bool hasHit = TraceWallRunSide(false, out);
+
+		UpdateWallRunSide(false, hasHit, out);
+	}
+}
 
-		//Create a start location and end location for use in line tracing
-		//The start location is the actors location and the end location is to the right of the player
-		FVector startLocation = GetActorLocation();
-		FVector endLocation = (GetActorRightVector() * 50.0f) + startLocation;
+/// <summary>
+/// Line traces to one side of the player looking for a wall to run on. When async
+/// wall run traces are enabled the result is the trace issued last frame and a new
+/// trace is issued for the next frame, so the scene query overlaps the rest of the frame
+/// </summary>
+/// <param name="rightSide">whether to trace to the right or the left of the player</param>
+/// <param name="out">the wall that was hit</param>
+/// <returns>true if a wall was hit</returns>
+bool ATestComplexSystemCharacter::TraceWallRunSide(bool rightSide, FHitResult& out)
+{
+	//Collision params for use in line tracing
+	FCollisionQueryParams TraceParams(SCENE_QUERY_STAT(ParkourWallRunTrace));
+	//Ignores the player for line tracing
+	TraceParams.AddIgnoredActor(this);
+	//The physical material says whether the wall can be run on
+	TraceParams.bReturnPhysicalMaterial = true;
 
-		//Line trace to the right
-		bool hasHit = GetWorld()->LineTraceSingleByChannel(out, startLocation, endLocation, ECC_Visibility, TraceParams);
+	//Create a start location and end location for use in line tracing
+	//The start location is the actors location and the end location is to the side of the player
+	FVector startLocation = GetActorLocation();
+	FVector endLocation = (GetActorRightVector() * (rightSide ? WallRunProbeDistance : -WallRunProbeDistance)) + startLocation;
 
-		//If the line trace has hit a wall, and the player is falling downwards, and the player is on the ground
-		if (hasHit && _currentFrameHeight - _lastFrameHeight <= 0.0f && !GetCharacterMovement()->IsMovingOnGround())
-		{
-			//If the wall is tagged not to wall run on, return
-			if (out.GetActor()->ActorHasTag("NoWallrun"))
-				return;
+	FTraceHandle& traceHandle = rightSide ? _rightWallTraceHandle : _leftWallTraceHandle;
 
-			//Set right side and on right side to be true
-			_rightSide = true;
-			_onRightSide = true;
+	//With no wall in range of the wall sensor there is nothing for the trace to hit. Any
+	//async trace in flight is dropped so it isn't used once a wall comes into range
+	if (!HasWallContact())
+	{
+		INC_DWORD_STAT(STAT_ParkourWallRunTracesSkipped);
+		traceHandle = FTraceHandle();
+		return false;
+	}
 
-			//If the player is not jumping off of the wall
-			if (!_isJumpingOffWall)
-			{
-				//Set in action to be true
-				inAction = true;
-
-				//Create a new rotator from the walls normal
-				FRotator newRotation = UKismetMathLibrary::MakeRotFromX(out.Normal);
-				//Set the rotation to be exactly 90 degrees
-				newRotation.Yaw += 90.0f;
-				newRotation.Roll = 0.0f;
-				newRotation.Pitch = 0.0f;
-				//Set the players rotation
-				SetActorRotation(newRotation);
-
-				//Get the actors forward
-				FVector actorForward = GetActorForwardVector();
-				//Set it to be straight ahead with no up or down movement
-				actorForward.X *= 500.0f;
-				actorForward.Y *= 500.0f;
-				actorForward.Z = 0.0f;
-
-				//Set the gravity scale to be higher than normal to slowly fall off the wall
-				//Set the velocity to be the actors forward
-				//Set the plane constraint to be 1 on the z to lock the player
-				GetCharacterMovement()->GravityScale = 15.0f;
-				GetCharacterMovement()->Velocity = actorForward;
-				GetCharacterMovement()->SetPlaneConstraintNormal(FVector(0.0f, 0.0f, 1.0f));
-
-				//Set is wall running to be true
-				_isWallRunning = true;
-			}	
-		}
+	//If async traces are off, line trace to the side and use the result right away
+	if (CVarParkourAsyncWallRunTraces.GetValueOnGameThread() == 0)
+	{
+		INC_DWORD_STAT(STAT_ParkourWallRunTracesSync);
+		PARKOUR_COUNT_TRACES(1);
+		return GetWorld()->LineTraceSingleByChannel(out, startLocation, endLocation, ECC_Parkour, TraceParams);
+	}
 
-		//If none of the if statements are true
-		else
+	bool hasHit = false;
+
+	//Use the result of the trace issued last frame if it is ready. The first airborne
+	//frame has no result yet and is treated as a miss
+	FTraceDatum traceData;
+	if (traceHandle.IsValid() && GetWorld()->QueryTraceData(traceHandle, traceData))
+	{
+		for (const FHitResult& hit : traceData.OutHits)
 		{
-			//Set the booleans to be false
-			_isWallRunning = false;
-			inAction = false;
-			_rightSide = false;
-			//Set the gravity scale and plane constraints back to normal
-			GetCharacterMovement()->GravityScale = 1.0f;
-			GetCharacterMovement()->SetPlaneConstraintNormal(FVector(0.0f, 0.0f, 0.0f));
+			if (hit.bBlockingHit)
+			{
+				out = hit;
+				hasHit = true;
+				break;
+			}
 		}
 	}
 
-	//If the player is not on the right side
-	if (!_rightSide)
+	//Issue the trace for the next frame
+	INC_DWORD_STAT(STAT_ParkourWallRunTracesAsync);
+	PARKOUR_COUNT_TRACES(1);
+	traceHandle = GetWorld()->AsyncLineTraceByChannel(EAsyncTraceType::Single, startLocation, endLocation, ECC_Parkour, TraceParams);
+
+	return hasHit;
+}
+
+/// <summary>
+/// Keeps the wall sensor in line with parkour.WallContactEvents. The sensor has collision
+/// while wall contact events are on, and only generates overlaps while the character is
+/// airborne, so it adds nothing to moves on the ground
+/// </summary>
+/// <param name="airborne">whether the character is falling or on a wall and probing for walls</param>
+void ATestComplexSystemCharacter::UpdateWallSensor(bool airborne)
+{
+	const bool enabled = CVarParkourWallContactEvents.GetValueOnGameThread() != 0;
+	if (enabled != (WallSensor->GetCollisionEnabled() != ECollisionEnabled::NoCollision))
+		WallSensor->SetCollisionEnabled(enabled ? ECollisionEnabled::QueryOnly : ECollisionEnabled::NoCollision);
+
+	const bool active = enabled && airborne;
+	if (active != WallSensor->GetGenerateOverlapEvents())
 	{
-		//Hit result and collision params for use in line tracing
-		FHitResult out;
-		FCollisionQueryParams TraceParams;
-		//Ignores the player for line tracing
-		TraceParams.AddIgnoredActor(this);
+		WallSensor->SetGenerateOverlapEvents(active);
+		//Picks up walls already in range on take off, after that the overlaps update as the character moves
+		WallSensor->UpdateOverlaps();
+	}
 
-		//Create a start location and end location for use in line tracing
-		//The start location is the actors location and the end location is to the left of the player
-		FVector startLocation = GetActorLocation();
-		FVector endLocation = (GetActorRightVector() * -50.0f) + startLocation;
+	if (active && WallSensor->GetOverlapInfos().Num() > 0)
+		_wallSensorFoundWall = true;
+}
 
-		//Line trace to the left
-		bool hasHit = GetWorld()->LineTraceSingleByChannel(out, startLocation, endLocation, ECC_Visibility, TraceParams);
+/// <summary>
+/// Whether anything is overlapping the wall sensor. The sensor doesn't say which side the
+/// wall is on, so both probes run while anything is in range. Walls without overlap events
+/// never show up in the sensor, so until it has found a wall once the probes always run
+/// </summary>
+/// <returns>true if the wall run probes could hit a wall</returns>
+bool ATestComplexSystemCharacter::HasWallContact() const
+{
+	return !WallSensor->GetGenerateOverlapEvents() || !_wallSensorFoundWall || WallSensor->GetOverlapInfos().Num() > 0;
+}
 
-		//If the line trace has hit a wall, and the player is falling downwards, and the player is on the ground
-		if (hasHit && _currentFrameHeight - _lastFrameHeight <= 0.0f && !GetCharacterMovement()->IsMovingOnGround())
-		{
-			//If the wall is tagged not to wall run on, return
-			if (out.GetActor()->ActorHasTag("NoWallrun"))
-				return;
+/// <summary>
+/// Starts or stops wall running on one side of the player based off the result
+/// of the wall probe on that side
+/// </summary>
+/// <param name="rightSide">whether the probe was to the right or the left of the player</param>
+/// <param name="hasHit">whether the probe hit a wall</param>
+/// <param name="out">the wall that was hit</param>
+/// <returns>false if the wall's surface can't be wall run on</returns>
+bool ATestComplexSystemCharacter::UpdateWallRunSide(bool rightSide, bool hasHit, const FHitResult& out)
+{
+	//If the line trace has hit a wall, and the player is falling downwards, and the player is not on the ground
+	//or dropping off a wall it ran out of speed on. The velocity says which way the player is going
+	//the same at any frame rate, where the change in height between two frames doesn't
+	const bool canWallRun = hasHit && GetVelocity().Z <= 0.0f && !GetCharacterMovement()->IsMovingOnGround() && ParkourMovement->CanWallRun();
+	//Whether the wall's physical material says it can be run on
+	const bool wallAllowsRun = !canWallRun || EnumHasAnyFlags(UParkourPhysicalMaterial::GetSurface(out), EParkourSurface::WallRun);
+
+#if PARKOUR_PROBE_HISTORY
+	const FVector probeStart = GetActorLocation();
+	_probeHistory.Add(GetWorld()->GetTimeSeconds(), rightSide ? EParkourProbe::WallRunRight : EParkourProbe::WallRunLeft,
+		!hasHit ? EParkourProbeOutcome::Miss : canWallRun && wallAllowsRun && !_isJumpingOffWall ? EParkourProbeOutcome::Used : EParkourProbeOutcome::Rejected,
+		probeStart, probeStart + GetActorRightVector() * (rightSide ? WallRunProbeDistance : -WallRunProbeDistance),
+		hasHit ? out.ImpactPoint : FVector::ZeroVector, hasHit ? out.ImpactNormal : FVector::ZeroVector, hasHit ? out.GetComponent() : nullptr);
+#endif
+
+	if (canWallRun)
+	{
+		//If the wall can't be run on, return
+		if (!wallAllowsRun)
+			return false;
 
-			//Set left side to be true and on right side to be false
+		//Set the side the player is on
+		if (rightSide)
+			_rightSide = true;
+		else
 			_leftSide = true;
-			_onRightSide = false;
+		_onRightSide = rightSide;
 
-			//If the player is not jumping off the wall
-			if (!_isJumpingOffWall)
-			{
-				//Set in action to be true
-				inAction = true;
-
-				//Create a new rotator from the walls normal
-				FRotator newRotation = UKismetMathLibrary::MakeRotFromX(out.Normal);
-				//Set the rotation to be exactly negative 90 degrees
-				newRotation.Yaw -= 90.0f;
-				newRotation.Roll = 0.0f;
-				newRotation.Pitch = 0.0f;
-				//Set the players rotation
-				SetActorRotation(newRotation);
-
-				//Get the actors forward
-				FVector actorForward = GetActorForwardVector();
-				//Set it to be straight ahead with no up or down movement
-				actorForward.X *= 500.0f;
-				actorForward.Y *= 500.0f;
-				actorForward.Z = 0.0f;
-
-				//Set the gravity scale to be higher than normal to slowly fall off the wall
-				//Set the velocity to be the actors forward
-				//Set the plane constraint to be 1 on the z to lock the player
-				GetCharacterMovement()->GravityScale = 15.0f;
-				GetCharacterMovement()->Velocity = actorForward;
-				GetCharacterMovement()->SetPlaneConstraintNormal(FVector(0.0f, 0.0f, 1.0f));
-				
-				//Set is wallrunning to be true
-				_isWallRunning = true;
-			}
+		//If the player is not jumping off of the wall
+		if (!_isJumpingOffWall)
+		{
+			//Set in action to be true
+			inAction = true;
+
+			//The movement component switches to its wall run mode on the next move, turning
+			//the player along the wall and running them straight ahead
+			ParkourMovement->StartWallRun(out.Normal, rightSide);
+
+			//Set is wall running to be true
+			_isWallRunning = true;
 		}
+	}
 
-		//If none of the if statements are true
+	//If none of the if statements are true
+	else
+	{
+		//Set the booleans to be false
+		_isWallRunning = false;
+		inAction = false;
+		if (rightSide)
+			_rightSide = false;
 		else
-		{
-			//Set the booleans to be false
-			_isWallRunning = false;
-			inAction = false;
 			_leftSide = false;
-			//Set the gravity scale and plane constraints back to normal
-			GetCharacterMovement()->GravityScale = 1.0f;
-			GetCharacterMovement()->SetPlaneConstraintNormal(FVector(0.0f, 0.0f, 0.0f));
-		}
+		//The movement component drops out of its wall run mode on the next move
+		ParkourMovement->StopWallRun();
 	}
+
+	return true;
 }
 
 /// <summary>
@@ -523,26 +965,28 @@ void ATestComplexSystemCharacter::CheckForWallRunning()
 /// </summary>
 void ATestComplexSystemCharacter::CheckJump()
 {
+	PARKOUR_SCOPE(CheckJump);
+
 	//If the player is not on a wall and is on the ground, jump normally
 	if ((!(_rightSide || _leftSide)) && GetCharacterMovement()->IsMovingOnGround())
+	{
+		if (_recorder)
+			_recorder->AddAction(EParkourRecordedAction::Jump);
 		Jump();
+	}
 	//If the player is wall running
 	else if (_isWallRunning)
 	{
+		if (_recorder)
+			_recorder->AddAction(EParkourRecordedAction::WallJump);
+
 		//Set is wall running to be false and is jumping off wall to be true
 		_isWallRunning = false;
 		_isJumpingOffWall = true;
 
-		//Get the right vector and select if the player launches to the right or the left
-		//based off if the player is on the right side of a wall or not
-		FVector actorRightVector = GetActorRightVector();
-		FVector launchVelocity = UKismetMathLibrary::SelectVector(actorRightVector * -450.0f, actorRightVector * 450.0f, _onRightSide);
-
-		//Set the launch velocity z to be higher
-		launchVelocity.Z = 450.0f;
-
-		//Launch the character using the launch velocity
-		LaunchCharacter(launchVelocity, false, false);
+		//The movement component launches the player away from the side of the wall
+		//they are on on the next move
+		ParkourMovement->WallJump();
 
 		//Set a timer to call the turn off wall run function
 		GetWorldTimerManager().SetTimer(timerHandle, this, &ATestComplexSystemCharacter::TurnOffJumpOffWall, .5f, false);
@@ -557,9 +1001,6 @@ void ATestComplexSystemCharacter::TurnOffJumpOffWall()
 	//Set the booleans to be false
 	_isJumpingOffWall = false;
 	inAction = false;
-	//Set the gravity scale and plane constraints back to normal
-	GetCharacterMovement()->GravityScale = 1.0f;
-	GetCharacterMovement()->SetPlaneConstraintNormal(FVector(0.0f, 0.0f, 0.0f));
 }
 
 void ATestComplexSystemCharacter::OnResetVR()
@@ -570,7 +1011,9 @@ void ATestComplexSystemCharacter::OnResetVR()
 	//		Add "HeadMountedDisplay" to [YourProject].Build.cs PublicDependencyModuleNames in order to build successfully (appropriate if supporting VR).
 	// or:
 	//		Comment or delete the call to ResetOrientationAndPosition below (appropriate if not supporting VR)
+#if !UE_SERVER
 	UHeadMountedDisplayFunctionLibrary::ResetOrientationAndPosition();
+#endif
 }
 
 void ATestComplexSystemCharacter::TouchStarted(ETouchIndex::Type FingerIndex, FVector Location)
@@ -4,6 +4,10 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Character.h"
+#include "WorldCollision.h"
+#include "ParkourTypes.h"
+#include "ParkourRecording.h"
+#include "ParkourProbeHistory.h"
 #include "TestComplexSystemCharacter.generated.h"
 
 UCLASS(config=Game)
@@ -19,14 +23,64 @@ class ATestComplexSystemCharacter : public ACharacter
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Camera, meta = (AllowPrivateAccess = "true"))
 	class UCameraComponent* FollowCamera;
 
+	/** Overlap volume either side of the character that lets the wall run probes run only when there is a wall in range, see parkour.WallContactEvents */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Parkour, meta = (AllowPrivateAccess = "true"))
+	class UBoxComponent* WallSensor;
+
 private:
 	FTimerHandle TimerHandle;
 	float _delayTimer;
 public:
-	ATestComplexSystemCharacter();
+	ATestComplexSystemCharacter(const FObjectInitializer& ObjectInitializer);
 
 	virtual void Tick(float deltaTime) override;
 
+	//Sets how often the character ticks and probes for walls, called by the parkour significance manager
+	void SetParkourSignificance(EParkourSignificance significance);
+
+	//How soon the wall probe should run when the parkour probe budget is tight, higher runs first
+	float GetProbePriority() const;
+
+	//Runs the wall probe, called right away or by the parkour probe scheduler
+	void RunScheduledProbe();
+
+	//Keeps the character's probes out of the parkour probe budget, for replays that have to play the same under any load
+	void SetProbeBudgetExempt(bool exempt) { _probeBudgetExempt = exempt; }
+	bool IsProbeBudgetExempt() const { return _probeBudgetExempt; }
+
+	//How far to each side of the player the wall run probes reach
+	static constexpr float WallRunProbeDistance = 50.0f;
+
+	//How close AI has to get to the start of a parkour nav link to take it
+	static constexpr float NavLinkReachDistance = 60.0f;
+	//How long AI waits before trying a nav link again after taking or failing one
+	static constexpr float NavLinkRetryInterval = 0.5f;
+
+	//Records the character's parkour run until StopRecording writes it to a file
+	void StartRecording();
+	bool StopRecording(const FString& fileName);
+	bool IsRecording() const { return _recorder.IsValid(); }
+
+	//What the character is doing as the state bits used by recordings
+	EParkourRunnerState GetParkourState() const;
+
+#if PARKOUR_PROBE_HISTORY
+	//The character's last climb and wall run probes, for parkour.ProbeHistory
+	FParkourProbeHistory& GetProbeHistory() { return _probeHistory; }
+#endif
+
+	/** Net update rate on the server while wall running, vaulting, climbing, sliding or in the air */
+	UPROPERTY(EditDefaultsOnly, Category = Replication)
+	float ParkourNetUpdateFrequency;
+
+	/** Net update rate on the server while moving on the ground */
+	UPROPERTY(EditDefaultsOnly, Category = Replication)
+	float MovingNetUpdateFrequency;
+
+	/** Net update rate on the server while standing still on the ground */
+	UPROPERTY(EditDefaultsOnly, Category = Replication)
+	float IdleNetUpdateFrequency;
+
 	/** Base turn rate, in deg/sec. Other scaling may affect final turn rate. */
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category=Camera)
 	float BaseTurnRate;
@@ -70,21 +124,70 @@ private:
 	FVector _wallNormal;
 	FVector _wallHeight;
 	FVector _otherWallHeight;
+	float _wallThickness;
+	TWeakObjectPtr<class UPrimitiveComponent> _wallComponent;
 
-	//Variables used for checking the height of the player frame by frame
-	float _lastFrameHeight;
-	float _currentFrameHeight;
-	
 	//Variables used for wall running
 	bool _onRightSide;
 	bool _isJumpingOffWall;
 	bool _isJumping;
 
+	//Handles for the wall run probes issued last frame when async wall run traces are enabled
+	FTraceHandle _rightWallTraceHandle;
+	FTraceHandle _leftWallTraceHandle;
+
+	//Probes one side of the player for a wall, either directly or through last frame's async trace
+	bool TraceWallRunSide(bool rightSide, FHitResult& out);
+	//Starts or stops wall running on one side based off the probe result, returns false if the wall can't be run on
+	bool UpdateWallRunSide(bool rightSide, bool hasHit, const FHitResult& out);
+
+	//Turns the wall sensor on while airborne when wall contact events are on, and off otherwise
+	void UpdateWallSensor(bool airborne);
+	//Whether a wall is in range of the wall run probes, always true when the wall sensor is off
+	bool HasWallContact() const;
+	//Whether the wall sensor has ever found a wall, walls without overlap events never show up in it
+	bool _wallSensorFoundWall;
+
+	//Movement component that does the parkour moves
+	UPROPERTY()
+	class UParkourMovementComponent* ParkourMovement;
+
+	//Whether this copy of the character probes for walls or follows the server or owning client
+	bool IsParkourLocallyDriven() const;
+
+	//Vaults, climbs or jumps when AI walking its path reaches the start of a parkour nav link
+	void FollowNavLink();
+	//World time AI can next take a nav link at
+	float _nextNavLinkTime;
+
+	//Variables used for cutting down parkour work on characters far from the players
+	EParkourSignificance _significance;
+	int32 _probeInterval;
+	int32 _ticksSinceProbe;
+	bool _probeBudgetExempt;
+
+	//Sets the net update rate from what the character is doing, on the server
+	void UpdateNetUpdateFrequency();
+
+	//Variables used for recording the parkour run
+	TUniquePtr<FParkourRecordingWriter> _recorder;
+	float _timeSinceRecordedSample;
+
+#if PARKOUR_PROBE_HISTORY
+	//The last probes, recorded as they run and only drawn when asked for
+	FParkourProbeHistory _probeHistory;
+#endif
+
+	//Runs the wall run probes of every character together and applies them back
+	friend class UParkourBatchSubsystem;
+
 	UFUNCTION()
 	void TurnOffJumpOffWall();
 	FTimerHandle timerHandle;
 
 protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 	/** Resets HMD orientation in VR. */
 	void OnResetVR();
@@ -123,6 +226,17 @@ public:
 	FORCEINLINE class USpringArmComponent* GetCameraBoom() const { return CameraBoom; }
 	/** Returns FollowCamera subobject **/
 	FORCEINLINE class UCameraComponent* GetFollowCamera() const { return FollowCamera; }
+	/** Returns ParkourMovement subobject **/
+	FORCEINLINE class UParkourMovementComponent* GetParkourMovement() const { return ParkourMovement; }
+
+	//Called by the movement component when a vault or climb starts, returns the path to move the player along
+	FParkourVaultPath OnVaultStarted();
+
+	//The wall found by the last climb check, ignored by the capsule while vaulting over it. Null for baked walls
+	class UPrimitiveComponent* GetVaultObstacle() const { return _wallComponent.Get(); }
+
+	//Called by the movement component when the player runs out of speed or wall to run on
+	void OnWallRunFalloff();
 
 	//These functions can be called in blueprint in case the user would like to change when they are used
 	UFUNCTION(BlueprintCallable, Category = "Parkour")
@@ -2,14 +2,104 @@
 
 #include "TestComplexSystemGameMode.h"
 #include "TestComplexSystemCharacter.h"
-#include "UObject/ConstructorHelpers.h"
+#include "TestComplexSystem.h"
+#include "Engine/AssetManager.h"
+#include "Engine/StreamableManager.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformMemory.h"
+
+/// <summary>
+/// Logs the streaming report of the game mode of the world
+/// </summary>
+/// <param name="World">the world to report on</param>
+static void StreamingReportCommand(UWorld* World)
+{
+	if (const ATestComplexSystemGameMode* gameMode = World ? World->GetAuthGameMode<ATestComplexSystemGameMode>() : nullptr)
+		gameMode->LogStreamingReport();
+}
+
+static FAutoConsoleCommandWithWorld ParkourStreamingReportCommand(
+	TEXT("parkour.StreamingReport"),
+	TEXT("Logs how long the parkour pawn class took to load and the memory in use before and after"),
+	FConsoleCommandWithWorldDelegate::CreateStatic(&StreamingReportCommand));
 
 ATestComplexSystemGameMode::ATestComplexSystemGameMode()
+	: PawnClassLoadStartTime(0.0)
+	, PawnClassLoadTime(0.0)
+	, PawnClassLoadStartMemory(0)
+	, PawnClassLoadedMemory(0)
 {
-	// set default pawn class to our Blueprinted character
-	static ConstructorHelpers::FClassFinder<APawn> PlayerPawnBPClass(TEXT("/Game/ThirdPersonCPP/Blueprints/ThirdPersonCharacter"));
-	if (PlayerPawnBPClass.Class != NULL)
+	// set default pawn class to our Blueprinted character, loaded once the game starts so
+	// the character and its animations aren't loaded along with the game mode
+	ParkourPawnClass = TSoftClassPtr<APawn>(FSoftObjectPath(TEXT("/Game/ThirdPersonCPP/Blueprints/ThirdPersonCharacter.ThirdPersonCharacter_C")));
+	DefaultPawnClass = ATestComplexSystemCharacter::StaticClass();
+}
+
+/// <summary>
+/// Starts loading the pawn class ahead of everything else, since no player can start until it is in
+/// </summary>
+void ATestComplexSystemGameMode::InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage)
+{
+	Super::InitGame(MapName, Options, ErrorMessage);
+
+	if (ParkourPawnClass.IsNull())
+		return;
+
+	PawnClassLoadStartTime = FPlatformTime::Seconds();
+	PawnClassLoadStartMemory = FPlatformMemory::GetStats().UsedPhysical;
+
+	PawnClassHandle = UAssetManager::GetStreamableManager().RequestAsyncLoad(ParkourPawnClass.ToSoftObjectPath(),
+		FStreamableDelegate::CreateUObject(this, &ATestComplexSystemGameMode::OnPawnClassLoaded), FStreamableManager::AsyncLoadHighPriority);
+}
+
+/// <summary>
+/// Holds players back until the pawn class is loaded, so they don't spawn as the fallback pawn
+/// </summary>
+void ATestComplexSystemGameMode::HandleStartingNewPlayer_Implementation(APlayerController* NewPlayer)
+{
+	if (PawnClassHandle.IsValid() && PawnClassHandle->IsLoadingInProgress())
+	{
+		WaitingPlayers.Add(NewPlayer);
+		return;
+	}
+
+	Super::HandleStartingNewPlayer_Implementation(NewPlayer);
+}
+
+void ATestComplexSystemGameMode::OnPawnClassLoaded()
+{
+	PawnClassLoadTime = FPlatformTime::Seconds() - PawnClassLoadStartTime;
+	PawnClassLoadedMemory = FPlatformMemory::GetStats().UsedPhysical;
+
+	if (UClass* pawnClass = ParkourPawnClass.Get())
+		DefaultPawnClass = pawnClass;
+	else
+		UE_LOG(LogParkour, Warning, TEXT("Couldn't load the parkour pawn class %s, players get %s"), *ParkourPawnClass.ToString(), *GetNameSafe(DefaultPawnClass));
+
+	LogStreamingReport();
+
+	TArray<APlayerController*> players = MoveTemp(WaitingPlayers);
+	for (APlayerController* player : players)
+	{
+		if (IsValid(player))
+			Super::HandleStartingNewPlayer_Implementation(player);
+	}
+}
+
+void ATestComplexSystemGameMode::LogStreamingReport() const
+{
+	const FPlatformMemoryStats memory = FPlatformMemory::GetStats();
+	if (PawnClassHandle.IsValid() && PawnClassHandle->HasLoadCompleted())
+	{
+		UE_LOG(LogParkour, Display, TEXT("Parkour pawn class %s loaded in %.1f ms, memory in use %.1f MB before, %.1f MB after, %.1f MB now"),
+			*ParkourPawnClass.ToString(), PawnClassLoadTime * 1000.0, PawnClassLoadStartMemory / (1024.0 * 1024.0),
+			PawnClassLoadedMemory / (1024.0 * 1024.0), memory.UsedPhysical / (1024.0 * 1024.0));
+	}
+	else
 	{
-		DefaultPawnClass = PlayerPawnBPClass.Class;
+		UE_LOG(LogParkour, Display, TEXT("Parkour pawn class %s isn't loaded, memory in use %.1f MB"),
+			*ParkourPawnClass.ToString(), memory.UsedPhysical / (1024.0 * 1024.0));
 	}
 }
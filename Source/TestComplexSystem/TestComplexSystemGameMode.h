@@ -6,6 +6,8 @@
 #include "GameFramework/GameModeBase.h"
 #include "TestComplexSystemGameMode.generated.h"
 
+struct FStreamableHandle;
+
 UCLASS(minimalapi)
 class ATestComplexSystemGameMode : public AGameModeBase
 {
@@ -13,7 +15,33 @@ class ATestComplexSystemGameMode : public AGameModeBase
 
 public:
 	ATestComplexSystemGameMode();
-};
 
+	virtual void InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage) override;
+	virtual void HandleStartingNewPlayer_Implementation(APlayerController* NewPlayer) override;
+
+	/**
+	 * The pawn players get. Loaded in the background when the game starts instead of with
+	 * the game mode, players joining before it is in wait for it.
+	 */
+	UPROPERTY(EditDefaultsOnly, Category = Classes)
+	TSoftClassPtr<APawn> ParkourPawnClass;
+
+	/** Logs how long the pawn class took to load and how much memory is in use */
+	void LogStreamingReport() const;
 
+private:
+	/** Called once the pawn class is loaded, starts the players that were waiting for it */
+	void OnPawnClassLoaded();
 
+	TSharedPtr<FStreamableHandle> PawnClassHandle;
+
+	/** Players that joined before the pawn class was loaded */
+	UPROPERTY(Transient)
+	TArray<APlayerController*> WaitingPlayers;
+
+	//When the load started and finished, and the memory in use at each
+	double PawnClassLoadStartTime;
+	double PawnClassLoadTime;
+	uint64 PawnClassLoadStartMemory;
+	uint64 PawnClassLoadedMemory;
+};